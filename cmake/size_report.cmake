@@ -0,0 +1,64 @@
+# Print the code and data bytes of every object in the full and trimmed cryptoauthlib builds
+#
+# Run by the size_report target:
+#   cmake -DSIZE_TOOL=<size> -DFULL=<archive> -DTRIMMED=<archive> -P size_report.cmake
+#
+# Code is the text section; data counts both initialized data and bss, since each takes hub RAM. Objects are listed
+# largest first.
+
+function(report title archive)
+    execute_process(COMMAND "${SIZE_TOOL}" "${archive}"
+        OUTPUT_VARIABLE output
+        RESULT_VARIABLE result)
+    if (result)
+        message(FATAL_ERROR "${SIZE_TOOL} failed on ${archive}")
+    endif ()
+
+    string(REPLACE "\n" ";" lines "${output}")
+    set(rows)
+    set(totalCode 0)
+    set(totalData 0)
+    foreach(line IN LISTS lines)
+        # text data bss dec hex filename (ex archive)
+        if (line MATCHES "^[ \t]*([0-9]+)[ \t]+([0-9]+)[ \t]+([0-9]+)[ \t]+[0-9]+[ \t]+[0-9a-f]+[ \t]+([^ ]+)")
+            set(code ${CMAKE_MATCH_1})
+            math(EXPR data "${CMAKE_MATCH_2} + ${CMAKE_MATCH_3}")
+            math(EXPR totalCode "${totalCode} + ${code}")
+            math(EXPR totalData "${totalData} + ${data}")
+
+            # Zero-padded so that a plain string sort orders by size
+            string(LENGTH "${code}" digits)
+            math(EXPR padding "8 - ${digits}")
+            string(SUBSTRING "00000000" 0 ${padding} zeros)
+            list(APPEND rows "${zeros}${code}|${data}|${CMAKE_MATCH_4}")
+        endif ()
+    endforeach()
+    list(SORT rows)
+    list(REVERSE rows)
+
+    message("${title}: ${archive}")
+    message("      code      data  object")
+    foreach(row IN LISTS rows)
+        string(REPLACE "|" ";" fields "${row}")
+        list(GET fields 0 code)
+        list(GET fields 1 data)
+        list(GET fields 2 object)
+        string(REGEX REPLACE "^0+([0-9])" "\\1" code "${code}")
+        message_columns("${code}" "${data}" "${object}")
+    endforeach()
+    message_columns("${totalCode}" "${totalData}" "total")
+    message("")
+endfunction()
+
+function(message_columns code data name)
+    foreach(column code data)
+        string(LENGTH "${${column}}" length)
+        math(EXPR padding "10 - ${length}")
+        string(SUBSTRING "          " 0 ${padding} spaces)
+        set(${column} "${spaces}${${column}}")
+    endforeach()
+    message("${code}${data}  ${name}")
+endfunction()
+
+report("Full" "${FULL}")
+report("Trimmed" "${TRIMMED}")
@@ -0,0 +1,166 @@
+/**
+ * @file    ConfigImage.h
+ *
+ * @author  David Zemon
+ *
+ * @copyright
+ * The MIT License (MIT)<br>
+ * <br>Copyright (c) 2019 David Zemon<br>
+ * <br>Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:<br>
+ * <br>The above copyright notice and this permission notice shall be included in all copies or substantial portions
+ * of the Software.<br>
+ * <br>THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "authtypes.h"
+
+#include <cstddef>
+
+/**
+ * @brief Everything an application chooses about the ATECC508A configuration zone
+ *
+ * Filled in as a constant aggregate and turned into a complete zone image by ConfigImage. Bytes that are read-only,
+ * or that the application has no reason to change, keep the factory values shown in the dump in
+ * cryptoauth_demo.cpp.
+ */
+struct ConfigLayout {
+    static const size_t SIZE  = 128;
+    static const size_t SLOTS = 16;
+
+    uint8_t    i2cAddress;
+    uint8_t    otpMode;
+    uint8_t    chipMode;
+    SlotConfig slotConfig[SLOTS];
+    KeyConfig  keyConfig[SLOTS];
+
+    /**
+     * @return Byte `offset` of the configuration zone. Serial number and revision (0-15) read as 0xFF; the device
+     *         ignores writes to them anyway.
+     */
+    constexpr uint8_t byte (const size_t offset) const {
+        return offset < 16 ? 0xFF
+               : 16 == offset ? this->i2cAddress
+               : 18 == offset ? this->otpMode
+               : 19 == offset ? this->chipMode
+               : offset < SLOT_CONFIG_OFFSET ? 0x00
+               : offset < SLOT_CONFIG_OFFSET + 2 * SLOTS ? word_byte(
+                    this->slotConfig[(offset - SLOT_CONFIG_OFFSET) / 2].raw(), offset)
+               : offset < KEY_CONFIG_OFFSET ? factory_byte(offset)
+               : word_byte(this->keyConfig[(offset - KEY_CONFIG_OFFSET) / 2].raw(), offset);
+    }
+
+    /**
+     * @brief Slots read with encryption must be secret, and their read key must be a different, secret slot that
+     *        holds a SHA key rather than an ECC key
+     */
+    constexpr bool encrypted_reads_valid (const size_t slot = 0) const {
+        return SLOTS == slot
+               || ((!this->slotConfig[slot].encrypted_read()
+                    || (this->slotConfig[slot].is_secret()
+                        && this->slotConfig[slot].read_key() != slot
+                        && this->slotConfig[this->slotConfig[slot].read_key()].is_secret()
+                        && KEY_TYPE_DATA == this->keyConfig[this->slotConfig[slot].read_key()].key_type()))
+                   && this->encrypted_reads_valid(slot + 1));
+    }
+
+    /**
+     * @brief Private keys must be P256 keys in secret slots
+     */
+    constexpr bool private_keys_valid (const size_t slot = 0) const {
+        return SLOTS == slot
+               || ((!this->keyConfig[slot].is_private()
+                    || (KEY_TYPE_P256 == this->keyConfig[slot].key_type() && this->slotConfig[slot].is_secret()))
+                   && this->private_keys_valid(slot + 1));
+    }
+
+    /**
+     * @brief Slots that require authorization must name a different slot as the authorizing key
+     */
+    constexpr bool auth_keys_valid (const size_t slot = 0) const {
+        return SLOTS == slot
+               || ((!this->keyConfig[slot].require_auth() || this->keyConfig[slot].auth_key() != slot)
+                   && this->auth_keys_valid(slot + 1));
+    }
+
+    static const size_t SLOT_CONFIG_OFFSET = 20;
+    static const size_t KEY_CONFIG_OFFSET  = 96;
+
+    /**
+     * Multi-byte fields in the configuration zone are little-endian, and every 16-bit field starts at an even offset
+     */
+    static constexpr uint8_t word_byte (const uint16_t word, const size_t offset) {
+        return static_cast<uint8_t>(offset & 1 ? word >> 8 : word);
+    }
+
+    /**
+     * Counters, LastKeyUse, UserExtra, Selector, lock bytes, SlotLocked, RFU and X509format (52-95)
+     */
+    static constexpr uint8_t factory_byte (const size_t offset) {
+        return offset < 56 ? 0xFF
+               : offset < 60 ? 0x00
+               : offset < 64 ? 0xFF
+               : offset < 68 ? 0x00
+               : offset < 84 ? 0xFF
+               : offset < 86 ? 0x00
+               : offset < 88 ? 0x55
+               : offset < 90 ? 0xFF
+               : 0x00;
+    }
+};
+
+template<size_t... I>
+struct ConfigImageIndices {
+};
+
+template<size_t N, size_t... I>
+struct MakeConfigImageIndices : MakeConfigImageIndices<N - 1, N - 1, I...> {
+};
+
+template<size_t... I>
+struct MakeConfigImageIndices<0, I...> {
+    typedef ConfigImageIndices<I...> type;
+};
+
+/**
+ * @brief Complete configuration zone image, generated by the compiler
+ *
+ * `Definition` supplies `static constexpr ConfigLayout layout ()`. DATA is constant-initialized, so it lives in the
+ * program image next to the code: nothing runs at startup to build it, and no second, writable copy is made. A
+ * layout with conflicting settings does not compile.
+ *
+ * @code
+ * struct DemoConfig {
+ *     static constexpr ConfigLayout layout () {
+ *         return ConfigLayout{0xC0, 0x55, 0x00, {SlotConfig::public_key(), ...}, {KeyConfig(0x0033), ...}};
+ *     }
+ * };
+ *
+ * config.set_bytes(0, ConfigImage<DemoConfig>::DATA, ConfigImage<DemoConfig>::SIZE);
+ * @endcode
+ */
+template<typename Definition, typename Indices = typename MakeConfigImageIndices<ConfigLayout::SIZE>::type>
+class ConfigImage;
+
+template<typename Definition, size_t... I>
+class ConfigImage<Definition, ConfigImageIndices<I...> > {
+        static_assert(Definition::layout().encrypted_reads_valid(),
+                      "Encrypted read requires a secret slot and a read key in another secret slot holding a SHA key");
+        static_assert(Definition::layout().private_keys_valid(), "Private keys must be P256 keys in secret slots");
+        static_assert(Definition::layout().auth_keys_valid(), "A slot cannot authorize itself");
+
+    public:
+        static const size_t  SIZE = sizeof...(I);
+        static const uint8_t DATA[SIZE];
+};
+
+template<typename Definition, size_t... I>
+const uint8_t ConfigImage<Definition, ConfigImageIndices<I...> >::DATA[] = {Definition::layout().byte(I)...};
@@ -0,0 +1,252 @@
+/**
+ * @file    ConfigZone.h
+ *
+ * @author  David Zemon
+ *
+ * @copyright
+ * The MIT License (MIT)<br>
+ * <br>Copyright (c) 2019 David Zemon<br>
+ * <br>Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:<br>
+ * <br>The above copyright notice and this permission notice shall be included in all copies or substantial portions
+ * of the Software.<br>
+ * <br>THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "atca_hal_prop.h"
+#include "authtypes.h"
+
+#include <atca_basic.h>
+#include <PropWare/PropWare.h>
+
+#include <cstring>
+
+/**
+ * @brief Read-modify-write editor for the ATECC508A configuration zone
+ *
+ * Reads the zone once, takes edits against that copy, and then writes back only the words that changed. The result
+ * stays consistent with what is on the device, so the summary CRC for the config lock can be computed up front
+ * instead of locking blind.
+ *
+ * read(), apply() and lock() talk to the library's current device and hold the LibraryLock for the whole call, so no
+ * other cog's command lands between the writes of one apply(). Go through CryptoDevice::read_config(),
+ * CryptoDevice::apply_config() and CryptoDevice::lock_config(), which select the device under the same lock and keep
+ * its metadata cache exact. Call these directly only while holding the LibraryLock for the device already.
+ *
+ * @code
+ * ConfigZone config;
+ * check_errors(cryptoDevice.read_config(config));
+ * config.set_slot_config(0, SlotConfig::public_key());
+ * config.set_key_config(0, KeyConfig(true, true, KEY_TYPE_P256, true));
+ * check_errors(cryptoDevice.apply_config(config));
+ * check_errors(cryptoDevice.lock_config(config));
+ * @endcode
+ */
+class ConfigZone {
+    public:
+        static const size_t SIZE = ATCA_ECC_CONFIG_SIZE;
+
+        /**
+         * @brief One Write command produced by plan()
+         */
+        struct Write {
+            uint8_t offset;
+            /** ATCA_WORD_SIZE or ATCA_BLOCK_SIZE */
+            uint8_t length;
+        };
+
+        /** No plan needs more writes than there are writable words */
+        static const size_t MAX_WRITES = SIZE / ATCA_WORD_SIZE;
+
+    public:
+        ConfigZone ()
+                : m_loaded(false) {
+        }
+
+        /**
+         * @brief Load the device's current configuration zone, discarding any pending edits
+         */
+        PropWare::ErrorCode read () {
+            PropWare::ErrorCode err;
+            LibraryLock::Scope  lock(NULL);
+            check_errors(atcab_read_config_zone(this->m_device));
+            memcpy(this->m_edited, this->m_device, SIZE);
+            this->m_loaded = true;
+            return 0;
+        }
+
+        bool loaded () const {
+            return this->m_loaded;
+        }
+
+        /**
+         * @return The zone including pending edits
+         */
+        const uint8_t *image () const {
+            return this->m_edited;
+        }
+
+        void set_slot_config (const uint8_t slot, const SlotConfig &slotConfig) {
+            this->set_slot_config(slot, slotConfig.raw());
+        }
+
+        void set_slot_config (const uint8_t slot, const uint16_t slotConfig) {
+            this->set_word16(SLOT_CONFIG_OFFSET + 2 * slot, slotConfig);
+        }
+
+        void set_key_config (const uint8_t slot, const KeyConfig &keyConfig) {
+            this->set_key_config(slot, keyConfig.raw());
+        }
+
+        void set_key_config (const uint8_t slot, const uint16_t keyConfig) {
+            this->set_word16(KEY_CONFIG_OFFSET + 2 * slot, keyConfig);
+        }
+
+        /**
+         * @brief Edit any other bytes of the zone. Edits landing in read-only ranges are ignored.
+         */
+        void set_bytes (const size_t offset, const uint8_t *data, const size_t length) {
+            for (size_t i = 0; i < length && offset + i < SIZE; ++i)
+                if (writable(offset + i))
+                    this->m_edited[offset + i] = data[i];
+        }
+
+        uint16_t get_slot_config (const uint8_t slot) const {
+            return this->get_word16(SLOT_CONFIG_OFFSET + 2 * slot);
+        }
+
+        uint16_t get_key_config (const uint8_t slot) const {
+            return this->get_word16(KEY_CONFIG_OFFSET + 2 * slot);
+        }
+
+        /**
+         * @return Summary CRC of the edited zone, as expected by the config lock
+         */
+        uint16_t crc () const {
+            uint8_t crc[ATCA_CRC_SIZE];
+            atCRC(SIZE, this->m_edited, crc);
+            return static_cast<uint16_t>(crc[0] | (crc[1] << 8));
+        }
+
+        /**
+         * @brief Work out the fewest Write commands that carry every pending edit
+         *
+         * A block that has at least BLOCK_WRITE_THRESHOLD changed words goes out as one 32-byte write, unless the
+         * block contains read-only bytes (blocks 0 and 2), which only take 4-byte writes.
+         *
+         * @return Number of entries written to `writes`
+         */
+        size_t plan (Write writes[MAX_WRITES]) const {
+            size_t count = 0;
+            for (size_t block = 0; block < SIZE / ATCA_BLOCK_SIZE; ++block) {
+                const size_t blockOffset  = block * ATCA_BLOCK_SIZE;
+                size_t       changedWords = 0;
+                for (size_t word = 0; word < WORDS_PER_BLOCK; ++word)
+                    if (this->word_changed(blockOffset + word * ATCA_WORD_SIZE))
+                        ++changedWords;
+
+                if (changedWords >= BLOCK_WRITE_THRESHOLD && block_writable(blockOffset)) {
+                    writes[count].offset   = static_cast<uint8_t>(blockOffset);
+                    writes[count++].length = ATCA_BLOCK_SIZE;
+                } else if (changedWords) {
+                    for (size_t word = 0; word < WORDS_PER_BLOCK; ++word) {
+                        const size_t offset = blockOffset + word * ATCA_WORD_SIZE;
+                        if (this->word_changed(offset)) {
+                            writes[count].offset   = static_cast<uint8_t>(offset);
+                            writes[count++].length = ATCA_WORD_SIZE;
+                        }
+                    }
+                }
+            }
+            return count;
+        }
+
+        /**
+         * @brief Write the pending edits to the device
+         *
+         * @param[out] bytesWritten     Optional: configuration bytes sent, for comparison with the full zone
+         */
+        PropWare::ErrorCode apply (size_t *bytesWritten = NULL) {
+            PropWare::ErrorCode err;
+            Write               writes[MAX_WRITES];
+            const size_t        count = this->plan(writes);
+            LibraryLock::Scope  lock(NULL);
+
+            if (bytesWritten)
+                *bytesWritten = 0;
+            for (size_t i = 0; i < count; ++i) {
+                const auto &write = writes[i];
+                check_errors(atcab_write_zone(ATCA_ZONE_CONFIG, 0, write.offset / ATCA_BLOCK_SIZE,
+                                              (write.offset % ATCA_BLOCK_SIZE) / ATCA_WORD_SIZE,
+                                              &this->m_edited[write.offset], write.length));
+                memcpy(&this->m_device[write.offset], &this->m_edited[write.offset], write.length);
+                if (bytesWritten)
+                    *bytesWritten += write.length;
+            }
+            return 0;
+        }
+
+        /**
+         * @brief Lock the configuration zone, refusing if the device's contents differ from the edited image
+         */
+        PropWare::ErrorCode lock () const {
+            LibraryLock::Scope lock(NULL);
+            return atcab_lock_config_zone_crc(this->crc());
+        }
+
+    protected:
+        static const size_t SLOT_CONFIG_OFFSET    = 20;
+        static const size_t KEY_CONFIG_OFFSET     = 96;
+        static const size_t WORDS_PER_BLOCK       = ATCA_BLOCK_SIZE / ATCA_WORD_SIZE;
+        /**
+         * Every Write costs a full command execution, which dwarfs the bus time of the extra 28 bytes, so two changed
+         * words are already cheaper as one block
+         */
+        static const size_t BLOCK_WRITE_THRESHOLD = 2;
+
+    protected:
+        /**
+         * @brief Serial number, revision and the like (0-15), and UserExtra, Selector and the lock bytes (84-87),
+         *        are set by other commands or not at all
+         */
+        static bool writable (const size_t offset) {
+            return 16 <= offset && !(84 <= offset && offset < 88);
+        }
+
+        static bool block_writable (const size_t blockOffset) {
+            for (size_t offset = blockOffset; offset < blockOffset + ATCA_BLOCK_SIZE; ++offset)
+                if (!writable(offset))
+                    return false;
+            return true;
+        }
+
+        bool word_changed (const size_t offset) const {
+            return writable(offset) && memcmp(&this->m_device[offset], &this->m_edited[offset], ATCA_WORD_SIZE);
+        }
+
+        /**
+         * Multi-byte fields in the configuration zone are little-endian
+         */
+        void set_word16 (const size_t offset, const uint16_t value) {
+            this->m_edited[offset]     = static_cast<uint8_t>(value);
+            this->m_edited[offset + 1] = static_cast<uint8_t>(value >> 8);
+        }
+
+        uint16_t get_word16 (const size_t offset) const {
+            return static_cast<uint16_t>(this->m_edited[offset] | (this->m_edited[offset + 1] << 8));
+        }
+
+    protected:
+        /** What the device holds, as far as we know */
+        uint8_t m_device[SIZE];
+        uint8_t m_edited[SIZE];
+        bool    m_loaded;
+};
@@ -22,9 +22,18 @@
 #pragma once
 
 #include "common.h"
+#include "authtypes.h"
+#include "atca_hal_prop.h"
+#include "ConfigZone.h"
+#include "MerkleBatch.h"
 
 #include <atca_basic.h>
+#include <host/atca_host.h>
 #include <PropWare/hmi/output/printer.h>
+#include <PropWare/concurrent/runnable.h>
+
+#include <cstddef>
+#include <cstring>
 
 using PropWare::Printer;
 
@@ -36,6 +45,355 @@ class CryptoDevice {
         static const uint8_t        DEFAULT_BUS            = 0;
         static const uint16_t       DEFAULT_WAKE_DELAY     = 800;
         static const uint8_t        DEFAULT_RX_RETRIES     = 3;
+        static const uint32_t       DEFAULT_BUSY_GAP_MS    = 500;
+        /** Commands that may be queued, running or awaiting collection at once. Must be a power of two. */
+        static const size_t         QUEUE_DEPTH            = 8;
+        /** Public keys remembered by get_public_key() */
+        static const size_t         PUBLIC_KEY_CACHE_SIZE  = 4;
+        static const size_t         REVISION_SIZE          = 4;
+        /** Consecutive wake and read-serial checks a setting must pass during calibrate() */
+        static const unsigned int   DEFAULT_LINK_CHECKS    = 16;
+        /** Wake delays searched by calibrate(), in microseconds */
+        static const uint16_t       MIN_WAKE_DELAY         = 50;
+        static const uint16_t       MAX_WAKE_DELAY         = 2500;
+        /** calibrate() stops narrowing the wake delay once the bounds are this close */
+        static const uint16_t       WAKE_DELAY_RESOLUTION  = 20;
+        /** Added to the shortest wake delay that passed, to cover temperature and supply drift */
+        static const uint16_t       WAKE_DELAY_MARGIN_PCT  = 25;
+
+        /**
+         * @brief Identifies a command submitted to the worker cog
+         */
+        typedef uint32_t Handle;
+        /** Returned by the submit_*() methods when the queue is full */
+        static const Handle INVALID_HANDLE = 0;
+
+        /**
+         * @brief Commands that can be submitted to the worker cog
+         */
+        typedef enum {
+            ASYNC_GENKEY,
+            ASYNC_SIGN,
+            ASYNC_VERIFY_EXTERN,
+            ASYNC_RANDOM,
+            ASYNC_READ_SERIAL,
+            ASYNC_READ_ZONE,
+            ASYNC_WRITE_ZONE
+        } AsyncCommand;
+
+        /**
+         * @brief What to do with the device at the end of a session
+         */
+        typedef enum {
+            /** Idle: TempKey and the RNG seed survive until the next session, at the cost of idle current */
+            IDLE_BETWEEN_SESSIONS,
+            /** Sleep: lowest power, but all volatile state is lost */
+            SLEEP_BETWEEN_SESSIONS,
+            /** Idle while sessions arrive closer together than the busy gap, sleep once traffic slows down */
+            AUTOMATIC
+        } IdlePolicy;
+
+        /**
+         * @brief Keep the device awake for the lifetime of the object so that every command issued in the meantime
+         *        shares a single wake
+         *
+         * The HAL re-arms the device's watchdog with an idle/wake pair when necessary, so sessions may last longer
+         * than the watchdog period. Sessions nest; only the outermost one wakes and releases the device.
+         *
+         * A session does not hold the LibraryLock. Each method of CryptoDevice takes it for its own commands only, so
+         * other cogs using other devices get a turn between them.
+         *
+         * @code
+         * {
+         *     CryptoDevice::Session session(cryptoDevice);
+         *     check_errors(session.status());
+         *     check_errors(cryptoDevice.print_serial(pwOut));
+         *     check_errors(cryptoDevice.generate_key(1));
+         * }
+         * @endcode
+         */
+        class Session {
+            public:
+                explicit Session (CryptoDevice &device)
+                        : m_device(device),
+                          m_status(device.begin_session()) {
+                }
+
+                ~Session () {
+                    this->m_device.end_session();
+                }
+
+                /**
+                 * @return 0 if the device woke up, error code otherwise
+                 */
+                PropWare::ErrorCode status () const {
+                    return this->m_status;
+                }
+
+            private:
+                CryptoDevice              &m_device;
+                const PropWare::ErrorCode m_status;
+        };
+
+        /**
+         * @brief Encrypted reads and writes of data slots that share one TempKey set-up
+         *
+         * `atcab_read_enc()` and `atcab_write_enc()` read the serial number, issue Nonce and GenDig and compute TempKey
+         * on the host for every 32-byte block, waking and idling the device for each command. This session wakes the
+         * device once and holds it awake, takes the serial number from the metadata cache, and sets TempKey up once.
+         * Consecutive blocks then cost one Read or Write command each.
+         *
+         * TempKey is set up again when the HAL reports that the device may have lost it (sleep, watchdog expiry, an
+         * unacknowledged command, or any command that may replace it, whichever cog sent it), and once more for a block
+         * the device rejects, in case the device invalidated it. Each block holds the LibraryLock from that check to its
+         * response, so no other cog's command can slip in between and leave a read decrypted with the wrong key.
+         *
+         * @code
+         * {
+         *     CryptoDevice::EncryptedSession session(cryptoDevice, ENCRYPTION_KEY_SLOT, encryptionKey, numIn);
+         *     check_errors(session.status());
+         *     check_errors(session.read_blocks(SECRET_SLOT, 0, secret, 3));
+         * }
+         * @endcode
+         */
+        class EncryptedSession {
+            public:
+                /**
+                 * @param[in] device
+                 * @param[in] keyId     Slot of the key that encrypts the transfers (the ReadKey or WriteKey of the
+                 *                      target slots)
+                 * @param[in] key       Value of that key. Must outlive the session.
+                 * @param[in] numIn     Host-supplied input to the Nonce command. Must outlive the session.
+                 */
+                EncryptedSession (CryptoDevice &device, const uint16_t keyId, const uint8_t key[ATCA_KEY_SIZE],
+                                  const uint8_t numIn[NONCE_NUMIN_SIZE])
+                        : m_device(device),
+                          m_session(device),
+                          m_keyId(keyId),
+                          m_key(key),
+                          m_numIn(numIn),
+                          m_established(false),
+                          m_epoch(0),
+                          m_setups(0) {
+                    memset(&this->m_tempKey, 0, sizeof(this->m_tempKey));
+                }
+
+                ~EncryptedSession () {
+                    // Leave no key material behind in hub RAM
+                    memset(&this->m_tempKey, 0, sizeof(this->m_tempKey));
+                }
+
+                /**
+                 * @return 0 if the device woke up, error code otherwise
+                 */
+                PropWare::ErrorCode status () const {
+                    return this->m_session.status();
+                }
+
+                /**
+                 * @return Number of times TempKey has been set up so far
+                 */
+                unsigned int setups () const {
+                    return this->m_setups;
+                }
+
+                PropWare::ErrorCode read_block (const uint16_t slot, const uint8_t block,
+                                                uint8_t data[ATCA_BLOCK_SIZE]) {
+                    const bool          reused = this->established();
+                    PropWare::ErrorCode err    = this->read_once(slot, block, data);
+                    if (err && reused) {
+                        this->m_established = false;
+                        err = this->read_once(slot, block, data);
+                    }
+                    if (err)
+                        this->m_established = false;
+                    return err;
+                }
+
+                PropWare::ErrorCode write_block (const uint16_t slot, const uint8_t block,
+                                                 const uint8_t data[ATCA_BLOCK_SIZE]) {
+                    const bool          reused = this->established();
+                    PropWare::ErrorCode err    = this->write_once(slot, block, data);
+                    if (err && reused) {
+                        this->m_established = false;
+                        err = this->write_once(slot, block, data);
+                    }
+                    if (err)
+                        this->m_established = false;
+                    return err;
+                }
+
+                /**
+                 * @param[out] data     `blocks` consecutive blocks, starting with `firstBlock`
+                 */
+                PropWare::ErrorCode read_blocks (const uint16_t slot, const uint8_t firstBlock, uint8_t *data,
+                                                 const uint8_t blocks) {
+                    PropWare::ErrorCode err;
+                    for (uint8_t i = 0; i < blocks; ++i)
+                        check_errors(this->read_block(slot, firstBlock + i, &data[i * ATCA_BLOCK_SIZE]));
+                    return 0;
+                }
+
+                PropWare::ErrorCode write_blocks (const uint16_t slot, const uint8_t firstBlock, const uint8_t *data,
+                                                  const uint8_t blocks) {
+                    PropWare::ErrorCode err;
+                    for (uint8_t i = 0; i < blocks; ++i)
+                        check_errors(this->write_block(slot, firstBlock + i, &data[i * ATCA_BLOCK_SIZE]));
+                    return 0;
+                }
+
+            private:
+                bool established () const {
+                    return this->m_established && this->m_epoch == this->m_device.m_halConfig.volatileEpoch;
+                }
+
+                /**
+                 * @brief Issue Nonce and GenDig, and compute the TempKey they leave in the device
+                 */
+                PropWare::ErrorCode establish () {
+                    PropWare::ErrorCode err;
+                    if (this->established())
+                        return 0;
+
+                    check_errors(this->m_device.read_serial_number(this->m_serialNumber));
+
+                    uint8_t randOut[RANDOM_NUM_SIZE];
+                    uint8_t otherData[4] = {0};
+                    {
+                        LibraryLock::Scope lock(this->m_device.m_device);
+                        check_errors(atcab_nonce_rand(this->m_numIn, randOut));
+                        check_errors(atcab_gendig(ATCA_ZONE_DATA, this->m_keyId, otherData, sizeof(otherData)));
+                        // Nonce and GenDig advanced it themselves; anything after them is a change to our TempKey
+                        this->m_epoch = this->m_device.m_halConfig.volatileEpoch;
+                    }
+
+                    struct atca_nonce_in_out nonce;
+                    memset(&nonce, 0, sizeof(nonce));
+                    nonce.mode     = NONCE_MODE_SEED_UPDATE;
+                    nonce.num_in   = this->m_numIn;
+                    nonce.rand_out = randOut;
+                    nonce.temp_key = &this->m_tempKey;
+                    check_errors(atcah_nonce(&nonce));
+
+                    struct atca_gen_dig_in_out genDig;
+                    memset(&genDig, 0, sizeof(genDig));
+                    genDig.zone         = ATCA_ZONE_DATA;
+                    genDig.key_id       = this->m_keyId;
+                    genDig.sn           = this->m_serialNumber;
+                    genDig.stored_value = this->m_key;
+                    genDig.other_data   = otherData;
+                    genDig.temp_key     = &this->m_tempKey;
+                    check_errors(atcah_gen_dig(&genDig));
+
+                    this->m_established = true;
+                    ++this->m_setups;
+                    return 0;
+                }
+
+                PropWare::ErrorCode read_once (const uint16_t slot, const uint8_t block,
+                                               uint8_t data[ATCA_BLOCK_SIZE]) {
+                    PropWare::ErrorCode err;
+                    {
+                        // Held from the TempKey check to the response: see the class description
+                        LibraryLock::Scope lock(this->m_device.m_device);
+                        check_errors(this->establish());
+                        check_errors(atcab_read_zone(ATCA_ZONE_DATA | ATCA_ZONE_READWRITE_32, slot, block, 0, data,
+                                                     ATCA_BLOCK_SIZE));
+                    }
+                    for (size_t i = 0; i < ATCA_BLOCK_SIZE; ++i)
+                        data[i] ^= this->m_tempKey.value[i];
+                    return 0;
+                }
+
+                PropWare::ErrorCode write_once (const uint16_t slot, const uint8_t block,
+                                                const uint8_t data[ATCA_BLOCK_SIZE]) {
+                    PropWare::ErrorCode err;
+                    // Held from the TempKey check to the response: see the class description
+                    LibraryLock::Scope  lock(this->m_device.m_device);
+                    check_errors(this->establish());
+
+                    uint16_t address;
+                    check_errors(atcab_get_addr(ATCA_ZONE_DATA, slot, block, 0, &address));
+
+                    uint8_t                      cipherText[ATCA_BLOCK_SIZE];
+                    uint8_t                      mac[WRITE_MAC_SIZE];
+                    struct atca_write_mac_in_out writeMac;
+                    memset(&writeMac, 0, sizeof(writeMac));
+                    writeMac.zone           = ATCA_ZONE_DATA | ATCA_ZONE_ENCRYPTED | ATCA_ZONE_READWRITE_32;
+                    writeMac.key_id         = address;
+                    writeMac.sn             = this->m_serialNumber;
+                    writeMac.input_data     = data;
+                    writeMac.encrypted_data = cipherText;
+                    writeMac.auth_mac       = mac;
+                    writeMac.temp_key       = &this->m_tempKey;
+                    check_errors(atcah_write_auth_mac(&writeMac));
+
+                    err = atcab_write(writeMac.zone, address, cipherText, mac);
+                    // A failed write may still have landed, so forget about the target either way
+                    this->m_device.forget_public_key(slot);
+                    return err;
+                }
+
+            private:
+                CryptoDevice         &m_device;
+                const Session        m_session;
+                const uint16_t       m_keyId;
+                const uint8_t *const m_key;
+                const uint8_t *const m_numIn;
+                uint8_t              m_serialNumber[ATCA_SERIAL_NUM_SIZE];
+                struct atca_temp_key m_tempKey;
+                bool                 m_established;
+                uint32_t             m_epoch;
+                unsigned int         m_setups;
+        };
+
+        /**
+         * @brief Background work for the worker cog, done a short step at a time whenever no command is queued
+         */
+        class IdleTask {
+            public:
+                /**
+                 * @return True if run() has something to do. Called from the worker cog only.
+                 */
+                virtual bool pending () = 0;
+
+                /**
+                 * @brief Do one step. Runs in the worker cog, inside a session and holding the library lock.
+                 */
+                virtual PropWare::ErrorCode run () = 0;
+        };
+
+        /**
+         * @brief Bus timing for one device, as found by calibrate() and kept in non-volatile storage between boots
+         *
+         * Sealed with a CRC so that blank or stale storage is never mistaken for a result.
+         */
+        struct LinkSettings {
+            static const uint32_t MAGIC = 0x4B4E494C; // "LINK"
+
+            uint32_t magic;
+            uint32_t baud;
+            uint16_t wakeDelay;
+            uint8_t  bus;
+            uint8_t  address;
+            uint16_t crc;
+
+            void seal () {
+                this->magic = MAGIC;
+                this->crc   = this->compute_crc();
+            }
+
+            bool valid () const {
+                return MAGIC == this->magic && this->compute_crc() == this->crc;
+            }
+
+            private:
+                uint16_t compute_crc () const {
+                    uint8_t crc[ATCA_CRC_SIZE];
+                    atCRC(offsetof(LinkSettings, crc), reinterpret_cast<const uint8_t *>(this), crc);
+                    return static_cast<uint16_t>(crc[0] | (crc[1] << 8));
+                }
+        };
 
     public:
         CryptoDevice (const uint8_t slaveAddress = SHA256_DEFAULT_ADDRESS,
@@ -51,37 +409,410 @@ class CryptoDevice {
             this->m_configuration.atcai2c.bus           = bus;
             this->m_configuration.wake_delay            = wakeDelay;
             this->m_configuration.rx_retries            = rxRetries;
+            this->m_configuration.cfg_data              = &this->m_halConfig;
+            this->m_device                              = NULL;
+
+            this->set_idle_policy(AUTOMATIC);
+            this->m_sessionDepth  = 0;
+            this->m_sessionCount  = 0;
+            this->m_lastSessionAt = 0;
+            this->m_averageGapMs  = 0;
+
+            for (auto &job : this->m_jobs)
+                job.state = JOB_FREE;
+            this->m_queueHead    = 0;
+            this->m_queueTail    = 0;
+            this->m_nextSequence = 1;
+            this->m_idleTask     = NULL;
+
+            this->invalidate_cache();
         }
 
         /**
-         * @brief Prepare the library's state variables
+         * @brief Prepare the library's state variables and make this the device that `atcab_*` calls talk to
          *
-         * No wake is necessary - the library will issue a wake before each command is sent
+         * No wake is necessary - the library will issue a wake before each command is sent. Each CryptoDevice keeps a
+         * library context of its own, so several devices can be initialized and then switched between with select().
          *
          * @return 0 upon success, error code otherwise
          */
         PropWare::ErrorCode initialize () {
-            return atcab_init(&this->m_configuration);
+            if (!this->m_device) {
+                this->m_device = newATCADevice(&this->m_configuration);
+                if (!this->m_device)
+                    return ATCA_COMM_FAIL;
+            }
+            return this->select();
+        }
+
+        /**
+         * @brief Direct subsequent `atcab_*` calls to this device
+         *
+         * Assigns the library's current device through hal_prop_select_device(). The device selected before is left
+         * intact, so pools may switch between their members for every command.
+         *
+         * @return 0 upon success, ATCA_BAD_PARAM before initialize()
+         */
+        PropWare::ErrorCode select () {
+            if (!this->m_device)
+                return ATCA_BAD_PARAM;
+            hal_prop_select_device(this->m_device);
+            return 0;
+        }
+
+        /**
+         * @brief Choose how the device is left between sessions
+         *
+         * @param[in] policy
+         * @param[in] busyGapMs     With the AUTOMATIC policy, the device idles while the average gap between recent
+         *                          sessions is shorter than this and sleeps otherwise
+         */
+        void set_idle_policy (const IdlePolicy policy, const uint32_t busyGapMs = DEFAULT_BUSY_GAP_MS) {
+            this->m_idlePolicy = policy;
+            this->m_busyGapMs  = busyGapMs;
+        }
+
+        /**
+         * @brief Choose how the HAL waits for each command to finish executing
+         *
+         * @param[in] mode
+         * @param[in] pollIntervalUs    Time between address polls with COMPLETION_ACK_POLLING
+         * @param[in] report            Optional record of the latency saved per opcode
+         */
+        void set_completion_mode (const CompletionMode mode,
+                                  const uint16_t pollIntervalUs = PropHalConfig::DEFAULT_POLL_INTERVAL_US,
+                                  CompletionReport *report = NULL) {
+            this->m_halConfig.completion       = mode;
+            this->m_halConfig.pollIntervalUs   = pollIntervalUs;
+            this->m_halConfig.completionReport = report;
+        }
+
+        /**
+         * @brief Choose how the HAL deals with damaged responses
+         *
+         * @param[in] mode
+         * @param[in] maxRereads    With RECEIVE_REREAD_ON_CRC_ERROR, how many times one response may be read again
+         */
+        void set_receive_mode (const ReceiveMode mode, const uint8_t maxRereads = PropHalConfig::DEFAULT_MAX_REREADS) {
+            this->m_halConfig.receive    = mode;
+            this->m_halConfig.maxRereads = maxRereads;
+        }
+
+#ifdef PROPCRYPTO_HAL_STATS
+        /**
+         * @brief Have the HAL record latency, retries and NACKs for this device's commands
+         *
+         * @param[in] stats     Must outlive the device's use of the library. NULL to stop recording.
+         */
+        void set_hal_stats (HalStats *const stats) {
+            this->m_halConfig.stats = stats;
+        }
+
+#endif
+        /**
+         * @brief Choose the code that drives the I2C bus. Takes effect at the next initialize().
+         */
+        void set_transport (const Transport transport) {
+            this->m_halConfig.transport = transport;
+        }
+
+        /**
+         * @brief Find the fastest bus timing this board runs reliably and switch to it
+         *
+         * Tries each baud from 1 MHz down, with the longest wake delay, until one passes `checks` consecutive
+         * wake-from-sleep and serial number reads. At that baud, a binary search then finds the shortest wake delay
+         * that passes as well, which gets WAKE_DELAY_MARGIN_PCT on top. Every read is compared against the serial
+         * number read at the slowest settings first, so a corrupted response counts as a failure even if its CRC
+         * happens to match.
+         *
+         * Puts the device to sleep many times, so do not call it within a session or while the worker is running.
+         * Store the result and hand it to apply_link_settings() on later boots instead of calibrating again.
+         *
+         * @param[out]  result  Optional: the chosen settings, sealed
+         * @param[in]   checks  Consecutive passes required of every setting
+         *
+         * @return 0 upon success. If even the slowest settings fail, that error code, with the previous settings
+         *         restored.
+         */
+        PropWare::ErrorCode calibrate (LinkSettings *result = NULL, const unsigned int checks = DEFAULT_LINK_CHECKS) {
+            static const uint32_t BAUDS[] = {1000000, 800000, 400000, 200000, 100000};
+            static const size_t   SLOWEST = sizeof(BAUDS) / sizeof(BAUDS[0]) - 1;
+
+            PropWare::ErrorCode err;
+            if (this->m_sessionDepth)
+                return ATCA_FUNC_FAIL;
+            check_errors(this->initialize());
+
+            // Held for the whole calibration, so that no other cog's command reaches this device at a trial setting.
+            // Each command still yields the lock while it executes, but only to cogs using other devices.
+            LibraryLock::Scope lock(this->m_device);
+            const uint32_t originalBaud      = this->m_configuration.atcai2c.baud;
+            const uint16_t originalWakeDelay = this->m_configuration.wake_delay;
+            uint8_t        reference[ATCA_SERIAL_NUM_SIZE];
+
+            this->set_link_timing(BAUDS[SLOWEST], MAX_WAKE_DELAY);
+            err = atcab_read_serial_number(reference);
+            if (err) {
+                this->set_link_timing(originalBaud, originalWakeDelay);
+                return err;
+            }
+
+            size_t baud = 0;
+            while (baud < SLOWEST && !this->link_checks_pass(BAUDS[baud], MAX_WAKE_DELAY, reference, checks))
+                ++baud;
+
+            // The longest delay is known to pass (or nothing does, and the slowest baud is as good as any)
+            uint16_t shortest = MAX_WAKE_DELAY;
+            uint16_t longest  = MIN_WAKE_DELAY;
+            if (this->link_checks_pass(BAUDS[baud], MIN_WAKE_DELAY, reference, checks))
+                shortest = MIN_WAKE_DELAY;
+            while (shortest - longest > WAKE_DELAY_RESOLUTION) {
+                const auto delay = static_cast<uint16_t>((shortest + longest) / 2);
+                if (this->link_checks_pass(BAUDS[baud], delay, reference, checks))
+                    shortest = delay;
+                else
+                    longest = delay;
+            }
+            const uint32_t wakeDelay = shortest + shortest * WAKE_DELAY_MARGIN_PCT / 100;
+
+            this->set_link_timing(BAUDS[baud], static_cast<uint16_t>(wakeDelay < MAX_WAKE_DELAY ? wakeDelay
+                                                                                                : MAX_WAKE_DELAY));
+            if (result)
+                *result = this->link_settings();
+            return 0;
+        }
+
+        /**
+         * @return The bus timing in use, sealed, for storing between boots
+         */
+        LinkSettings link_settings () const {
+            LinkSettings settings;
+            memset(&settings, 0, sizeof(settings));
+            settings.baud      = this->m_configuration.atcai2c.baud;
+            settings.wakeDelay = this->m_configuration.wake_delay;
+            settings.bus       = this->m_configuration.atcai2c.bus;
+            settings.address   = this->m_configuration.atcai2c.slave_address;
+            settings.seal();
+            return settings;
+        }
+
+        /**
+         * @brief Switch to previously calibrated bus timing, starting with the next transaction
+         *
+         * @return False, leaving the timing unchanged, if the settings are invalid or belong to another device
+         */
+        bool apply_link_settings (const LinkSettings &settings) {
+            if (!settings.valid() || settings.bus != this->m_configuration.atcai2c.bus
+                || settings.address != this->m_configuration.atcai2c.slave_address)
+                return false;
+            this->set_link_timing(settings.baud, settings.wakeDelay);
+            return true;
         }
 
         PropWare::ErrorCode sleep () {
             PropWare::ErrorCode err;
+            this->m_halConfig.holdAwake = false;
+            this->m_sessionDepth        = 0;
+            LibraryLock::Scope lock(this->m_device);
+            check_errors(this->select());
             check_errors(atcab_sleep());
-            check_errors(atcab_release());
-            return 0;
+            // Frees the library's current device, which select() made ours
+            err            = atcab_release();
+            this->m_device = NULL;
+            return err;
         }
 
-        PropWare::ErrorCode print_serial (const Printer &printer) const {
+        PropWare::ErrorCode print_serial (const Printer &printer) {
             PropWare::ErrorCode err;
             uint8_t             serialNumber[ATCA_SERIAL_NUM_SIZE];
-            check_errors(atcab_read_serial_number(serialNumber));
+            check_errors(this->read_serial_number(serialNumber));
             printer << "Serial number: ";
             print_block(printer, serialNumber, ATCA_SERIAL_NUM_SIZE);
             return 0;
         }
 
+        /*
+         * Metadata lookups
+         *
+         * The serial number, revision, configuration zone, lock state and public keys change only when this object
+         * writes, locks or generates keys, so each is read from the device once and then served from hub RAM without
+         * touching the bus. The configuration zone is cached per 32-byte block: the serial number and revision need
+         * only block 0 and the lock state only block 2.
+         *
+         * Changes made behind this object's back (a ConfigZone applied without apply_config(), raw `atcab_*` calls,
+         * another host) are not seen until invalidate_cache().
+         */
+
+        PropWare::ErrorCode read_serial_number (uint8_t serialNumber[ATCA_SERIAL_NUM_SIZE]) {
+            PropWare::ErrorCode err;
+            check_errors(this->load_config_block(0));
+            memcpy(serialNumber, &this->m_config[0], 4);
+            memcpy(&serialNumber[4], &this->m_config[8], ATCA_SERIAL_NUM_SIZE - 4);
+            return 0;
+        }
+
+        PropWare::ErrorCode read_revision (uint8_t revision[REVISION_SIZE]) {
+            PropWare::ErrorCode err;
+            check_errors(this->load_config_block(0));
+            memcpy(revision, &this->m_config[4], REVISION_SIZE);
+            return 0;
+        }
+
+        PropWare::ErrorCode read_config_zone (uint8_t config[ATCA_ECC_CONFIG_SIZE]) {
+            PropWare::ErrorCode err;
+            for (uint8_t block = 0; block < CONFIG_BLOCKS; ++block)
+                check_errors(this->load_config_block(block));
+            memcpy(config, this->m_config, ATCA_ECC_CONFIG_SIZE);
+            return 0;
+        }
+
+        /**
+         * @param[in]   zone        LOCK_ZONE_CONFIG or LOCK_ZONE_DATA
+         * @param[out]  isLocked
+         */
+        PropWare::ErrorCode is_locked (const uint8_t zone, bool *isLocked) {
+            PropWare::ErrorCode err;
+            check_errors(this->load_config_block(LOCK_BLOCK));
+            *isLocked = LOCK_BYTE_UNLOCKED != this->m_config[LOCK_ZONE_CONFIG == zone ? LOCK_CONFIG : LOCK_VALUE];
+            return 0;
+        }
+
+        PropWare::ErrorCode is_slot_locked (const uint16_t slot, bool *isLocked) {
+            PropWare::ErrorCode err;
+            check_errors(this->load_config_block(LOCK_BLOCK));
+            *isLocked = !(this->m_config[SLOT_LOCKED + slot / 8] & (1 << (slot % 8)));
+            return 0;
+        }
+
+        /**
+         * @brief Public key of the private key in `slot`, or the public key stored in `slot`, as its KeyConfig says
+         */
+        PropWare::ErrorCode get_public_key (const uint16_t slot, uint8_t publicKey[ATCA_PUB_KEY_SIZE]) {
+            PropWare::ErrorCode err;
+            const PublicKeyEntry *const cached = this->find_public_key(slot);
+            if (cached) {
+                memcpy(publicKey, cached->key, ATCA_PUB_KEY_SIZE);
+                return 0;
+            }
+
+            check_errors(this->load_config_block(KEY_CONFIG_BLOCK));
+            const size_t    keyConfigOffset = KEY_CONFIG_OFFSET + 2 * slot;
+            const KeyConfig keyConfig(static_cast<uint16_t>(this->m_config[keyConfigOffset]
+                                                            | (this->m_config[keyConfigOffset + 1] << 8)));
+            {
+                LibraryLock::Scope lock(this->m_device);
+                if (keyConfig.is_private())
+                    err = atcab_get_pubkey(slot, publicKey);
+                else
+                    err = atcab_read_pubkey(slot, publicKey);
+            }
+            if (err)
+                return err;
+            this->store_public_key(slot, publicKey);
+            return 0;
+        }
+
+        /**
+         * @brief Forget everything looked up so far
+         */
+        void invalidate_cache () {
+            this->m_configBlocksCached = 0;
+            for (auto &entry : this->m_publicKeys)
+                entry.slot = NO_SLOT;
+            this->m_nextPublicKey = 0;
+        }
+
+        /*
+         * Calls that change cached metadata. Each keeps the cache exact by updating or dropping only what it touched.
+         */
+
+        /**
+         * @brief Same as `atcab_write_zone()`
+         */
+        PropWare::ErrorCode write_zone (const uint8_t zone, const uint16_t slot, const uint8_t block,
+                                        const uint8_t offset, const uint8_t *data, const uint8_t length) {
+            LibraryLock::Scope lock(this->m_device);
+            const auto         err = atcab_write_zone(zone, slot, block, offset, data, length);
+            // A failed write may still have landed, so forget about the target either way
+            if (ATCA_ZONE_CONFIG == (zone & ATCA_ZONE_MASK))
+                this->m_configBlocksCached &= ~(1 << block);
+            else if (ATCA_ZONE_DATA == (zone & ATCA_ZONE_MASK))
+                this->forget_public_key(slot);
+            return err;
+        }
+
+        /**
+         * @brief Load `zone` with this device's configuration zone, read from the device rather than the cache
+         */
+        PropWare::ErrorCode read_config (ConfigZone &zone) {
+            LibraryLock::Scope lock(this->m_device);
+            return zone.read();
+        }
+
+        /**
+         * @brief Write the pending edits of `zone`, which must have been read from this device, to this device
+         *
+         * @param[out] bytesWritten     Optional: configuration bytes sent
+         */
+        PropWare::ErrorCode apply_config (ConfigZone &zone, size_t *bytesWritten = NULL) {
+            ConfigZone::Write  writes[ConfigZone::MAX_WRITES];
+            const size_t       count = zone.plan(writes);
+            LibraryLock::Scope lock(this->m_device);
+            // Forgotten up front: a write that fails may still have landed, and so may the ones before it
+            for (size_t i = 0; i < count; ++i)
+                this->m_configBlocksCached &= ~(1 << (writes[i].offset / ATCA_BLOCK_SIZE));
+            return zone.apply(bytesWritten);
+        }
+
+        /**
+         * @brief Lock this device's configuration zone, refusing if its contents differ from `zone`'s edited image
+         */
+        PropWare::ErrorCode lock_config (const ConfigZone &zone) {
+            return this->lock_config_zone(zone.crc());
+        }
+
+        PropWare::ErrorCode write_public_key (const uint16_t slot, const uint8_t publicKey[ATCA_PUB_KEY_SIZE]) {
+            PropWare::ErrorCode err;
+            this->forget_public_key(slot);
+            LibraryLock::Scope lock(this->m_device);
+            check_errors(atcab_write_pubkey(slot, publicKey));
+            this->store_public_key(slot, publicKey);
+            return 0;
+        }
+
+        PropWare::ErrorCode lock_config_zone (const uint16_t summaryCrc) {
+            PropWare::ErrorCode err;
+            LibraryLock::Scope lock(this->m_device);
+            check_errors(atcab_lock_config_zone_crc(summaryCrc));
+            this->m_config[LOCK_CONFIG] = LOCK_BYTE_LOCKED;
+            return 0;
+        }
+
+        PropWare::ErrorCode lock_data_zone () {
+            PropWare::ErrorCode err;
+            LibraryLock::Scope lock(this->m_device);
+            check_errors(atcab_lock_data_zone());
+            this->m_config[LOCK_VALUE] = LOCK_BYTE_LOCKED;
+            return 0;
+        }
+
+        PropWare::ErrorCode lock_data_slot (const uint16_t slot) {
+            PropWare::ErrorCode err;
+            LibraryLock::Scope lock(this->m_device);
+            check_errors(atcab_lock_data_slot(slot));
+            this->m_config[SLOT_LOCKED + slot / 8] &= ~(1 << (slot % 8));
+            return 0;
+        }
+
         PropWare::ErrorCode generate_key (const uint16_t keyId, const Printer *const printer = NULL) {
-            const auto err = atcab_genkey(keyId, this->m_publicKey);
+            this->forget_public_key(keyId);
+            PropWare::ErrorCode err;
+            {
+                LibraryLock::Scope lock(this->m_device);
+                err = atcab_genkey(keyId, this->m_publicKey);
+            }
+            if (!err)
+                this->store_public_key(keyId, this->m_publicKey);
             if (printer) {
                 if (err) {
                     printer->println("KEY GEN ERROR");
@@ -92,7 +823,484 @@ class CryptoDevice {
             return err;
         }
 
+        /**
+         * @brief Seal the batch and sign it with one device signature
+         *
+         * @return ATCA_BAD_PARAM if the batch is empty
+         */
+        template<size_t MAX_LEAVES>
+        PropWare::ErrorCode sign_batch (const uint16_t keyId, MerkleBatch<MAX_LEAVES> &batch) {
+            if (!batch.seal())
+                return ATCA_BAD_PARAM;
+            LibraryLock::Scope lock(this->m_device);
+            return atcab_sign(keyId, batch.digest(), batch.signature());
+        }
+
+        /**
+         * @brief Queue a key generation for the worker cog
+         *
+         * The submit_*() methods return immediately. All buffers belong to the caller and must stay valid until the
+         * command has been collected with wait(). Submit from one cog only, and do not mix submitted commands with
+         * direct (blocking) calls once the worker is running: the worker cog owns the library's context.
+         *
+         * @return Handle for is_complete() and wait(), or INVALID_HANDLE if the queue is full
+         */
+        Handle submit_genkey (const uint16_t keyId, uint8_t publicKey[ATCA_PUB_KEY_SIZE]) {
+            Job *const job = this->claim_job(ASYNC_GENKEY);
+            if (!job)
+                return INVALID_HANDLE;
+            job->keyId  = keyId;
+            job->result = publicKey;
+            return this->enqueue(job);
+        }
+
+        Handle submit_sign (const uint16_t keyId, const uint8_t digest[ATCA_SHA_DIGEST_SIZE],
+                            uint8_t signature[ATCA_SIG_SIZE]) {
+            Job *const job = this->claim_job(ASYNC_SIGN);
+            if (!job)
+                return INVALID_HANDLE;
+            job->keyId   = keyId;
+            job->message = digest;
+            job->result  = signature;
+            return this->enqueue(job);
+        }
+
+        /**
+         * @brief Seal the batch and queue its signature. The batch must not be reset before the command is collected.
+         *
+         * @return INVALID_HANDLE if the batch is empty or the queue is full
+         */
+        template<size_t MAX_LEAVES>
+        Handle submit_sign_batch (const uint16_t keyId, MerkleBatch<MAX_LEAVES> &batch) {
+            if (!batch.seal())
+                return INVALID_HANDLE;
+            return this->submit_sign(keyId, batch.digest(), batch.signature());
+        }
+
+        Handle submit_verify_extern (const uint8_t digest[ATCA_SHA_DIGEST_SIZE], const uint8_t signature[ATCA_SIG_SIZE],
+                                     const uint8_t publicKey[ATCA_PUB_KEY_SIZE], bool *verified) {
+            Job *const job = this->claim_job(ASYNC_VERIFY_EXTERN);
+            if (!job)
+                return INVALID_HANDLE;
+            job->message   = digest;
+            job->signature = signature;
+            job->publicKey = publicKey;
+            job->verified  = verified;
+            return this->enqueue(job);
+        }
+
+        Handle submit_random (uint8_t random[RANDOM_NUM_SIZE]) {
+            Job *const job = this->claim_job(ASYNC_RANDOM);
+            if (!job)
+                return INVALID_HANDLE;
+            job->result = random;
+            return this->enqueue(job);
+        }
+
+        Handle submit_read_serial (uint8_t serialNumber[ATCA_SERIAL_NUM_SIZE]) {
+            Job *const job = this->claim_job(ASYNC_READ_SERIAL);
+            if (!job)
+                return INVALID_HANDLE;
+            job->result = serialNumber;
+            return this->enqueue(job);
+        }
+
+        /**
+         * @brief Queue an `atcab_read_zone()`
+         */
+        Handle submit_read_zone (const uint8_t zone, const uint16_t slot, const uint8_t block, const uint8_t offset,
+                                 uint8_t *data, const uint8_t length) {
+            Job *const job = this->claim_job(ASYNC_READ_ZONE);
+            if (!job)
+                return INVALID_HANDLE;
+            job->zone   = zone;
+            job->keyId  = slot;
+            job->block  = block;
+            job->offset = offset;
+            job->length = length;
+            job->result = data;
+            return this->enqueue(job);
+        }
+
+        /**
+         * @brief Queue a write_zone()
+         */
+        Handle submit_write_zone (const uint8_t zone, const uint16_t slot, const uint8_t block, const uint8_t offset,
+                                  const uint8_t *data, const uint8_t length) {
+            Job *const job = this->claim_job(ASYNC_WRITE_ZONE);
+            if (!job)
+                return INVALID_HANDLE;
+            job->zone    = zone;
+            job->keyId   = slot;
+            job->block   = block;
+            job->offset  = offset;
+            job->length  = length;
+            job->message = data;
+            return this->enqueue(job);
+        }
+
+        /**
+         * @return Number of submitted commands the worker has not finished yet
+         */
+        size_t queue_depth () const {
+            return this->m_queueTail - this->m_queueHead;
+        }
+
+        /**
+         * @return True once the command's status and results are available. Does not block.
+         */
+        bool is_complete (const Handle handle) const {
+            const Job *const job = this->job_for(handle);
+            return job && JOB_DONE == job->state;
+        }
+
+        /**
+         * @brief Block until the command completes, then release its queue entry
+         *
+         * @return The command's status, or ATCA_BAD_PARAM if the handle is invalid or was already collected
+         */
+        PropWare::ErrorCode wait (const Handle handle) {
+            Job *const job = this->job_for(handle);
+            if (!job)
+                return ATCA_BAD_PARAM;
+            while (JOB_DONE != job->state);
+            const PropWare::ErrorCode status = job->status;
+            job->state = JOB_FREE;
+            return status;
+        }
+
+        /**
+         * @brief Give the worker cog something to do between commands
+         *
+         * A queued command waits for at most one step of the task. Set before starting the worker.
+         */
+        void set_idle_task (IdleTask *const task) {
+            this->m_idleTask = task;
+        }
+
+        /**
+         * @brief Body of the worker cog: initialize the library, then execute submitted commands forever
+         *
+         * Runs in its own cog by way of CryptoWorker. Commands that are queued back-to-back share one wake. Workers for
+         * different devices share the library through LibraryLock, taken per command, overlapping one device's
+         * execution time with another's bus traffic.
+         */
+        void serve () {
+            PropWare::ErrorCode initStatus;
+            {
+                LibraryLock::Scope lock(NULL);
+                initStatus = this->initialize();
+            }
+
+            while (true) {
+                while (this->m_queueHead == this->m_queueTail && !(!initStatus && this->idle_task_pending()));
+
+                if (initStatus) {
+                    this->complete_next_job(initStatus);
+                } else {
+                    // The lock is taken per command, so other cogs' commands slot in between ours
+                    Session session(*this);
+                    while (true) {
+                        if (this->m_queueHead != this->m_queueTail) {
+                            Job &job = this->m_jobs[this->m_pending[this->m_queueHead % QUEUE_DEPTH]];
+                            job.state = JOB_RUNNING;
+                            PropWare::ErrorCode status;
+                            {
+                                LibraryLock::Scope lock(this->m_device);
+                                status = this->execute(job);
+                            }
+                            this->complete_next_job(status);
+                        } else if (this->idle_task_pending()) {
+                            LibraryLock::Scope lock(this->m_device);
+                            this->m_idleTask->run();
+                        } else {
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+
     protected:
-        ATCAIfaceCfg m_configuration;
-        uint8_t      m_publicKey[ATCA_PUB_KEY_SIZE];
+        static const uint8_t  CONFIG_BLOCKS      = ATCA_ECC_CONFIG_SIZE / ATCA_BLOCK_SIZE;
+        static const uint8_t  LOCK_BLOCK         = 2;
+        static const uint8_t  KEY_CONFIG_BLOCK   = 3;
+        static const size_t   LOCK_VALUE         = 86;
+        static const size_t   LOCK_CONFIG        = 87;
+        static const size_t   SLOT_LOCKED        = 88;
+        static const size_t   KEY_CONFIG_OFFSET  = 96;
+        static const uint8_t  LOCK_BYTE_UNLOCKED = 0x55;
+        static const uint8_t  LOCK_BYTE_LOCKED   = 0x00;
+        static const uint16_t NO_SLOT            = 0xFFFF;
+
+        typedef enum {
+            JOB_FREE,
+            JOB_QUEUED,
+            JOB_RUNNING,
+            JOB_DONE
+        } JobState;
+
+        struct PublicKeyEntry {
+            uint16_t slot;
+            uint8_t  key[ATCA_PUB_KEY_SIZE];
+        };
+
+        struct Job {
+            volatile JobState            state;
+            volatile PropWare::ErrorCode status;
+            Handle                       handle;
+            AsyncCommand                 command;
+            uint16_t                     keyId;
+            uint8_t                      zone;
+            uint8_t                      block;
+            uint8_t                      offset;
+            uint8_t                      length;
+            const uint8_t                *message;
+            const uint8_t                *signature;
+            const uint8_t                *publicKey;
+            uint8_t                      *result;
+            bool                         *verified;
+        };
+
+    protected:
+        Job *claim_job (const AsyncCommand command) {
+            for (auto &job : this->m_jobs)
+                if (JOB_FREE == job.state) {
+                    job.command = command;
+                    return &job;
+                }
+            return NULL;
+        }
+
+        Handle enqueue (Job *const job) {
+            const auto index = static_cast<uint8_t>(job - this->m_jobs);
+
+            // The upper bits tell a stale handle apart from the command now using the same entry
+            job->handle = (this->m_nextSequence << 8) | index;
+            if (!++this->m_nextSequence)
+                this->m_nextSequence = 1;
+
+            job->state                                        = JOB_QUEUED;
+            this->m_pending[this->m_queueTail % QUEUE_DEPTH] = index;
+            ++this->m_queueTail;
+            return job->handle;
+        }
+
+        void complete_next_job (const PropWare::ErrorCode status) {
+            Job &job = this->m_jobs[this->m_pending[this->m_queueHead % QUEUE_DEPTH]];
+            job.status = status;
+            job.state  = JOB_DONE;
+            ++this->m_queueHead;
+        }
+
+        Job *job_for (const Handle handle) {
+            Job *const job = &this->m_jobs[(handle & 0xFF) % QUEUE_DEPTH];
+            return (INVALID_HANDLE != handle && job->handle == handle && JOB_FREE != job->state) ? job : NULL;
+        }
+
+        const Job *job_for (const Handle handle) const {
+            return const_cast<CryptoDevice *>(this)->job_for(handle);
+        }
+
+        PropWare::ErrorCode execute (Job &job) {
+            switch (job.command) {
+                case ASYNC_GENKEY: {
+                    this->forget_public_key(job.keyId);
+                    const auto err = atcab_genkey(job.keyId, job.result);
+                    if (!err)
+                        this->store_public_key(job.keyId, job.result);
+                    return err;
+                }
+                case ASYNC_SIGN:
+                    return atcab_sign(job.keyId, job.message, job.result);
+                case ASYNC_VERIFY_EXTERN:
+                    return atcab_verify_extern(job.message, job.signature, job.publicKey, job.verified);
+                case ASYNC_RANDOM:
+                    return atcab_random(job.result);
+                case ASYNC_READ_SERIAL:
+                    return this->read_serial_number(job.result);
+                case ASYNC_READ_ZONE:
+                    return atcab_read_zone(job.zone, job.keyId, job.block, job.offset, job.result, job.length);
+                case ASYNC_WRITE_ZONE:
+                    return this->write_zone(job.zone, job.keyId, job.block, job.offset, job.message, job.length);
+                default:
+                    return ATCA_BAD_PARAM;
+            }
+        }
+
+        /**
+         * The HAL reads both from the interface's configuration on every transaction, so they take effect at once
+         */
+        void set_link_timing (const uint32_t baud, const uint16_t wakeDelay) {
+            this->m_configuration.atcai2c.baud = baud;
+            this->m_configuration.wake_delay   = wakeDelay;
+            if (this->m_device) {
+                ATCAIfaceCfg *const active = atgetifacecfg(atGetIFace(this->m_device));
+                active->atcai2c.baud = baud;
+                active->wake_delay   = wakeDelay;
+            }
+        }
+
+        bool link_checks_pass (const uint32_t baud, const uint16_t wakeDelay,
+                               const uint8_t reference[ATCA_SERIAL_NUM_SIZE], const unsigned int checks) {
+            for (unsigned int i = 0; i < checks; ++i) {
+                uint8_t serialNumber[ATCA_SERIAL_NUM_SIZE];
+
+                // Every check has to start from sleep to exercise a real wake. A device that is idle, or still
+                // finishing the wake of a failed check, ignores the sleep command, so wake it properly first.
+                this->set_link_timing(baud, MAX_WAKE_DELAY);
+                atcab_wakeup();
+                atcab_sleep();
+
+                this->set_link_timing(baud, wakeDelay);
+                if (atcab_read_serial_number(serialNumber)
+                    || memcmp(serialNumber, reference, ATCA_SERIAL_NUM_SIZE))
+                    return false;
+            }
+            return true;
+        }
+
+        bool idle_task_pending () const {
+            return this->m_idleTask && this->m_idleTask->pending();
+        }
+
+        PropWare::ErrorCode load_config_block (const uint8_t block) {
+            PropWare::ErrorCode err;
+            if (this->m_configBlocksCached & (1 << block))
+                return 0;
+            LibraryLock::Scope lock(this->m_device);
+            check_errors(atcab_read_zone(ATCA_ZONE_CONFIG, 0, block, 0, &this->m_config[block * ATCA_BLOCK_SIZE],
+                                         ATCA_BLOCK_SIZE));
+            this->m_configBlocksCached |= 1 << block;
+            return 0;
+        }
+
+        PublicKeyEntry *find_public_key (const uint16_t slot) {
+            for (auto &entry : this->m_publicKeys)
+                if (entry.slot == slot)
+                    return &entry;
+            return NULL;
+        }
+
+        void forget_public_key (const uint16_t slot) {
+            PublicKeyEntry *const entry = this->find_public_key(slot);
+            if (entry)
+                entry->slot = NO_SLOT;
+        }
+
+        /**
+         * Replaces entries round-robin: applications look up a handful of keys over and over, which all fit
+         */
+        void store_public_key (const uint16_t slot, const uint8_t publicKey[ATCA_PUB_KEY_SIZE]) {
+            PublicKeyEntry *entry = this->find_public_key(slot);
+            if (!entry) {
+                entry = &this->m_publicKeys[this->m_nextPublicKey];
+                this->m_nextPublicKey = (this->m_nextPublicKey + 1) % PUBLIC_KEY_CACHE_SIZE;
+            }
+            entry->slot = slot;
+            memcpy(entry->key, publicKey, ATCA_PUB_KEY_SIZE);
+        }
+
+        PropWare::ErrorCode begin_session () {
+            if (this->m_sessionDepth++)
+                return 0;
+
+            // Moving average of the gap between sessions, weighted towards the most recent traffic. Gaps longer than
+            // the counter's wrap-around (53 s at 80 MHz) are indistinguishable from short ones, which costs idle
+            // current but never correctness.
+            const uint32_t now = CNT;
+            if (this->m_sessionCount++) {
+                const uint32_t gapMs = (now - this->m_lastSessionAt) / MILLISECOND;
+                this->m_averageGapMs = (3 * this->m_averageGapMs + gapMs) / 4;
+            } else {
+                this->m_averageGapMs = this->m_busyGapMs;
+            }
+
+            this->m_halConfig.holdAwake = true;
+            LibraryLock::Scope lock(this->m_device);
+            return atcab_wakeup();
+        }
+
+        PropWare::ErrorCode end_session () {
+            if (!this->m_sessionDepth || --this->m_sessionDepth)
+                return 0;
+
+            this->m_halConfig.holdAwake = false;
+            this->m_lastSessionAt       = CNT;
+            LibraryLock::Scope lock(this->m_device);
+            if (this->idle_between_sessions())
+                return atcab_idle();
+            else
+                return atcab_sleep();
+        }
+
+        bool idle_between_sessions () const {
+            switch (this->m_idlePolicy) {
+                case IDLE_BETWEEN_SESSIONS:
+                    return true;
+                case SLEEP_BETWEEN_SESSIONS:
+                    return false;
+                default:
+                    return this->m_averageGapMs < this->m_busyGapMs;
+            }
+        }
+
+    protected:
+        ATCAIfaceCfg  m_configuration;
+        PropHalConfig m_halConfig;
+        ATCADevice    m_device;
+        uint8_t       m_publicKey[ATCA_PUB_KEY_SIZE];
+
+        /** Only the blocks whose bit is set in m_configBlocksCached are valid */
+        uint8_t        m_config[ATCA_ECC_CONFIG_SIZE];
+        uint8_t        m_configBlocksCached;
+        PublicKeyEntry m_publicKeys[PUBLIC_KEY_CACHE_SIZE];
+        size_t         m_nextPublicKey;
+
+        IdlePolicy    m_idlePolicy;
+        uint32_t      m_busyGapMs;
+        unsigned int  m_sessionDepth;
+        uint32_t      m_sessionCount;
+        uint32_t      m_lastSessionAt;
+        uint32_t      m_averageGapMs;
+
+        Job               m_jobs[QUEUE_DEPTH];
+        volatile uint8_t  m_pending[QUEUE_DEPTH];
+        /** Advanced by the worker cog only */
+        volatile uint32_t m_queueHead;
+        /** Advanced by the submitting cog only */
+        volatile uint32_t m_queueTail;
+        uint32_t          m_nextSequence;
+        IdleTask          *m_idleTask;
+};
+
+/**
+ * @brief Runs CryptoDevice::serve() in a cog of its own
+ *
+ * @code
+ * uint32_t     workerStack[256];
+ * CryptoWorker worker(workerStack, cryptoDevice);
+ * PropWare::Runnable::invoke(worker);
+ *
+ * const auto handle = cryptoDevice.submit_sign(0, digest, signature);
+ * while (!cryptoDevice.is_complete(handle))
+ *     service_network();
+ * check_errors(cryptoDevice.wait(handle));
+ * @endcode
+ */
+class CryptoWorker : public PropWare::Runnable {
+    public:
+        template<size_t N>
+        CryptoWorker (const uint32_t (&stack)[N], CryptoDevice &device)
+                : Runnable(stack),
+                  m_device(device) {
+            LibraryLock::start();
+        }
+
+        virtual void run () {
+            this->m_device.serve();
+        }
+
+    private:
+        CryptoDevice &m_device;
 };
@@ -0,0 +1,399 @@
+/**
+ * @file    DeviceImage.cpp
+ *
+ * @author  David Zemon
+ *
+ * @copyright
+ * The MIT License (MIT)<br>
+ * <br>Copyright (c) 2019 David Zemon<br>
+ * <br>Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:<br>
+ * <br>The above copyright notice and this permission notice shall be included in all copies or substantial portions
+ * of the Software.<br>
+ * <br>THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "DeviceImage.h"
+
+#include <PropWare/memory/blockstorage.h>
+
+#include <cstring>
+
+static const size_t  LOCK_VALUE         = 86;
+static const size_t  LOCK_CONFIG        = 87;
+static const size_t  SLOT_LOCKED        = 88;
+static const size_t  SLOT_CONFIG_OFFSET = 20;
+static const uint8_t LOCK_BYTE_UNLOCKED = 0x55;
+static const uint8_t SLOT_COUNT         = 16;
+
+DeviceImage::DeviceImage (CryptoDevice &device)
+        : m_device(device),
+          m_sectorSize(0),
+          m_sectorAddress(0),
+          m_sectorPosition(0),
+          m_submitted(0),
+          m_completed(0) {
+    memset(&this->m_header, 0, sizeof(this->m_header));
+    memset(&this->m_stats, 0, sizeof(this->m_stats));
+}
+
+PropWare::ErrorCode DeviceImage::save (const PropWare::BlockStorage &storage, const uint32_t firstSector) {
+    PropWare::ErrorCode err;
+    check_errors(this->start(storage));
+
+    memset(&this->m_header, 0, sizeof(this->m_header));
+    this->m_header.magic      = ImageHeader::MAGIC;
+    this->m_header.version    = ImageHeader::VERSION;
+    this->m_header.sectorSize = static_cast<uint16_t>(this->m_sectorSize);
+    this->add_section(ATCA_ZONE_CONFIG, 0, ATCA_ECC_CONFIG_SIZE);
+
+    this->m_sectorAddress  = firstSector + 1;
+    this->m_sectorPosition = 0;
+
+    // What else can be read depends on the configuration zone, so the pipeline empties once while that is decided
+    bool     planned  = false;
+    uint8_t  section  = 0;
+    uint16_t position = 0;
+    while (true) {
+        while (this->m_submitted - this->m_completed < PIPELINE_DEPTH && section < this->m_header.sectionCount) {
+            const ImageSection &next  = this->m_header.sections[section];
+            const Chunk        chunk = chunk_at(position, next.length, false);
+            err = this->submit(this->staging_entry(this->m_submitted), section, chunk, false);
+            if (err) {
+                this->drain();
+                return err;
+            }
+            position += chunk.length;
+            if (position == next.length) {
+                ++section;
+                position = 0;
+            }
+        }
+        if (this->m_submitted == this->m_completed)
+            break;
+
+        // The card write in put() runs while the worker carries on with the reads queued behind this one
+        const Pending &pending = this->staging_entry(this->m_completed);
+        err = this->complete();
+        if (!err) {
+            ImageSection  &received = this->m_header.sections[pending.section];
+            const uint8_t *data     = this->staging_block(pending);
+            received.crc = update_crc(received.crc, data, pending.length);
+            if (ATCA_ZONE_CONFIG == received.zone)
+                memcpy(&this->m_config[this->m_stats.bytes - received.offset], data, pending.length);
+            err = this->put(storage, data, pending.length);
+        }
+        if (err) {
+            this->drain();
+            return err;
+        }
+
+        if (!planned && ATCA_ECC_CONFIG_SIZE == this->m_stats.bytes) {
+            this->add_readable_sections();
+            planned = true;
+        }
+    }
+
+    if (this->m_sectorPosition) {
+        memset(&this->m_sector[this->m_sectorPosition], 0, this->m_sectorSize - this->m_sectorPosition);
+        check_errors(storage.write_data_block(this->m_sectorAddress, this->m_sector));
+        ++this->m_stats.sectors;
+    }
+
+    memcpy(this->m_header.serialNumber, &this->m_config[0], 4);
+    memcpy(&this->m_header.serialNumber[4], &this->m_config[8], ATCA_SERIAL_NUM_SIZE - 4);
+    this->m_header.crc = this->m_header.compute_crc();
+    memset(this->m_sector, 0, this->m_sectorSize);
+    memcpy(this->m_sector, &this->m_header, sizeof(this->m_header));
+    check_errors(storage.write_data_block(firstSector, this->m_sector));
+    ++this->m_stats.sectors;
+    this->m_stats.sections = this->m_header.sectionCount;
+    return 0;
+}
+
+PropWare::ErrorCode DeviceImage::restore (const PropWare::BlockStorage &storage, const uint32_t firstSector) {
+    PropWare::ErrorCode err;
+    check_errors(this->load_header(storage, firstSector));
+
+    // Check the whole image before the first write: a damaged image must not leave the device half restored
+    this->m_sectorAddress  = firstSector + 1;
+    this->m_sectorPosition = this->m_sectorSize;
+    uint32_t offset = 0;
+    for (uint8_t i = 0; i < this->m_header.sectionCount; ++i) {
+        const ImageSection &section = this->m_header.sections[i];
+        bool                wellFormed;
+        switch (section.zone) {
+            case ATCA_ZONE_CONFIG:
+                wellFormed = ATCA_ECC_CONFIG_SIZE == section.length;
+                break;
+            case ATCA_ZONE_OTP:
+                wellFormed = ATCA_OTP_SIZE == section.length;
+                break;
+            case ATCA_ZONE_DATA:
+                wellFormed = section.slot < SLOT_COUNT && slot_size(section.slot) == section.length;
+                break;
+            default:
+                wellFormed = false;
+        }
+        if (!wellFormed || section.offset != offset)
+            return ATCA_BAD_PARAM;
+
+        uint16_t crc = 0;
+        for (uint16_t position = 0; position < section.length; position += ATCA_BLOCK_SIZE) {
+            const uint16_t length = section.length - position < ATCA_BLOCK_SIZE ? section.length - position
+                                                                                : ATCA_BLOCK_SIZE;
+            check_errors(this->get(storage, this->m_staging[0], length));
+            crc = update_crc(crc, this->m_staging[0], length);
+        }
+        if (crc != section.crc)
+            return ATCA_BAD_CRC;
+        offset += section.length;
+    }
+
+    check_errors(this->read_config());
+
+    this->m_sectorAddress  = firstSector + 1;
+    this->m_sectorPosition = this->m_sectorSize;
+    for (uint8_t i = 0; i < this->m_header.sectionCount; ++i) {
+        const ImageSection &section = this->m_header.sections[i];
+        if (!this->writable(section)) {
+            err = this->get(storage, NULL, section.length);
+            if (err) {
+                this->drain();
+                return err;
+            }
+            ++this->m_stats.skipped;
+            continue;
+        }
+
+        const bool words    = ATCA_ZONE_CONFIG == section.zone;
+        uint16_t   position = 0;
+        while (position < section.length) {
+            const Chunk chunk = chunk_at(position, section.length, words);
+
+            // The card read in get() runs while the worker carries on with the writes already queued
+            err = 0;
+            if (PIPELINE_DEPTH == this->m_submitted - this->m_completed)
+                err = this->complete();
+            Pending &pending = this->staging_entry(this->m_submitted);
+            if (!err)
+                err = this->get(storage, this->staging_block(pending), chunk.length);
+            const bool unchanged = words && (!config_word_writable(position)
+                                             || !memcmp(&this->m_config[position], this->staging_block(pending),
+                                                        chunk.length));
+            if (!err && !unchanged) {
+                err = this->submit(pending, i, chunk, true);
+                if (!err)
+                    this->m_stats.bytes += chunk.length;
+            }
+            if (err) {
+                this->drain();
+                return err;
+            }
+            position += chunk.length;
+        }
+        ++this->m_stats.sections;
+    }
+
+    PropWare::ErrorCode result = 0;
+    while (this->m_submitted != this->m_completed) {
+        err = this->complete();
+        if (err && !result)
+            result = err;
+    }
+    return result;
+}
+
+PropWare::ErrorCode DeviceImage::load_header (const PropWare::BlockStorage &storage, const uint32_t firstSector) {
+    PropWare::ErrorCode err;
+    check_errors(this->start(storage));
+    check_errors(storage.read_data_block(firstSector, this->m_sector));
+    ++this->m_stats.sectors;
+    memcpy(&this->m_header, this->m_sector, sizeof(this->m_header));
+    if (!this->m_header.valid())
+        return ATCA_BAD_CRC;
+    if (this->m_header.sectorSize != this->m_sectorSize)
+        return ATCA_INVALID_SIZE;
+    return 0;
+}
+
+DeviceImage::Chunk DeviceImage::chunk_at (const uint16_t position, const uint16_t length, const bool words) {
+    Chunk chunk;
+    chunk.block  = static_cast<uint8_t>(position / ATCA_BLOCK_SIZE);
+    chunk.offset = static_cast<uint8_t>((position % ATCA_BLOCK_SIZE) / ATCA_WORD_SIZE);
+    if (!words && !(position % ATCA_BLOCK_SIZE) && length - position >= ATCA_BLOCK_SIZE)
+        chunk.length = ATCA_BLOCK_SIZE;
+    else
+        chunk.length = ATCA_WORD_SIZE;
+    return chunk;
+}
+
+uint16_t DeviceImage::update_crc (uint16_t crc, const uint8_t *data, const size_t length) {
+    static const uint16_t POLYNOMIAL = 0x8005;
+    for (size_t i = 0; i < length; ++i)
+        for (uint8_t bit = 0x01; bit; bit <<= 1) {
+            const bool dataBit = data[i] & bit;
+            const bool crcBit  = crc >> 15;
+            crc <<= 1;
+            if (dataBit != crcBit)
+                crc ^= POLYNOMIAL;
+        }
+    return crc;
+}
+
+PropWare::ErrorCode DeviceImage::start (const PropWare::BlockStorage &storage) {
+    this->m_sectorSize = storage.get_sector_size();
+    this->m_submitted  = 0;
+    this->m_completed  = 0;
+    memset(&this->m_stats, 0, sizeof(this->m_stats));
+    if (MAX_SECTOR_SIZE < this->m_sectorSize || sizeof(ImageHeader) > this->m_sectorSize)
+        return ATCA_INVALID_SIZE;
+    return 0;
+}
+
+void DeviceImage::add_section (const uint8_t zone, const uint8_t slot, const uint16_t length) {
+    const uint8_t count   = this->m_header.sectionCount;
+    ImageSection  &section = this->m_header.sections[count];
+    memset(&section, 0, sizeof(section));
+    if (count)
+        section.offset = this->m_header.sections[count - 1].offset + this->m_header.sections[count - 1].length;
+    section.length = length;
+    section.zone   = zone;
+    section.slot   = slot;
+    ++this->m_header.sectionCount;
+}
+
+void DeviceImage::add_readable_sections () {
+    if (LOCK_BYTE_UNLOCKED == this->m_config[LOCK_VALUE])
+        return;
+
+    this->add_section(ATCA_ZONE_OTP, 0, ATCA_OTP_SIZE);
+    for (uint8_t slot = 0; slot < SLOT_COUNT; ++slot) {
+        const size_t     offset = SLOT_CONFIG_OFFSET + 2 * slot;
+        const SlotConfig slotConfig(static_cast<uint16_t>(this->m_config[offset] | (this->m_config[offset + 1] << 8)));
+        if (!slotConfig.is_secret())
+            this->add_section(ATCA_ZONE_DATA, slot, slot_size(slot));
+    }
+}
+
+bool DeviceImage::writable (const ImageSection &section) const {
+    const bool configLocked = LOCK_BYTE_UNLOCKED != this->m_config[LOCK_CONFIG];
+    const bool dataLocked   = LOCK_BYTE_UNLOCKED != this->m_config[LOCK_VALUE];
+    switch (section.zone) {
+        case ATCA_ZONE_CONFIG:
+            return !configLocked;
+        case ATCA_ZONE_OTP:
+            // Once the data zone is locked, OTP bits can at most be consumed, which a restore must not do
+            return configLocked && !dataLocked;
+        case ATCA_ZONE_DATA: {
+            if (!configLocked)
+                return false;
+            if (!dataLocked)
+                return true;
+            const size_t     offset = SLOT_CONFIG_OFFSET + 2 * section.slot;
+            const SlotConfig slotConfig(static_cast<uint16_t>(this->m_config[offset]
+                                                              | (this->m_config[offset + 1] << 8)));
+            const bool       slotLocked = !(this->m_config[SLOT_LOCKED + section.slot / 8] & (1 << (section.slot % 8)));
+            return !slotLocked && 0 == slotConfig.write_config();
+        }
+        default:
+            return false;
+    }
+}
+
+PropWare::ErrorCode DeviceImage::read_config () {
+    static const uint8_t BLOCKS = ATCA_ECC_CONFIG_SIZE / ATCA_BLOCK_SIZE;
+
+    CryptoDevice::Handle handles[BLOCKS];
+    for (uint8_t block = 0; block < BLOCKS; ++block)
+        handles[block] = this->m_device.submit_read_zone(ATCA_ZONE_CONFIG, 0, block, 0,
+                                                         &this->m_config[block * ATCA_BLOCK_SIZE], ATCA_BLOCK_SIZE);
+
+    // An invalid handle (full queue) comes back as ATCA_BAD_PARAM
+    PropWare::ErrorCode result = 0;
+    for (const auto handle : handles) {
+        const PropWare::ErrorCode err = this->m_device.wait(handle);
+        if (err && !result)
+            result = err;
+    }
+    this->m_stats.commands += BLOCKS;
+    return result;
+}
+
+PropWare::ErrorCode DeviceImage::submit (Pending &pending, const uint8_t section, const Chunk &chunk,
+                                         const bool write) {
+    const ImageSection &target = this->m_header.sections[section];
+    uint8_t *const     block   = this->staging_block(pending);
+    pending.section = section;
+    pending.length  = chunk.length;
+    if (write)
+        pending.handle = this->m_device.submit_write_zone(target.zone, target.slot, chunk.block, chunk.offset, block,
+                                                          chunk.length);
+    else
+        pending.handle = this->m_device.submit_read_zone(target.zone, target.slot, chunk.block, chunk.offset, block,
+                                                         chunk.length);
+
+    // Someone else is filling the worker's queue
+    if (CryptoDevice::INVALID_HANDLE == pending.handle)
+        return ATCA_FUNC_FAIL;
+    ++this->m_submitted;
+    ++this->m_stats.commands;
+    return 0;
+}
+
+PropWare::ErrorCode DeviceImage::complete () {
+    const Pending &pending = this->staging_entry(this->m_completed++);
+    return this->m_device.wait(pending.handle);
+}
+
+void DeviceImage::drain () {
+    while (this->m_submitted != this->m_completed)
+        this->complete();
+}
+
+PropWare::ErrorCode DeviceImage::put (const PropWare::BlockStorage &storage, const uint8_t *data, size_t length) {
+    PropWare::ErrorCode err;
+    while (length) {
+        const size_t room  = this->m_sectorSize - this->m_sectorPosition;
+        const size_t chunk = length < room ? length : room;
+        memcpy(&this->m_sector[this->m_sectorPosition], data, chunk);
+        this->m_sectorPosition += chunk;
+        this->m_stats.bytes += chunk;
+        data += chunk;
+        length -= chunk;
+
+        if (this->m_sectorPosition == this->m_sectorSize) {
+            check_errors(storage.write_data_block(this->m_sectorAddress++, this->m_sector));
+            this->m_sectorPosition = 0;
+            ++this->m_stats.sectors;
+        }
+    }
+    return 0;
+}
+
+PropWare::ErrorCode DeviceImage::get (const PropWare::BlockStorage &storage, uint8_t *data, size_t length) {
+    PropWare::ErrorCode err;
+    while (length) {
+        if (this->m_sectorPosition == this->m_sectorSize) {
+            check_errors(storage.read_data_block(this->m_sectorAddress++, this->m_sector));
+            this->m_sectorPosition = 0;
+            ++this->m_stats.sectors;
+        }
+
+        const size_t available = this->m_sectorSize - this->m_sectorPosition;
+        const size_t chunk     = length < available ? length : available;
+        if (data) {
+            memcpy(data, &this->m_sector[this->m_sectorPosition], chunk);
+            data += chunk;
+        }
+        this->m_sectorPosition += chunk;
+        length -= chunk;
+    }
+    return 0;
+}
@@ -0,0 +1,284 @@
+/**
+ * @file    DeviceImage.h
+ *
+ * @author  David Zemon
+ *
+ * @copyright
+ * The MIT License (MIT)<br>
+ * <br>Copyright (c) 2019 David Zemon<br>
+ * <br>Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:<br>
+ * <br>The above copyright notice and this permission notice shall be included in all copies or substantial portions
+ * of the Software.<br>
+ * <br>THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "CryptoDevice.h"
+
+#include <atca_command.h>
+#include <PropWare/PropWare.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace PropWare {
+class BlockStorage;
+}
+
+/**
+ * @brief One zone or data slot in a device image
+ *
+ * Little-endian on both the Propeller and the hosts that read images, so the layout is used as-is on both ends.
+ */
+struct ImageSection {
+    /** Byte offset of the section's data, counted from the first sector after the header */
+    uint32_t offset;
+    uint16_t length;
+    /** CRC-16 (the CryptoAuth polynomial, as atCRC()) over the section's data */
+    uint16_t crc;
+    /** ATCA_ZONE_CONFIG, ATCA_ZONE_OTP or ATCA_ZONE_DATA */
+    uint8_t  zone;
+    /** Data slot, or 0 for the other zones */
+    uint8_t  slot;
+    uint8_t  reserved[2];
+};
+
+/**
+ * @brief First sector of a device image
+ *
+ * Written last, so that an interrupted export never leaves a valid image behind. Section data starts in the next
+ * sector and is packed back to back, across sector boundaries.
+ */
+struct ImageHeader {
+    static const uint32_t MAGIC        = 0x474D4941; // "AIMG"
+    static const uint16_t VERSION      = 1;
+    /** The configuration and OTP zones and every data slot */
+    static const size_t   MAX_SECTIONS = 18;
+
+    uint32_t     magic;
+    uint16_t     version;
+    uint16_t     sectorSize;
+    uint8_t      serialNumber[ATCA_SERIAL_NUM_SIZE];
+    uint8_t      sectionCount;
+    uint8_t      reserved[2];
+    ImageSection sections[MAX_SECTIONS];
+    /** CRC-16 over everything above */
+    uint16_t     crc;
+
+    uint16_t compute_crc () const {
+        uint8_t crc[ATCA_CRC_SIZE];
+        atCRC(offsetof(ImageHeader, crc), reinterpret_cast<const uint8_t *>(this), crc);
+        return static_cast<uint16_t>(crc[0] | (crc[1] << 8));
+    }
+
+    bool valid () const {
+        return MAGIC == this->magic && VERSION == this->version && this->sectionCount <= MAX_SECTIONS
+               && this->compute_crc() == this->crc;
+    }
+};
+
+/**
+ * @brief Dump a device's configuration zone, OTP zone and readable data slots to an SD card (or any other
+ *        BlockStorage), and write an image back
+ *
+ * The device's reads and writes go through its worker cog (see CryptoWorker), a few 32-byte blocks ahead, while this
+ * cog moves sectors to and from the card: the card's transfers overlap the device's commands. Everything passes
+ * through a single sector buffer and a handful of 32-byte staging blocks.
+ *
+ * Data slots are exported only once the data zone is locked (the device refuses to read them before), and only those
+ * that are not secret. An import first checks every section's CRC and then writes back what the device still
+ * accepts in the clear: the configuration zone while it is unlocked (except the bytes the Write command cannot
+ * change), the OTP zone and every slot while the data zone is unlocked, and afterwards the unlocked slots whose
+ * WriteConfig is "always". Everything else is skipped and counted.
+ *
+ * @code
+ * uint32_t     workerStack[256];
+ * CryptoWorker worker(workerStack, cryptoDevice);
+ * PropWare::Runnable::invoke(worker);
+ *
+ * PropWare::SD sd;
+ * check_errors(sd.start());
+ * DeviceImage image(cryptoDevice);
+ * check_errors(image.save(sd, IMAGE_FIRST_SECTOR));
+ * @endcode
+ */
+class DeviceImage {
+    public:
+        /** Largest sector size supported. SD cards use 512-byte sectors. */
+        static const size_t MAX_SECTOR_SIZE = 512;
+        /** Device commands queued ahead of the card. No more than CryptoDevice::QUEUE_DEPTH. */
+        static const size_t PIPELINE_DEPTH  = 4;
+
+        struct Stats {
+            uint8_t  sections;
+            /** Sections an import left alone because the device no longer accepts them */
+            uint8_t  skipped;
+            /** Device commands issued */
+            uint16_t commands;
+            /** Sections' data bytes exported or written back */
+            uint32_t bytes;
+            /** Card sectors read or written, header included */
+            uint32_t sectors;
+        };
+
+    public:
+        explicit DeviceImage (CryptoDevice &device);
+
+        /**
+         * @brief Export the device to the image at `firstSector`
+         *
+         * @param[in] storage       Started block device
+         * @param[in] firstSector   Address of the image's header; section data follows it
+         */
+        PropWare::ErrorCode save (const PropWare::BlockStorage &storage, const uint32_t firstSector);
+
+        /**
+         * @brief Write the image at `firstSector` back to the device, as far as the device allows
+         *
+         * Nothing is written unless the header and every section check out. The image may come from another device:
+         * compare header().serialNumber first when that matters.
+         *
+         * @return ATCA_BAD_CRC for a damaged image, ATCA_INVALID_SIZE for one written with a different sector size
+         */
+        PropWare::ErrorCode restore (const PropWare::BlockStorage &storage, const uint32_t firstSector);
+
+        /**
+         * @brief Load and check the header of the image at `firstSector`, for header()
+         */
+        PropWare::ErrorCode load_header (const PropWare::BlockStorage &storage, const uint32_t firstSector);
+
+        /**
+         * @return Header of the last image saved or loaded
+         */
+        const ImageHeader &header () const {
+            return this->m_header;
+        }
+
+        /**
+         * @return Counters of the last save() or restore()
+         */
+        const Stats &stats () const {
+            return this->m_stats;
+        }
+
+    protected:
+        /**
+         * @brief One Read or Write command: a 32-byte block where the section has one left, 4-byte words after that
+         */
+        struct Chunk {
+            uint8_t block;
+            uint8_t offset;
+            uint8_t length;
+        };
+
+        /**
+         * @brief A command in flight and the staging block it uses
+         */
+        struct Pending {
+            CryptoDevice::Handle handle;
+            uint8_t              section;
+            uint8_t              length;
+        };
+
+    protected:
+        static uint16_t slot_size (const uint8_t slot) {
+            return slot < 8 ? 36 : (8 == slot ? 416 : 72);
+        }
+
+        /**
+         * @param[in] words     Always a 4-byte word, for the configuration zone's partly read-only blocks
+         */
+        static Chunk chunk_at (const uint16_t position, const uint16_t length, const bool words);
+
+        /**
+         * @brief Bytes 0-15 and 84-87 of the configuration zone are set by other commands or not at all
+         */
+        static bool config_word_writable (const uint16_t offset) {
+            return 16 <= offset && 84 != offset;
+        }
+
+        /**
+         * @brief Continue a CRC-16 over more data; starting from 0, gives the same result as atCRC()
+         */
+        static uint16_t update_crc (uint16_t crc, const uint8_t *data, const size_t length);
+
+        /**
+         * @brief Take the storage's sector size and reset the counters
+         */
+        PropWare::ErrorCode start (const PropWare::BlockStorage &storage);
+
+        void add_section (const uint8_t zone, const uint8_t slot, const uint16_t length);
+
+        /**
+         * @brief Add the sections that the configuration zone, now in m_config, allows to be read
+         */
+        void add_readable_sections ();
+
+        /**
+         * @brief Decide whether the device, as described by m_config, still accepts `section` in the clear
+         */
+        bool writable (const ImageSection &section) const;
+
+        PropWare::ErrorCode read_config ();
+
+        /**
+         * @brief Queue a read into, or a write from, the pending entry's staging block
+         */
+        PropWare::ErrorCode submit (Pending &pending, const uint8_t section, const Chunk &chunk, const bool write);
+
+        /**
+         * @brief Wait for the oldest command in flight
+         */
+        PropWare::ErrorCode complete ();
+
+        /**
+         * @brief Collect every command still in flight, so that none writes to our buffers after we return
+         */
+        void drain ();
+
+        /**
+         * @brief Append to the current sector, writing it out once it is full
+         */
+        PropWare::ErrorCode put (const PropWare::BlockStorage &storage, const uint8_t *data, size_t length);
+
+        /**
+         * @brief Take the next bytes of section data, reading sectors as they are needed
+         *
+         * @param[out] data     NULL to skip the bytes
+         */
+        PropWare::ErrorCode get (const PropWare::BlockStorage &storage, uint8_t *data, size_t length);
+
+        Pending &staging_entry (const uint32_t index) {
+            return this->m_pending[index % PIPELINE_DEPTH];
+        }
+
+        uint8_t *staging_block (const Pending &pending) {
+            return this->m_staging[&pending - this->m_pending];
+        }
+
+    protected:
+        CryptoDevice &m_device;
+        ImageHeader  m_header;
+        Stats        m_stats;
+        uint8_t      m_config[ATCA_ECC_CONFIG_SIZE];
+
+        uint8_t  m_sector[MAX_SECTOR_SIZE];
+        size_t   m_sectorSize;
+        /** Sector the buffer belongs to, and the next byte within it */
+        uint32_t m_sectorAddress;
+        size_t   m_sectorPosition;
+
+        Pending  m_pending[PIPELINE_DEPTH];
+        uint8_t  m_staging[PIPELINE_DEPTH][ATCA_BLOCK_SIZE];
+        /** Commands submitted and completed so far, indexing m_pending round-robin */
+        uint32_t m_submitted;
+        uint32_t m_completed;
+};
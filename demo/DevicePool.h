@@ -0,0 +1,208 @@
+/**
+ * @file    DevicePool.h
+ *
+ * @author  David Zemon
+ *
+ * @copyright
+ * The MIT License (MIT)<br>
+ * <br>Copyright (c) 2019 David Zemon<br>
+ * <br>Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:<br>
+ * <br>The above copyright notice and this permission notice shall be included in all copies or substantial portions
+ * of the Software.<br>
+ * <br>THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "CryptoDevice.h"
+
+/**
+ * @brief Spread commands across several secure elements, on one or both I2C buses
+ *
+ * Every member keeps its own library context and is served by its own worker cog (see CryptoWorker), so one chip's
+ * bus traffic overlaps the others' execution time and sign/verify throughput grows with the number of chips. Each
+ * command goes to the member with the fewest unfinished commands among those able to run it.
+ *
+ * Add every device before starting the workers: joining the pool switches a device to TRANSPORT_COG, which is what
+ * allows several cogs to share a bus.
+ *
+ * @code
+ * CryptoDevice left(0xC0, ATECC508A, CryptoDevice::DEFAULT_BAUD, 0);
+ * CryptoDevice right(0xC0, ATECC508A, CryptoDevice::DEFAULT_BAUD, 1);
+ * DevicePool   pool;
+ * pool.add(left, 1 << 0);
+ * pool.add(right, 1 << 0);
+ *
+ * uint32_t     leftStack[256], rightStack[256];
+ * CryptoWorker leftWorker(leftStack, left), rightWorker(rightStack, right);
+ * PropWare::Runnable::invoke(leftWorker);
+ * PropWare::Runnable::invoke(rightWorker);
+ *
+ * const auto ticket = pool.submit_sign(0, digest, signature);
+ * check_errors(pool.wait(ticket));
+ * @endcode
+ */
+class DevicePool {
+    public:
+        static const size_t   MAX_DEVICES = 4;
+        static const uint16_t NO_KEYS     = 0;
+        /** Key ids that keySlots has a bit for */
+        static const uint16_t SLOTS       = 16;
+
+        /**
+         * @brief A command submitted to one member of the pool
+         */
+        struct Ticket {
+            CryptoDevice         *device;
+            CryptoDevice::Handle handle;
+
+            /**
+             * @return False if no member could accept the command, or its arguments were invalid
+             */
+            bool valid () const {
+                return NULL != this->device;
+            }
+        };
+
+    public:
+        DevicePool ()
+                : m_size(0) {
+            LibraryLock::start();
+        }
+
+        /**
+         * @param[in] device
+         * @param[in] keySlots  Bit n set means slot n of this device holds a key that the application treats as
+         *                      interchangeable with slot n of every other member that sets bit n (for instance, one
+         *                      of several device keys registered with the same server). Only those members are
+         *                      candidates for signing with slot n.
+         *
+         * @return False if the pool is full
+         */
+        bool add (CryptoDevice &device, const uint16_t keySlots = NO_KEYS) {
+            if (MAX_DEVICES == this->m_size)
+                return false;
+            device.set_transport(TRANSPORT_COG);
+            this->m_members[this->m_size].device   = &device;
+            this->m_members[this->m_size].keySlots = keySlots;
+            ++this->m_size;
+            return true;
+        }
+
+        size_t size () const {
+            return this->m_size;
+        }
+
+        CryptoDevice &device (const size_t index) {
+            return *this->m_members[index].device;
+        }
+
+        /**
+         * @return Commands submitted to the member and not yet finished
+         */
+        size_t queue_depth (const size_t index) const {
+            return this->m_members[index].device->queue_depth();
+        }
+
+        /**
+         * @return An invalid ticket, which wait() reports as ATCA_BAD_PARAM, for a key id past the last slot
+         */
+        Ticket submit_sign (const uint16_t keyId, const uint8_t digest[ATCA_SHA_DIGEST_SIZE],
+                            uint8_t signature[ATCA_SIG_SIZE]) {
+            // Past the last slot, the required mask would be empty and every member would qualify
+            if (SLOTS <= keyId)
+                return invalid_ticket();
+            return this->dispatch(static_cast<uint16_t>(1 << keyId), [&] (CryptoDevice &device) {
+                return device.submit_sign(keyId, digest, signature);
+            });
+        }
+
+        Ticket submit_verify_extern (const uint8_t digest[ATCA_SHA_DIGEST_SIZE], const uint8_t signature[ATCA_SIG_SIZE],
+                                     const uint8_t publicKey[ATCA_PUB_KEY_SIZE], bool *verified) {
+            return this->dispatch(NO_KEYS, [&] (CryptoDevice &device) {
+                return device.submit_verify_extern(digest, signature, publicKey, verified);
+            });
+        }
+
+        Ticket submit_random (uint8_t random[RANDOM_NUM_SIZE]) {
+            return this->dispatch(NO_KEYS, [&] (CryptoDevice &device) {
+                return device.submit_random(random);
+            });
+        }
+
+        bool is_complete (const Ticket &ticket) const {
+            return ticket.valid() && ticket.device->is_complete(ticket.handle);
+        }
+
+        /**
+         * @return The command's status, or ATCA_BAD_PARAM if the ticket is invalid
+         */
+        PropWare::ErrorCode wait (const Ticket &ticket) {
+            if (!ticket.valid())
+                return ATCA_BAD_PARAM;
+            return ticket.device->wait(ticket.handle);
+        }
+
+    protected:
+        struct Member {
+            CryptoDevice *device;
+            uint16_t     keySlots;
+        };
+
+    protected:
+        /**
+         * @brief Offer the command to capable members from least to most busy until one accepts it
+         *
+         * A member may refuse even when it looks idle: finished commands occupy its queue until they are collected.
+         */
+        template<typename Submit>
+        Ticket dispatch (const uint16_t requiredSlots, Submit submit) {
+            bool tried[MAX_DEVICES] = {false};
+
+            for (size_t attempt = 0; attempt < this->m_size; ++attempt) {
+                size_t best      = MAX_DEVICES;
+                size_t bestDepth = 0;
+                for (size_t i = 0; i < this->m_size; ++i) {
+                    if (tried[i] || requiredSlots != (this->m_members[i].keySlots & requiredSlots))
+                        continue;
+                    const auto depth = this->queue_depth(i);
+                    if (MAX_DEVICES == best || depth < bestDepth) {
+                        best      = i;
+                        bestDepth = depth;
+                    }
+                }
+                if (MAX_DEVICES == best)
+                    break;
+
+                tried[best] = true;
+                CryptoDevice &device = *this->m_members[best].device;
+                const auto   handle  = submit(device);
+                if (CryptoDevice::INVALID_HANDLE != handle) {
+                    Ticket ticket;
+                    ticket.device = &device;
+                    ticket.handle = handle;
+                    return ticket;
+                }
+            }
+
+            return invalid_ticket();
+        }
+
+        static Ticket invalid_ticket () {
+            Ticket ticket;
+            ticket.device = NULL;
+            ticket.handle = CryptoDevice::INVALID_HANDLE;
+            return ticket;
+        }
+
+    protected:
+        Member m_members[MAX_DEVICES];
+        size_t m_size;
+};
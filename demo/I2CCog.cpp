@@ -0,0 +1,44 @@
+/**
+ * @file    I2CCog.cpp
+ *
+ * @author  David Zemon
+ *
+ * @copyright
+ * The MIT License (MIT)<br>
+ * <br>Copyright (c) 2019 David Zemon<br>
+ * <br>Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:<br>
+ * <br>The above copyright notice and this permission notice shall be included in all copies or substantial portions
+ * of the Software.<br>
+ * <br>THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "I2CCog.h"
+
+#include <propeller.h>
+
+/** Image of i2c_cog.cogc, placed in hub memory by the linker */
+extern "C" uint32_t _load_start_i2c_cog_cog[];
+
+bool I2CCog::start () {
+    if (NO_LOCK == this->m_lock)
+        this->m_lock = locknew();
+    if (!this->running() && NO_LOCK != this->m_lock)
+        this->m_cogId = cognew(_load_start_i2c_cog_cog, &this->m_mailbox);
+    return this->running();
+}
+
+I2CCogStatus I2CCog::execute (const I2CCogCommand command, const Bus &bus) {
+    this->m_mailbox.sclMask      = bus.sclMask;
+    this->m_mailbox.sdaMask      = bus.sdaMask;
+    this->m_mailbox.halfBitTicks = bus.halfBitTicks;
+    this->m_mailbox.command      = command;
+    while (I2C_COG_IDLE != this->m_mailbox.command);
+    return static_cast<I2CCogStatus>(this->m_mailbox.status);
+}
@@ -0,0 +1,155 @@
+/**
+ * @file    I2CCog.h
+ *
+ * @author  David Zemon
+ *
+ * @copyright
+ * The MIT License (MIT)<br>
+ * <br>Copyright (c) 2019 David Zemon<br>
+ * <br>Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:<br>
+ * <br>The above copyright notice and this permission notice shall be included in all copies or substantial portions
+ * of the Software.<br>
+ * <br>THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "i2c_cog.h"
+
+#include <PropWare/PropWare.h>
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Host side of the cog-resident I2C transport
+ *
+ * One cog serves every bus: the pins and bit timing travel with each command. Calls block until the cog has finished
+ * the whole packet, so the caller saves the interpreter overhead of driving the bus byte by byte, not the wire time.
+ *
+ * Any cog may call in, with or without the LibraryLock. There is a single mailbox, which each call holds under a hub
+ * lock of its own from filling it in until the result has been read back.
+ *
+ * @warning The Propeller ORs the pin outputs of all cogs together. A bus driven by the transport cog must not also
+ *          be driven through PropWare::I2CMaster (which leaves SCL as an output) from another cog.
+ */
+class I2CCog {
+    public:
+        /**
+         * @brief Pins and timing for one bus
+         */
+        struct Bus {
+            uint32_t sclMask;
+            uint32_t sdaMask;
+            uint32_t halfBitTicks;
+        };
+
+    public:
+        static I2CCog &instance () {
+            static I2CCog cog;
+            return cog;
+        }
+
+        /**
+         * @brief Launch the transport cog if it is not already running
+         *
+         * @return False if no cog or no hub lock was free
+         */
+        bool start ();
+
+        bool running () const {
+            return 0 <= this->m_cogId;
+        }
+
+        I2CCogStatus send (const Bus &bus, const uint8_t address, const uint8_t wordAddress, const uint8_t *data,
+                           const size_t length) {
+            const Claim claim(this->m_lock);
+            this->m_mailbox.buffer      = const_cast<uint8_t *>(data);
+            this->m_mailbox.length      = static_cast<uint32_t>(length);
+            this->m_mailbox.address     = address;
+            this->m_mailbox.wordAddress = wordAddress;
+            return this->execute(I2C_COG_SEND, bus);
+        }
+
+        /**
+         * @param[out]      buffer  Response packet, starting with its length byte
+         * @param[in,out]   length  Capacity of `buffer` on entry, bytes received on return
+         */
+        I2CCogStatus receive (const Bus &bus, const uint8_t address, uint8_t *buffer, uint16_t *length) {
+            const Claim claim(this->m_lock);
+            this->m_mailbox.buffer  = buffer;
+            this->m_mailbox.length  = *length;
+            this->m_mailbox.address = address;
+            const auto status = this->execute(I2C_COG_RECEIVE, bus);
+            *length = static_cast<uint16_t>(this->m_mailbox.length);
+            return status;
+        }
+
+        /**
+         * @param[in] pulseTicks    How long SDA is held low
+         * @param[in] delayTicks    Time to wait after the pulse before returning, or 0 to return at once
+         */
+        void wake (const Bus &bus, const uint32_t pulseTicks, const uint32_t delayTicks) {
+            const Claim claim(this->m_lock);
+            this->m_mailbox.intervalTicks = pulseTicks;
+            this->m_mailbox.timeoutTicks  = delayTicks;
+            this->execute(I2C_COG_WAKE, bus);
+        }
+
+        /**
+         * @return True if the device acknowledged its address before the timeout
+         */
+        bool poll (const Bus &bus, const uint8_t address, const uint32_t intervalTicks, const uint32_t timeoutTicks) {
+            const Claim claim(this->m_lock);
+            this->m_mailbox.address       = address;
+            this->m_mailbox.intervalTicks = intervalTicks;
+            this->m_mailbox.timeoutTicks  = timeoutTicks;
+            return I2C_COG_SUCCESS == this->execute(I2C_COG_POLL, bus);
+        }
+
+    private:
+        static const int NO_LOCK = -1;
+
+        /**
+         * @brief Hold the mailbox for the lifetime of the object
+         */
+        class Claim {
+            public:
+                explicit Claim (const int lock)
+                        : m_lock(lock) {
+                    while (lockset(lock));
+                }
+
+                ~Claim () {
+                    lockclr(this->m_lock);
+                }
+
+            private:
+                const int m_lock;
+        };
+
+    private:
+        I2CCog ()
+                : m_cogId(-1),
+                  m_lock(NO_LOCK) {
+            this->m_mailbox.command = I2C_COG_IDLE;
+        }
+
+        /**
+         * @brief Hand the filled-in mailbox to the cog and wait for the result
+         */
+        I2CCogStatus execute (const I2CCogCommand command, const Bus &bus);
+
+    private:
+        I2CCogMailbox m_mailbox;
+        int           m_cogId;
+        /** Guards m_mailbox */
+        int           m_lock;
+};
@@ -0,0 +1,139 @@
+/**
+ * @file    LinkSettingsStore.h
+ *
+ * @author  David Zemon
+ *
+ * @copyright
+ * The MIT License (MIT)<br>
+ * <br>Copyright (c) 2019 David Zemon<br>
+ * <br>Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:<br>
+ * <br>The above copyright notice and this permission notice shall be included in all copies or substantial portions
+ * of the Software.<br>
+ * <br>THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "CryptoDevice.h"
+#include "I2CCog.h"
+
+#include <PropWare/memory/eeprom.h>
+
+/**
+ * @brief Keeps CryptoDevice::LinkSettings in the boot EEPROM
+ *
+ * The Propeller loads only the first 32 kB of its EEPROM, so the upper half of a 64 kB part survives reprogramming.
+ * Give each device a location of its own. A 32 kB part ignores the top address bit, and a location in the upper half
+ * would land in the boot image: save() checks that the location has memory of its own before writing there.
+ *
+ * The EEPROM is driven through PropWare::I2CMaster from the calling cog. Once the transport cog runs (TRANSPORT_COG),
+ * it may drive the same pins, and the Propeller ORs the outputs of all cogs together, so load() and save() refuse to
+ * touch the bus from then on. Use the store before initializing any device with TRANSPORT_COG: initialize() then
+ * takes the lines over from this cog.
+ *
+ * @code
+ * LinkSettingsStore            store(LinkSettingsStore::DEFAULT_LOCATION);
+ * CryptoDevice::LinkSettings   settings;
+ * if (!store.load(&settings) || !cryptoDevice.apply_link_settings(settings)) {
+ *     check_errors(cryptoDevice.calibrate(&settings));
+ *     store.save(settings);
+ * }
+ * @endcode
+ */
+class LinkSettingsStore {
+    public:
+        /** Last 16 bytes of a 64 kB EEPROM, such as the QuickStart's. Unusable with a 32 kB part. */
+        static const uint16_t DEFAULT_LOCATION   = 0xFFF0;
+        /** What the Propeller loads at boot */
+        static const uint16_t BOOT_IMAGE_SIZE    = 0x8000;
+        /** Longest write cycle of a 24LC512 */
+        static const uint32_t WRITE_CYCLE_MILLIS = 5;
+
+    public:
+        /**
+         * @param[in]   location    16-byte aligned. Outside the boot image only on a part larger than 32 kB.
+         * @param[in]   bus
+         */
+        explicit LinkSettingsStore (const uint16_t location, const PropWare::I2CMaster &bus = pwI2c)
+                : m_eeprom(bus),
+                  m_location(location) {
+            static_assert(sizeof(CryptoDevice::LinkSettings) <= 16, "LinkSettings no longer fits one location");
+        }
+
+        /**
+         * @return False if nothing valid is stored there, or the transport cog is running
+         */
+        bool load (CryptoDevice::LinkSettings *settings) {
+            if (!this->bus_available())
+                return false;
+            uint8_t *const bytes = reinterpret_cast<uint8_t *>(settings);
+            for (size_t i = 0; i < sizeof(*settings); ++i)
+                bytes[i] = this->m_eeprom.get(static_cast<uint16_t>(this->m_location + i));
+            return settings->valid();
+        }
+
+        /**
+         * @return False if the EEPROM did not acknowledge the write or is too small for the location, or the transport
+         *         cog is running
+         */
+        bool save (const CryptoDevice::LinkSettings &settings) {
+            if (!this->bus_available() || !this->location_exists())
+                return false;
+            // One page write: locations are 16-byte aligned and pages are at least that large
+            if (!this->m_eeprom.put(this->m_location, reinterpret_cast<const uint8_t *>(&settings), sizeof(settings)))
+                return false;
+            this->wait_for_write();
+            return true;
+        }
+
+    private:
+        /**
+         * @return False once the transport cog may be driving the EEPROM's pins
+         */
+        bool bus_available () const {
+            return !I2CCog::instance().running();
+        }
+
+        void wait_for_write () {
+            const uint32_t timeout = CNT + MILLISECOND * WRITE_CYCLE_MILLIS;
+            while (!this->m_eeprom.ping() && static_cast<int32_t>(timeout - CNT) > 0);
+        }
+
+        /**
+         * @return True if the location is not an alias of one in the boot image, as it is on a 32 kB part
+         */
+        bool location_exists () {
+            if (BOOT_IMAGE_SIZE > this->m_location)
+                return true;
+            const auto alias = static_cast<uint16_t>(this->m_location - BOOT_IMAGE_SIZE);
+
+            // Different contents settle it without writing anything
+            for (uint16_t i = 0; i < sizeof(CryptoDevice::LinkSettings); ++i)
+                if (this->m_eeprom.get(static_cast<uint16_t>(this->m_location + i))
+                    != this->m_eeprom.get(static_cast<uint16_t>(alias + i)))
+                    return true;
+
+            // Same contents (blank, most likely): flip one byte, see whether its alias follows, and put it back
+            const uint8_t original = this->m_eeprom.get(this->m_location);
+            const auto    probe    = static_cast<uint8_t>(~original);
+            if (!this->m_eeprom.put(this->m_location, probe))
+                return false;
+            this->wait_for_write();
+            const bool aliased = probe == this->m_eeprom.get(alias);
+            this->m_eeprom.put(this->m_location, original);
+            this->wait_for_write();
+            return !aliased;
+        }
+
+    private:
+        PropWare::Eeprom m_eeprom;
+        const uint16_t   m_location;
+};
@@ -0,0 +1,139 @@
+/**
+ * @file    LogSink.h
+ *
+ * @author  David Zemon
+ *
+ * @copyright
+ * The MIT License (MIT)<br>
+ * <br>Copyright (c) 2019 David Zemon<br>
+ * <br>Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:<br>
+ * <br>The above copyright notice and this permission notice shall be included in all copies or substantial portions
+ * of the Software.<br>
+ * <br>THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <PropWare/PropWare.h>
+#include <PropWare/concurrent/runnable.h>
+#include <PropWare/gpio/pin.h>
+#include <PropWare/hmi/output/printer.h>
+#include <PropWare/serial/uart/uarttx.h>
+
+/**
+ * @brief Diagnostic output that never waits for the serial port
+ *
+ * Printing to pwOut bit-bangs every character from the calling cog, about 87 us per character at 115200 baud, so a
+ * line of hex in the middle of a session easily costs more than the commands around it. A Printer built on a LogSink
+ * copies characters into a ring buffer in hub RAM instead, and a cog of its own drains the ring to the serial pin.
+ * When the ring is full, characters are dropped and counted rather than waited for.
+ *
+ * The ring has one producer and one consumer and needs no lock: print from a single cog only (or give each printing
+ * cog a LogSink of its own, on different pins).
+ *
+ * @code
+ * uint32_t      logStack[128];
+ * LogSink<1024> logSink(logStack);
+ * Printer       logOut(logSink);
+ * logSink.start();
+ *
+ * check_errors(cryptoDevice.print_serial(logOut));
+ * logSink.flush();
+ * @endcode
+ *
+ * @tparam CAPACITY     Bytes of hub RAM for the ring. Must be a power of two.
+ */
+template<size_t CAPACITY>
+class LogSink : public PropWare::PrintCapable,
+                public PropWare::Runnable {
+    static_assert(0 == (CAPACITY & (CAPACITY - 1)), "LogSink capacity must be a power of two");
+
+    public:
+        template<size_t N>
+        LogSink (const uint32_t (&stack)[N], const PropWare::Pin::Mask txPin = PropWare::Pin::Mask::P30)
+                : Runnable(stack),
+                  m_txPin(txPin),
+                  m_head(0),
+                  m_tail(0),
+                  m_dropped(0) {
+        }
+
+        /**
+         * @brief Hand the serial pin to a new cog that drains the ring
+         *
+         * The Propeller ORs the outputs of all cogs together, and pwOut leaves the pin driven high from the calling
+         * cog, so the pin is released here first. Anything printed through pwOut afterwards is lost.
+         *
+         * @return False if no cog was free
+         */
+        bool start () {
+            PropWare::Pin(this->m_txPin).set_dir_in();
+            return 0 <= PropWare::Runnable::invoke(*this);
+        }
+
+        virtual void put_char (const char c) {
+            const uint32_t tail = this->m_tail;
+            if (CAPACITY == tail - this->m_head) {
+                ++this->m_dropped;
+                return;
+            }
+            this->m_buffer[tail % CAPACITY] = c;
+            this->m_tail = tail + 1;
+        }
+
+        virtual void puts (const char string[]) {
+            while (*string)
+                this->put_char(*string++);
+        }
+
+        /**
+         * @return Characters waiting to be sent
+         */
+        size_t pending () const {
+            return this->m_tail - this->m_head;
+        }
+
+        /**
+         * @return Characters lost to a full ring
+         */
+        uint32_t dropped () const {
+            return this->m_dropped;
+        }
+
+        /**
+         * @brief Block until everything printed so far is on the wire, such as before sleeping or exiting
+         */
+        void flush () const {
+            while (this->m_head != this->m_tail);
+        }
+
+        /**
+         * @brief Body of the draining cog
+         */
+        virtual void run () {
+            PropWare::UARTTX uart(this->m_txPin);
+            while (true) {
+                while (this->m_head == this->m_tail);
+                const uint32_t head = this->m_head;
+                uart.send(static_cast<uint8_t>(this->m_buffer[head % CAPACITY]));
+                this->m_head = head + 1;
+            }
+        }
+
+    protected:
+        const PropWare::Pin::Mask m_txPin;
+        char                      m_buffer[CAPACITY];
+        /** Advanced by the draining cog only */
+        volatile uint32_t         m_head;
+        /** Advanced by the printing cog only */
+        volatile uint32_t         m_tail;
+        uint32_t                  m_dropped;
+};
@@ -0,0 +1,331 @@
+/**
+ * @file    MerkleBatch.h
+ *
+ * @author  David Zemon
+ *
+ * @copyright
+ * The MIT License (MIT)<br>
+ * <br>Copyright (c) 2019 David Zemon<br>
+ * <br>Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:<br>
+ * <br>The above copyright notice and this permission notice shall be included in all copies or substantial portions
+ * of the Software.<br>
+ * <br>THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <atca_basic.h>
+#include <atca_crypto_sw_sha2.h>
+#include <PropWare/PropWare.h>
+
+#include <cstring>
+
+/**
+ * @brief Hashing rules shared by MerkleBatch and the verifiers of its proofs
+ *
+ * Leaves and interior nodes are hashed with different prefixes, so that no interior node can pass as a leaf. A level
+ * with an odd number of nodes promotes its last node unchanged rather than pairing it with itself. What gets signed is
+ * not the root alone but the root together with the number of leaves, which fixes the shape of the tree.
+ */
+class MerkleTree {
+    public:
+        static const size_t  DIGEST_SIZE = ATCA_SHA_DIGEST_SIZE;
+        static const uint8_t LEAF_PREFIX = 0x00;
+        static const uint8_t NODE_PREFIX = 0x01;
+        static const uint8_t ROOT_PREFIX = 0x02;
+
+    public:
+        static void hash_leaf (const uint8_t *message, const size_t length, uint8_t digest[DIGEST_SIZE]) {
+            const uint8_t      prefix = LEAF_PREFIX;
+            atcac_sha2_256_ctx context;
+            atcac_sw_sha2_256_init(&context);
+            atcac_sw_sha2_256_update(&context, &prefix, 1);
+            atcac_sw_sha2_256_update(&context, message, length);
+            atcac_sw_sha2_256_finish(&context, digest);
+        }
+
+        static void hash_node (const uint8_t left[DIGEST_SIZE], const uint8_t right[DIGEST_SIZE],
+                               uint8_t digest[DIGEST_SIZE]) {
+            const uint8_t      prefix = NODE_PREFIX;
+            atcac_sha2_256_ctx context;
+            atcac_sw_sha2_256_init(&context);
+            atcac_sw_sha2_256_update(&context, &prefix, 1);
+            atcac_sw_sha2_256_update(&context, left, DIGEST_SIZE);
+            atcac_sw_sha2_256_update(&context, right, DIGEST_SIZE);
+            atcac_sw_sha2_256_finish(&context, digest);
+        }
+
+        /**
+         * @brief The digest that is signed for a batch
+         */
+        static void signed_digest (const uint8_t root[DIGEST_SIZE], const uint16_t leaves,
+                                   uint8_t digest[DIGEST_SIZE]) {
+            const uint8_t      header[] = {ROOT_PREFIX, static_cast<uint8_t>(leaves), static_cast<uint8_t>(leaves >> 8)};
+            atcac_sha2_256_ctx context;
+            atcac_sw_sha2_256_init(&context);
+            atcac_sw_sha2_256_update(&context, header, sizeof(header));
+            atcac_sw_sha2_256_update(&context, root, DIGEST_SIZE);
+            atcac_sw_sha2_256_finish(&context, digest);
+        }
+
+        /**
+         * @return Levels above the leaves in a tree of `leaves` leaves, which is also the longest proof
+         */
+        static constexpr size_t depth (const size_t leaves) {
+            return leaves > 1 ? 1 + depth((leaves + 1) / 2) : 0;
+        }
+
+        /**
+         * @return Nodes in a tree of `leaves` leaves, leaves and root included. The level above n nodes has
+         *         ceil(n / 2) of them, so this is 2 * leaves - 1 only when `leaves` is a power of two.
+         */
+        static constexpr size_t node_count (const size_t leaves) {
+            return leaves > 1 ? leaves + node_count((leaves + 1) / 2) : leaves;
+        }
+};
+
+/**
+ * @brief Evidence that one message belongs to a signed batch
+ *
+ * Holds one sibling per level at most; a node that was promoted past a level has no sibling there. On the wire, the
+ * proof is the index, the leaf count and `count` digests: 4 + 32 * ceil(log2(leaves)) bytes.
+ */
+template<size_t DEPTH>
+struct MerkleProof {
+    uint16_t index;
+    uint16_t leaves;
+    uint8_t  count;
+    uint8_t  siblings[DEPTH ? DEPTH : 1][MerkleTree::DIGEST_SIZE];
+
+    /**
+     * @brief Recompute the root of the tree that `message` belongs to, according to this proof
+     *
+     * @return False if the proof is malformed
+     */
+    bool compute_root (const uint8_t *message, const size_t length, uint8_t root[MerkleTree::DIGEST_SIZE]) const {
+        if (!this->leaves || this->index >= this->leaves || this->count > DEPTH)
+            return false;
+
+        MerkleTree::hash_leaf(message, length, root);
+        size_t  width = this->leaves;
+        size_t  index = this->index;
+        uint8_t used  = 0;
+        while (width > 1) {
+            if ((index ^ 1) < width) {
+                if (used == this->count)
+                    return false;
+                const uint8_t *const sibling = this->siblings[used++];
+                if (index & 1)
+                    MerkleTree::hash_node(sibling, root, root);
+                else
+                    MerkleTree::hash_node(root, sibling, root);
+            }
+            index >>= 1;
+            width = (width + 1) / 2;
+        }
+        return used == this->count;
+    }
+
+    /**
+     * @brief Check that `message` was signed as part of a batch, with the device's ECDSA engine
+     *
+     * @param[out]  verified    True if the proof leads to a root that the signature covers
+     *
+     * @return 0 upon success (even if the message did not verify), error code otherwise
+     */
+    PropWare::ErrorCode verify (const uint8_t *message, const size_t length, const uint8_t signature[ATCA_SIG_SIZE],
+                                const uint8_t publicKey[ATCA_PUB_KEY_SIZE], bool *verified) const {
+        uint8_t root[MerkleTree::DIGEST_SIZE];
+        if (!this->compute_root(message, length, root)) {
+            *verified = false;
+            return 0;
+        }
+        uint8_t digest[MerkleTree::DIGEST_SIZE];
+        MerkleTree::signed_digest(root, this->leaves, digest);
+        return atcab_verify_extern(digest, signature, publicKey, verified);
+    }
+};
+
+/**
+ * @brief Collect messages and have them signed with a single ECDSA signature over a Merkle tree of their hashes
+ *
+ * A device signature takes around 50 ms, so signing each message on its own limits a chip to about 20 messages per
+ * second. A batch spends one signature on up to MAX_LEAVES messages and gives each message a proof of inclusion
+ * instead. Messages are hashed in software when they are added, so that work happens in the caller's cog, and only
+ * their hashes are kept.
+ *
+ * Seal the batch when it is full or its oldest message has waited long enough (see due()), sign it with
+ * CryptoDevice::sign_batch() or CryptoDevice::submit_sign_batch(), hand out the signature and proofs, then reset() it.
+ *
+ * @code
+ * MerkleBatch<32> batch(20);
+ * const auto      index = batch.add(message, length);
+ * ...
+ * if (batch.due()) {
+ *     check_errors(cryptoDevice.sign_batch(0, batch));
+ *     MerkleBatch<32>::Proof proof;
+ *     for (uint16_t i = 0; i < batch.size(); ++i) {
+ *         batch.proof(i, &proof);
+ *         send(i, batch.signature(), proof);
+ *     }
+ *     batch.reset();
+ * }
+ * @endcode
+ */
+template<size_t MAX_LEAVES>
+class MerkleBatch {
+    public:
+        static const size_t   DEPTH             = MerkleTree::depth(MAX_LEAVES);
+        static const uint32_t DEFAULT_WINDOW_MS = 50;
+        /** Returned by add() when the batch cannot take another message */
+        static const uint16_t NO_INDEX          = 0xFFFF;
+
+        typedef MerkleProof<DEPTH> Proof;
+
+    public:
+        /**
+         * @param[in] windowMs  Longest time the first message of a batch waits for others before due() says to sign
+         */
+        explicit MerkleBatch (const uint32_t windowMs = DEFAULT_WINDOW_MS)
+                : m_windowMs(windowMs) {
+            static_assert(0 < MAX_LEAVES && MAX_LEAVES < NO_INDEX, "MerkleBatch size must be between 1 and 65534");
+            this->reset();
+        }
+
+        /**
+         * @brief Start over with an empty batch
+         */
+        void reset () {
+            this->m_leaves  = 0;
+            this->m_sealed  = false;
+            this->m_firstAt = 0;
+        }
+
+        /**
+         * @return The message's index in the batch, or NO_INDEX if the batch is full or already sealed
+         */
+        uint16_t add (const uint8_t *message, const size_t length) {
+            if (this->m_sealed || MAX_LEAVES == this->m_leaves)
+                return NO_INDEX;
+            if (!this->m_leaves)
+                this->m_firstAt = CNT;
+            MerkleTree::hash_leaf(message, length, this->m_nodes[this->m_leaves]);
+            return static_cast<uint16_t>(this->m_leaves++);
+        }
+
+        uint16_t size () const {
+            return static_cast<uint16_t>(this->m_leaves);
+        }
+
+        bool full () const {
+            return MAX_LEAVES == this->m_leaves;
+        }
+
+        /**
+         * @return True if the batch should be signed now: it is full, or its first message has waited for the window
+         */
+        bool due () const {
+            return !this->m_sealed && this->m_leaves
+                   && (this->full() || CNT - this->m_firstAt >= MILLISECOND * this->m_windowMs);
+        }
+
+        /**
+         * @brief Build the tree and work out the digest to sign. No more messages can be added until reset().
+         *
+         * @return False if the batch is empty
+         */
+        bool seal () {
+            if (!this->m_leaves)
+                return false;
+            if (this->m_sealed)
+                return true;
+
+            size_t offset = 0;
+            size_t width  = this->m_leaves;
+            while (width > 1) {
+                const size_t next = offset + width;
+                for (size_t i = 0; i + 1 < width; i += 2)
+                    MerkleTree::hash_node(this->m_nodes[offset + i], this->m_nodes[offset + i + 1],
+                                          this->m_nodes[next + i / 2]);
+                if (width & 1)
+                    memcpy(this->m_nodes[next + width / 2], this->m_nodes[offset + width - 1],
+                           MerkleTree::DIGEST_SIZE);
+                offset = next;
+                width  = (width + 1) / 2;
+            }
+            MerkleTree::signed_digest(this->m_nodes[offset], this->size(), this->m_digest);
+            this->m_sealed = true;
+            return true;
+        }
+
+        bool sealed () const {
+            return this->m_sealed;
+        }
+
+        /**
+         * @return What the batch's signature covers. Valid once sealed.
+         */
+        const uint8_t *digest () const {
+            return this->m_digest;
+        }
+
+        /**
+         * @return Where the batch's signature goes, and is read from once signed
+         */
+        uint8_t *signature () {
+            return this->m_signature;
+        }
+
+        const uint8_t *signature () const {
+            return this->m_signature;
+        }
+
+        /**
+         * @return False if the batch is not sealed or has no message at `index`
+         */
+        bool proof (const uint16_t index, Proof *proof) const {
+            if (!this->m_sealed || index >= this->m_leaves)
+                return false;
+
+            proof->index  = index;
+            proof->leaves = this->size();
+            proof->count  = 0;
+            size_t offset = 0;
+            size_t width  = this->m_leaves;
+            size_t node   = index;
+            while (width > 1) {
+                if ((node ^ 1) < width)
+                    memcpy(proof->siblings[proof->count++], this->m_nodes[offset + (node ^ 1)],
+                           MerkleTree::DIGEST_SIZE);
+                offset += width;
+                width = (width + 1) / 2;
+                node >>= 1;
+            }
+            return true;
+        }
+
+    protected:
+        /**
+         * Every level of a tree of MAX_LEAVES leaves. node_count() never shrinks as leaves are added, so every smaller
+         * tree fits as well.
+         */
+        static const size_t NODES = MerkleTree::node_count(MAX_LEAVES);
+
+    protected:
+        const uint32_t m_windowMs;
+        /** Leaves first, then each level above them, up to the root */
+        uint8_t        m_nodes[NODES][MerkleTree::DIGEST_SIZE];
+        size_t         m_leaves;
+        bool           m_sealed;
+        uint32_t       m_firstAt;
+        uint8_t        m_digest[MerkleTree::DIGEST_SIZE];
+        uint8_t        m_signature[ATCA_SIG_SIZE];
+};
@@ -0,0 +1,469 @@
+/**
+ * @file    Provisioner.h
+ *
+ * @author  David Zemon
+ *
+ * @copyright
+ * The MIT License (MIT)<br>
+ * <br>Copyright (c) 2019 David Zemon<br>
+ * <br>Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:<br>
+ * <br>The above copyright notice and this permission notice shall be included in all copies or substantial portions
+ * of the Software.<br>
+ * <br>THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "atca_hal_prop.h"
+#include "ConfigZone.h"
+#ifndef PROPCRYPTO_SIMULATOR
+#include "common.h"
+#endif
+
+#include <atca_basic.h>
+#include <PropWare/PropWare.h>
+
+#include <cstring>
+
+/**
+ * @brief What every unit leaves the line with
+ */
+struct ProvisioningProfile {
+    /**
+     * Complete configuration zone, such as ConfigImage<...>::DATA. Bytes that Write cannot change (serial number,
+     * revision, UserExtra, Selector and the lock bytes) are ignored, and so is the I2C address: each unit keeps its
+     * own.
+     */
+    const uint8_t *config;
+    bool          lockConfig;
+    /** One bit per slot to generate a private key in. Requires the configuration zone to be locked. */
+    uint16_t      keySlots;
+    /** Lock the data and OTP zones once the keys exist (without a CRC, since the keys are unknown beforehand) */
+    bool          lockData;
+};
+
+typedef enum {
+    /** Read the configuration zone, which tells how far an earlier run got */
+    PROVISION_READ_CONFIG,
+    /** One Write per changed word or block */
+    PROVISION_WRITE_CONFIG,
+    PROVISION_LOCK_CONFIG,
+    /** One key per step. Slots of an already locked data zone report their existing public keys instead. */
+    PROVISION_GENERATE_KEYS,
+    PROVISION_LOCK_DATA,
+    PROVISION_DONE
+} ProvisioningStep;
+
+/**
+ * @brief Outcome for one unit
+ */
+struct ProvisioningResult {
+    static const size_t MAX_KEYS = 4;
+
+    uint8_t             bus;
+    uint8_t             address;
+    uint8_t             serialNumber[ATCA_SERIAL_NUM_SIZE];
+    /** PROVISION_DONE, or the step that failed */
+    ProvisioningStep    step;
+    /** 0 when done, otherwise the error that stopped the unit */
+    PropWare::ErrorCode status;
+    bool                failed;
+    /** Failed steps that were retried */
+    uint8_t             retries;
+    uint16_t            configBytesWritten;
+    /** Public keys, in order of the bits set in ProvisioningProfile::keySlots (the first MAX_KEYS of them) */
+    uint8_t             publicKeys[MAX_KEYS][ATCA_PUB_KEY_SIZE];
+    uint8_t             keyCount;
+    /** From the unit's first step to its last. Wraps after 53 s at 80 MHz. */
+    uint32_t            micros;
+
+    bool done () const {
+        return PROVISION_DONE == this->step;
+    }
+};
+
+// The simulator has no Printer; the benchmark reports results itself
+#ifndef PROPCRYPTO_SIMULATOR
+inline const char *provisioning_step_name (const ProvisioningStep step) {
+    switch (step) {
+        case PROVISION_READ_CONFIG:
+            return "read_config";
+        case PROVISION_WRITE_CONFIG:
+            return "write_config";
+        case PROVISION_LOCK_CONFIG:
+            return "lock_config";
+        case PROVISION_GENERATE_KEYS:
+            return "generate_keys";
+        case PROVISION_LOCK_DATA:
+            return "lock_data";
+        case PROVISION_DONE:
+            return "done";
+        default:
+            return "unknown";
+    }
+}
+
+inline Printer &operator<< (Printer &printer, const ProvisioningResult &result) {
+    printer << "ProvisioningResult bus=" << result.bus
+            << " address=0x" << HEX_FMT << result.address
+            << " serial=";
+    for (const auto byte : result.serialNumber)
+        printer << HEX_FMT << byte;
+    printer << Printer::DEFAULT_FORMAT
+            << " step=" << provisioning_step_name(result.step)
+            << " status=0x" << HEX_FMT << result.status << Printer::DEFAULT_FORMAT
+            << " retries=" << result.retries
+            << " config_bytes=" << result.configBytesWritten
+            << " us=" << result.micros << '\n';
+    for (uint8_t key = 0; key < result.keyCount; ++key) {
+        printer << "  public_key[" << key << "]\n";
+        print_block(printer, result.publicKeys[key], ATCA_PUB_KEY_SIZE);
+        printer << '\n';
+    }
+    return printer;
+}
+#endif
+
+/**
+ * @brief Bring a batch of blank devices, on either bus, to a target configuration
+ *
+ * Every unit runs the same state machine: read the configuration zone, write what differs from the profile, lock the
+ * configuration zone, generate keys and lock the data zone. Steps are short (one command each, except for the
+ * initial read), and the steps of different units are pipelined: while one unit executes a write, lock or key
+ * generation, its wait is used to advance another unit (see WaitTask), so the long commands of all units overlap.
+ *
+ * The configuration is verified without reading it back: the lock carries the CRC of the zone as it is expected to
+ * be, and the device refuses to lock if its contents differ.
+ *
+ * A failed step sends the unit back to reading the configuration zone, which works out what actually landed, up to
+ * the retry limit. Calling provision() again resumes the units that failed. Run from a single cog: the pipelining
+ * needs no others, and would keep them from the LibraryLock.
+ *
+ * @code
+ * ATCAIfaceCfg cfg[4];
+ * int          found;
+ * hal_prop_discover_devices(0x3, base, cfg, 4, &found);
+ *
+ * const ProvisioningProfile profile = {ConfigImage<LineConfig>::DATA, true, 0x0003, true};
+ * Provisioner<4>            provisioner(profile);
+ * for (int i = 0; i < found; ++i)
+ *     provisioner.add(cfg[i]);
+ * provisioner.provision();
+ * for (size_t i = 0; i < provisioner.size(); ++i)
+ *     pwOut << provisioner.result(i) << '\n';
+ * @endcode
+ *
+ * @tparam MAX_UNITS    Devices provisioned at once
+ */
+template<size_t MAX_UNITS>
+class Provisioner : public WaitTask {
+    public:
+        static const uint8_t      DEFAULT_MAX_RETRIES = 3;
+        /**
+         * Units started from within another unit's wait, one inside the other. Each level keeps the unit below it
+         * from collecting its response, which must happen within the watchdog period.
+         */
+        static const unsigned int DEFAULT_MAX_NESTING = 3;
+
+    public:
+        explicit Provisioner (const ProvisioningProfile &profile)
+                : m_profile(profile),
+                  m_size(0),
+                  m_next(0),
+                  m_depth(0),
+                  m_maxNesting(DEFAULT_MAX_NESTING),
+                  m_maxRetries(DEFAULT_MAX_RETRIES) {
+        }
+
+        ~Provisioner () {
+            for (size_t i = 0; i < this->m_size; ++i)
+                deleteATCADevice(&this->m_units[i].device);
+        }
+
+        /**
+         * @brief Add a device to the batch
+         *
+         * The unit gets its own copy of `cfg` and of the PropHalConfig it points to, if any, so that each device's
+         * HAL state is its own.
+         *
+         * @return False if the batch is full or the library could not allocate the device
+         */
+        bool add (const ATCAIfaceCfg &cfg) {
+            if (MAX_UNITS == this->m_size)
+                return false;
+
+            Unit &unit = this->m_units[this->m_size];
+            unit.cfg = cfg;
+            if (cfg.cfg_data) {
+                unit.halConfig    = *static_cast<const PropHalConfig *>(cfg.cfg_data);
+                unit.cfg.cfg_data = &unit.halConfig;
+            }
+            unit.device = newATCADevice(&unit.cfg);
+            if (!unit.device)
+                return false;
+            unit.writeCount = 0;
+            unit.nextWrite  = 0;
+            unit.nextSlot   = 0;
+            unit.dataLocked = false;
+            unit.busy       = false;
+            unit.started    = false;
+
+            ProvisioningResult &result = this->m_results[this->m_size];
+            memset(&result, 0, sizeof(result));
+            result.bus     = cfg.atcai2c.bus;
+            result.address = cfg.atcai2c.slave_address;
+            result.step    = PROVISION_READ_CONFIG;
+            ++this->m_size;
+            return true;
+        }
+
+        size_t size () const {
+            return this->m_size;
+        }
+
+        const ProvisioningResult &result (const size_t index) const {
+            return this->m_results[index];
+        }
+
+        /**
+         * @param[in] maxNesting    0 provisions one unit after another
+         */
+        void set_max_nesting (const unsigned int maxNesting) {
+            this->m_maxNesting = maxNesting;
+        }
+
+        void set_max_retries (const uint8_t maxRetries) {
+            this->m_maxRetries = maxRetries;
+        }
+
+        /**
+         * @brief Run every unit until it is done or has used up its retries
+         *
+         * Units that failed in an earlier call start over from reading their configuration zone, with their retries
+         * reset; finished units are left alone. The library's current device is the same afterwards as before.
+         *
+         * @return Number of units done
+         */
+        size_t provision () {
+            for (size_t i = 0; i < this->m_size; ++i) {
+                ProvisioningResult &result = this->m_results[i];
+                if (result.failed || !this->m_units[i].started) {
+                    result.failed              = false;
+                    result.retries             = 0;
+                    result.step                = PROVISION_READ_CONFIG;
+                    this->m_units[i].started   = false;
+                    this->m_units[i].nextSlot  = 0;
+                    result.keyCount            = 0;
+                    result.configBytesWritten  = 0;
+                }
+            }
+
+            const ATCADevice callersDevice = atcab_get_device();
+            hal_prop_set_wait_task(this);
+            size_t index;
+            while (this->next_unit(&index))
+                this->step(index);
+            hal_prop_set_wait_task(NULL);
+            // Not atcab_init_device(), which would delete the last unit's device here and leave it to the destructor
+            // to delete again. Restored even when NULL, so that no unit outlives the batch as the current device.
+            hal_prop_select_device(callersDevice);
+
+            size_t done = 0;
+            for (size_t i = 0; i < this->m_size; ++i)
+                if (this->m_results[i].done())
+                    ++done;
+            return done;
+        }
+
+        /**
+         * @brief Advance one other unit by one step while the current one's command executes
+         *
+         * Reads finish too quickly to be worth it: a unit started during one would hold up the unit that is waiting.
+         */
+        virtual void run (const uint32_t delay) {
+            size_t index;
+            if (MIN_OVERLAP_MS <= delay && this->m_depth <= this->m_maxNesting && this->next_unit(&index))
+                this->step(index);
+        }
+
+    protected:
+        /** Worst-case execution time of Write, below that of Lock and GenKey */
+        static const uint32_t MIN_OVERLAP_MS     = 20;
+        static const size_t   I2C_ADDRESS        = 16;
+        static const size_t   LOCK_VALUE         = 86;
+        static const size_t   LOCK_CONFIG        = 87;
+        static const uint8_t  LOCK_BYTE_UNLOCKED = 0x55;
+        static const uint8_t  SLOTS              = 16;
+
+        struct Unit {
+            ATCAIfaceCfg      cfg;
+            PropHalConfig     halConfig;
+            ATCADevice        device;
+            ConfigZone        zone;
+            ConfigZone::Write writes[ConfigZone::MAX_WRITES];
+            size_t            writeCount;
+            size_t            nextWrite;
+            uint8_t           nextSlot;
+            bool              dataLocked;
+            bool              busy;
+            bool              started;
+            uint32_t          startedAt;
+        };
+
+    protected:
+        /**
+         * @brief Round-robin choice among the units that are neither finished nor in the middle of a step
+         */
+        bool next_unit (size_t *index) {
+            for (size_t i = 0; i < this->m_size; ++i) {
+                const size_t candidate = (this->m_next + i) % this->m_size;
+                const auto   &result   = this->m_results[candidate];
+                if (!this->m_units[candidate].busy && !result.done() && !result.failed) {
+                    this->m_next = (candidate + 1) % this->m_size;
+                    *index = candidate;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void step (const size_t index) {
+            Unit               &unit   = this->m_units[index];
+            ProvisioningResult &result = this->m_results[index];
+
+            unit.busy = true;
+            ++this->m_depth;
+            if (!unit.started) {
+                unit.started   = true;
+                unit.startedAt = CNT;
+            }
+
+            const PropWare::ErrorCode err = this->advance(unit, result);
+            if (err) {
+                result.status = err;
+                if (result.retries < this->m_maxRetries && ATCA_CONFIG_ZONE_LOCKED != err) {
+                    // Whatever part of the step landed, the configuration zone tells where to pick up
+                    ++result.retries;
+                    result.step = PROVISION_READ_CONFIG;
+                } else {
+                    result.failed = true;
+                }
+            } else if (result.done()) {
+                result.status = 0;
+            }
+            if (result.done() || result.failed)
+                result.micros = (CNT - unit.startedAt) / MICROSECOND;
+
+            --this->m_depth;
+            unit.busy = false;
+        }
+
+        PropWare::ErrorCode advance (Unit &unit, ProvisioningResult &result) {
+            PropWare::ErrorCode err;
+            LibraryLock::Scope  lock(unit.device);
+
+            switch (result.step) {
+                case PROVISION_READ_CONFIG: {
+                    check_errors(unit.zone.read());
+                    const uint8_t *const image = unit.zone.image();
+                    memcpy(result.serialNumber, image, 4);
+                    memcpy(&result.serialNumber[4], &image[8], ATCA_SERIAL_NUM_SIZE - 4);
+                    unit.dataLocked = LOCK_BYTE_UNLOCKED != image[LOCK_VALUE];
+
+                    // Units sharing a bus keep the addresses that tell them apart
+                    const uint8_t address = image[I2C_ADDRESS];
+                    unit.zone.set_bytes(0, this->m_profile.config, ConfigZone::SIZE);
+                    unit.zone.set_bytes(I2C_ADDRESS, &address, 1);
+                    unit.writeCount = unit.zone.plan(unit.writes);
+                    unit.nextWrite  = 0;
+                    if (LOCK_BYTE_UNLOCKED != image[LOCK_CONFIG]) {
+                        // Locked by an earlier run, or by somebody else
+                        if (unit.writeCount)
+                            return ATCA_CONFIG_ZONE_LOCKED;
+                        result.step = PROVISION_GENERATE_KEYS;
+                    } else {
+                        result.step = unit.writeCount ? PROVISION_WRITE_CONFIG : this->after_config_writes();
+                    }
+                    return 0;
+                }
+                case PROVISION_WRITE_CONFIG: {
+                    const ConfigZone::Write &write = unit.writes[unit.nextWrite];
+                    check_errors(atcab_write_zone(ATCA_ZONE_CONFIG, 0, write.offset / ATCA_BLOCK_SIZE,
+                                                  (write.offset % ATCA_BLOCK_SIZE) / ATCA_WORD_SIZE,
+                                                  &unit.zone.image()[write.offset], write.length));
+                    result.configBytesWritten += write.length;
+                    if (++unit.nextWrite == unit.writeCount)
+                        result.step = this->after_config_writes();
+                    return 0;
+                }
+                case PROVISION_LOCK_CONFIG:
+                    // Doubles as verification: the device only locks if its zone matches the CRC of the profile
+                    check_errors(unit.zone.lock());
+                    result.step = PROVISION_GENERATE_KEYS;
+                    return 0;
+                case PROVISION_GENERATE_KEYS: {
+                    while (unit.nextSlot < SLOTS && !(this->m_profile.keySlots & (1 << unit.nextSlot)))
+                        ++unit.nextSlot;
+                    if (SLOTS == unit.nextSlot) {
+                        result.step = (this->m_profile.lockData && !unit.dataLocked) ? PROVISION_LOCK_DATA
+                                                                                      : PROVISION_DONE;
+                        return 0;
+                    }
+
+                    // Keys in a locked data zone may be registered already: report them rather than replace them
+                    uint8_t publicKey[ATCA_PUB_KEY_SIZE];
+                    check_errors(unit.dataLocked ? atcab_get_pubkey(unit.nextSlot, publicKey)
+                                                 : atcab_genkey(unit.nextSlot, publicKey));
+                    const uint8_t key = this->key_index(unit.nextSlot);
+                    if (key < ProvisioningResult::MAX_KEYS) {
+                        memcpy(result.publicKeys[key], publicKey, ATCA_PUB_KEY_SIZE);
+                        if (key >= result.keyCount)
+                            result.keyCount = static_cast<uint8_t>(key + 1);
+                    }
+                    ++unit.nextSlot;
+                    return 0;
+                }
+                case PROVISION_LOCK_DATA:
+                    check_errors(atcab_lock_data_zone());
+                    result.step = PROVISION_DONE;
+                    return 0;
+                default:
+                    return 0;
+            }
+        }
+
+        ProvisioningStep after_config_writes () const {
+            return this->m_profile.lockConfig ? PROVISION_LOCK_CONFIG : PROVISION_GENERATE_KEYS;
+        }
+
+        /**
+         * @return Position of `slot` among the slots set in the profile's keySlots
+         */
+        uint8_t key_index (const uint8_t slot) const {
+            uint8_t index = 0;
+            for (uint8_t i = 0; i < slot; ++i)
+                if (this->m_profile.keySlots & (1 << i))
+                    ++index;
+            return index;
+        }
+
+    protected:
+        const ProvisioningProfile m_profile;
+        Unit                      m_units[MAX_UNITS];
+        ProvisioningResult        m_results[MAX_UNITS];
+        size_t                    m_size;
+        /** Where the round-robin search for the next unit starts */
+        size_t                    m_next;
+        /** Steps in progress, one inside the other */
+        unsigned int              m_depth;
+        unsigned int              m_maxNesting;
+        uint8_t                   m_maxRetries;
+};
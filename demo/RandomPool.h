@@ -0,0 +1,196 @@
+/**
+ * @file    RandomPool.h
+ *
+ * @author  David Zemon
+ *
+ * @copyright
+ * The MIT License (MIT)<br>
+ * <br>Copyright (c) 2019 David Zemon<br>
+ * <br>Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:<br>
+ * <br>The above copyright notice and this permission notice shall be included in all copies or substantial portions
+ * of the Software.<br>
+ * <br>THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "CryptoDevice.h"
+
+#include <cstring>
+
+/**
+ * @brief Hardware random numbers, drawn from the chip ahead of time and handed out from a ring buffer in hub RAM
+ *
+ * Every Random command costs a wake, about 23 ms of execution and a 35-byte read. The pool moves that cost into the
+ * worker cog's idle time: once fewer than the low-water mark of bytes are left, the worker refills 32-byte blocks
+ * between commands until the high-water mark is reached. take() never touches the bus.
+ *
+ * One cog takes bytes while the worker cog refills; no lock is needed between the two.
+ *
+ * @code
+ * RandomPool<256> randomPool(cryptoDevice);
+ * uint32_t        workerStack[256];
+ * CryptoWorker    worker(workerStack, cryptoDevice);
+ * PropWare::Runnable::invoke(worker);
+ *
+ * uint8_t nonce[16];
+ * check_errors(randomPool.get(nonce, sizeof(nonce)));
+ * @endcode
+ *
+ * @tparam CAPACITY     Bytes of hub RAM for the ring. Must be a power of two and a multiple of RANDOM_NUM_SIZE.
+ */
+template<size_t CAPACITY>
+class RandomPool : public CryptoDevice::IdleTask {
+    static_assert(0 == (CAPACITY & (CAPACITY - 1)), "RandomPool capacity must be a power of two");
+    static_assert(0 == CAPACITY % RANDOM_NUM_SIZE, "RandomPool capacity must be a multiple of RANDOM_NUM_SIZE");
+
+    public:
+        /**
+         * @brief Counters for tuning the water marks
+         */
+        struct Stats {
+            /** take() calls served from the ring */
+            uint32_t hits;
+            /** take() calls that found too few bytes */
+            uint32_t misses;
+            /** Blocks drawn from the chip */
+            uint32_t refills;
+            /** Random commands that failed */
+            uint32_t refillErrors;
+        };
+
+    public:
+        /**
+         * @brief Register with the device as its idle task. Do this before starting the device's worker.
+         *
+         * The pool starts empty and fills to the high-water mark as soon as the worker is running.
+         */
+        explicit RandomPool (CryptoDevice &device)
+                : m_device(device),
+                  m_head(0),
+                  m_tail(0),
+                  m_refilling(false),
+                  m_suspended(false) {
+            this->set_water_marks(CAPACITY / 4, CAPACITY);
+            memset(&this->m_stats, 0, sizeof(this->m_stats));
+            device.set_idle_task(this);
+        }
+
+        /**
+         * @param[in] lowWater  Start refilling when fewer bytes than this remain
+         * @param[in] highWater Stop refilling once this many bytes are available. Capped at CAPACITY.
+         */
+        void set_water_marks (const size_t lowWater, const size_t highWater) {
+            this->m_highWater = highWater < CAPACITY ? highWater : CAPACITY;
+            this->m_lowWater  = lowWater < this->m_highWater ? lowWater : this->m_highWater;
+        }
+
+        /**
+         * @return Bytes ready to be taken
+         */
+        size_t available () const {
+            return this->m_tail - this->m_head;
+        }
+
+        /**
+         * @brief Copy `length` random bytes out of the ring, if that many are available. Never blocks.
+         *
+         * @return False, without consuming anything, on a miss
+         */
+        bool take (uint8_t *data, const size_t length) {
+            this->m_suspended = false;
+            if (this->available() < length) {
+                ++this->m_stats.misses;
+                return false;
+            }
+
+            const size_t start = this->m_head % CAPACITY;
+            const size_t first = CAPACITY - start < length ? CAPACITY - start : length;
+            memcpy(data, &this->m_buffer[start], first);
+            memcpy(&data[first], this->m_buffer, length - first);
+            // Random bytes must never be handed out twice
+            memset(&this->m_buffer[start], 0, first);
+            memset(this->m_buffer, 0, length - first);
+            this->m_head += length;
+            ++this->m_stats.hits;
+            return true;
+        }
+
+        /**
+         * @brief Like take(), but on a miss submit Random commands to the worker and wait for them
+         */
+        PropWare::ErrorCode get (uint8_t *data, size_t length) {
+            if (this->take(data, length))
+                return 0;
+
+            PropWare::ErrorCode err;
+            uint8_t             block[RANDOM_NUM_SIZE];
+            while (length) {
+                const auto handle = this->m_device.submit_random(block);
+                if (CryptoDevice::INVALID_HANDLE == handle)
+                    return ATCA_FUNC_FAIL;
+                check_errors(this->m_device.wait(handle));
+
+                const size_t chunk = length < RANDOM_NUM_SIZE ? length : RANDOM_NUM_SIZE;
+                memcpy(data, block, chunk);
+                data += chunk;
+                length -= chunk;
+            }
+            return 0;
+        }
+
+        const Stats &stats () const {
+            return this->m_stats;
+        }
+
+        virtual bool pending () {
+            if (this->m_suspended)
+                return false;
+
+            const size_t available = this->available();
+            if (available < this->m_lowWater)
+                this->m_refilling = true;
+            if (available >= this->m_highWater || CAPACITY - available < RANDOM_NUM_SIZE)
+                this->m_refilling = false;
+            return this->m_refilling;
+        }
+
+        /**
+         * @brief Draw one block from the chip straight into the ring
+         *
+         * The tail only ever moves in whole blocks, so the block never wraps around the end of the buffer.
+         */
+        virtual PropWare::ErrorCode run () {
+            const auto err = atcab_random(&this->m_buffer[this->m_tail % CAPACITY]);
+            if (err) {
+                // Don't let a failing chip keep the worker busy: wait for the consumer to come back first
+                this->m_suspended = true;
+                ++this->m_stats.refillErrors;
+            } else {
+                this->m_tail += RANDOM_NUM_SIZE;
+                ++this->m_stats.refills;
+            }
+            return err;
+        }
+
+    protected:
+        CryptoDevice      &m_device;
+        uint8_t           m_buffer[CAPACITY];
+        /** Advanced by the consuming cog only */
+        volatile uint32_t m_head;
+        /** Advanced by the worker cog only */
+        volatile uint32_t m_tail;
+        size_t            m_lowWater;
+        size_t            m_highWater;
+        bool              m_refilling;
+        /** Set by the worker cog after a failed refill, cleared by the consuming cog */
+        volatile bool     m_suspended;
+        Stats             m_stats;
+};
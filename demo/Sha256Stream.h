@@ -0,0 +1,354 @@
+/**
+ * @file    Sha256Stream.h
+ *
+ * @author  David Zemon
+ *
+ * @copyright
+ * The MIT License (MIT)<br>
+ * <br>Copyright (c) 2019 David Zemon<br>
+ * <br>Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:<br>
+ * <br>The above copyright notice and this permission notice shall be included in all copies or substantial portions
+ * of the Software.<br>
+ * <br>THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "atca_hal_prop.h"
+
+#include <atca_basic.h>
+#include <atca_crypto_sw_sha2.h>
+#include <atca_hal.h>
+#include <PropWare/PropWare.h>
+
+#include <cstring>
+
+typedef enum {
+    /** Software for messages shorter than the device threshold, the device otherwise */
+    SHA_ENGINE_AUTOMATIC,
+    SHA_ENGINE_DEVICE,
+    SHA_ENGINE_SOFTWARE
+} ShaEngine;
+
+/**
+ * @brief SHA-256 over a message delivered in pieces, computed by the secure element or in software
+ *
+ * The device engine keeps one 64-byte block executing on the chip while the next one is gathered in hub memory and
+ * framed as a complete command packet, CRC included. The block is sent the moment the previous one finishes, so the
+ * host's copying and CRC work hides behind the device's execution time. The device stays awake from start() to
+ * finish() (re-armed before its watchdog expires), so nothing pays for a wake per block the way atcab_sha() does.
+ *
+ * Short messages never amortize the Start and End commands and are hashed faster in software; with
+ * SHA_ENGINE_AUTOMATIC the expected length decides.
+ *
+ * Uses the library's current device, like the atcab_* functions: select it first, and hold the LibraryLock from
+ * start() to finish() when other cogs share the library. TempKey is overwritten by the device engine.
+ *
+ * @code
+ * Sha256Stream sha;
+ * check_errors(sha.start(fileSize));
+ * while (...)
+ *     check_errors(sha.update(chunk, chunkSize));
+ * check_errors(sha.finish(digest));
+ * @endcode
+ */
+class Sha256Stream {
+    public:
+        static const size_t   BLOCK_SIZE               = ATCA_SHA256_BLOCK_SIZE;
+        static const size_t   DIGEST_SIZE              = ATCA_SHA_DIGEST_SIZE;
+        /** Passed to start() when the length of the message is not known up front */
+        static const size_t   UNKNOWN_LENGTH           = static_cast<size_t>(-1);
+        /**
+         * Start and End each cost a full command, where software pays per block only. Four blocks is where the
+         * device overtakes software in cryptoauth_bench, whose software cost is an estimate (4 ms per block of CMM
+         * code), not a measurement. On the Propeller, derive the threshold from device_threshold_for() instead.
+         */
+        static const size_t   DEFAULT_DEVICE_THRESHOLD = 4 * BLOCK_SIZE;
+        /** Maximum SHA execution time the library allows for */
+        static const uint32_t SHA_EXECUTION_MAX_MS     = 9;
+
+    public:
+        Sha256Stream ()
+                : m_deviceThreshold(DEFAULT_DEVICE_THRESHOLD),
+                  m_engine(SHA_ENGINE_SOFTWARE),
+                  m_active(false),
+                  m_status(0),
+                  m_halConfig(NULL),
+                  m_heldAwake(false),
+                  m_inFlight(false),
+                  m_next(0),
+                  m_staged(0) {
+        }
+
+        ~Sha256Stream () {
+            if (this->m_active && SHA_ENGINE_DEVICE == this->m_engine)
+                this->release_device();
+        }
+
+        /**
+         * @brief Shortest expected message that SHA_ENGINE_AUTOMATIC hands to the device
+         */
+        void set_device_threshold (const size_t bytes) {
+            this->m_deviceThreshold = bytes;
+        }
+
+        size_t device_threshold () const {
+            return this->m_deviceThreshold;
+        }
+
+        /**
+         * @brief Time software compressions with CNT
+         *
+         * Only meaningful on the Propeller, built with the memory model of the program that hashes: the simulator's
+         * clock does not advance while host code runs.
+         *
+         * @return Microseconds per 64-byte block
+         */
+        static uint32_t measure_software_block_micros (const unsigned int blocks = 8) {
+            atcac_sha2_256_ctx context;
+            uint8_t            block[BLOCK_SIZE];
+            memset(block, 0xA5, sizeof(block));
+
+            atcac_sw_sha2_256_init(&context);
+            const uint32_t start = CNT;
+            for (unsigned int i = 0; i < blocks; ++i)
+                atcac_sw_sha2_256_update(&context, block, sizeof(block));
+            return (CNT - start) / MICROSECOND / blocks;
+        }
+
+        /**
+         * @brief Shortest message the device hashes faster than software
+         *
+         * Software pays `softwareBlockMicros` for every block. The device pays `deviceBlockMicros` for every block,
+         * plus `deviceFixedMicros` for the wake, Start and End of each message.
+         *
+         * @return Threshold for set_device_threshold(); UNKNOWN_LENGTH if the device never catches up
+         */
+        static size_t device_threshold_for (const uint32_t softwareBlockMicros, const uint32_t deviceFixedMicros,
+                                            const uint32_t deviceBlockMicros) {
+            if (softwareBlockMicros <= deviceBlockMicros)
+                return UNKNOWN_LENGTH;
+            const uint32_t savedPerBlock = softwareBlockMicros - deviceBlockMicros;
+            return (deviceFixedMicros + savedPerBlock - 1) / savedPerBlock * BLOCK_SIZE;
+        }
+
+        /**
+         * @brief Begin a new message, abandoning any unfinished one
+         *
+         * @param[in]   expectedLength  Total length of the message, or UNKNOWN_LENGTH (which selects the device)
+         * @param[in]   engine
+         */
+        PropWare::ErrorCode start (const size_t expectedLength = UNKNOWN_LENGTH,
+                                   const ShaEngine engine = SHA_ENGINE_AUTOMATIC) {
+            if (this->m_active && SHA_ENGINE_DEVICE == this->m_engine)
+                this->release_device();
+
+            this->m_engine   = this->engine_for(expectedLength, engine);
+            this->m_active   = true;
+            this->m_status   = 0;
+            this->m_inFlight = false;
+            this->m_next     = 0;
+            this->m_staged   = 0;
+
+            if (SHA_ENGINE_SOFTWARE == this->m_engine) {
+                atcac_sw_sha2_256_init(&this->m_context);
+                return 0;
+            }
+
+            this->m_halConfig = static_cast<PropHalConfig *>(atgetifacecfg(atGetIFace(atcab_get_device()))->cfg_data);
+            if (!this->m_halConfig)
+                return this->fail(ATCA_BAD_PARAM);
+            this->m_heldAwake            = this->m_halConfig->holdAwake;
+            this->m_halConfig->holdAwake = true;
+
+            PropWare::ErrorCode err = atcab_wakeup();
+            if (!err)
+                err = atcab_sha_start();
+            return err ? this->fail(err) : 0;
+        }
+
+        PropWare::ErrorCode update (const uint8_t *data, size_t length) {
+            if (!this->m_active)
+                return ATCA_FUNC_FAIL;
+            if (this->m_status)
+                return this->m_status;
+
+            if (SHA_ENGINE_SOFTWARE == this->m_engine) {
+                atcac_sw_sha2_256_update(&this->m_context, data, length);
+                return 0;
+            }
+
+            // Gather straight into the payload of the packet that goes out next
+            while (length) {
+                const size_t room  = BLOCK_SIZE - this->m_staged;
+                const size_t count = length < room ? length : room;
+                memcpy(&this->m_packets[this->m_next][DATA_OFFSET + this->m_staged], data, count);
+                this->m_staged += count;
+                data += count;
+                length -= count;
+
+                if (BLOCK_SIZE == this->m_staged) {
+                    const PropWare::ErrorCode err = this->send_block();
+                    if (err)
+                        return err;
+                }
+            }
+            return 0;
+        }
+
+        /**
+         * @brief Complete the message. The device engine is released whether or not this succeeds.
+         */
+        PropWare::ErrorCode finish (uint8_t digest[DIGEST_SIZE]) {
+            if (!this->m_active)
+                return ATCA_FUNC_FAIL;
+            this->m_active = false;
+
+            if (SHA_ENGINE_SOFTWARE == this->m_engine) {
+                atcac_sw_sha2_256_finish(&this->m_context, digest);
+                return 0;
+            }
+
+            PropWare::ErrorCode err = this->m_status;
+            if (!err)
+                err = this->complete_block();
+            if (!err)
+                err = atcab_sha_end(digest, static_cast<uint16_t>(this->m_staged),
+                                    &this->m_packets[this->m_next][DATA_OFFSET]);
+            this->release_device();
+            return err;
+        }
+
+        /**
+         * @brief Hash a whole message in one call
+         */
+        PropWare::ErrorCode hash (const uint8_t *data, const size_t length, uint8_t digest[DIGEST_SIZE],
+                                  const ShaEngine engine = SHA_ENGINE_AUTOMATIC) {
+            PropWare::ErrorCode err = this->start(length, engine);
+            if (!err)
+                err = this->update(data, length);
+            const PropWare::ErrorCode finished = this->finish(digest);
+            return err ? err : finished;
+        }
+
+        /**
+         * @return Engine that start() would use for a message of `expectedLength` bytes
+         */
+        ShaEngine engine_for (const size_t expectedLength, const ShaEngine engine = SHA_ENGINE_AUTOMATIC) const {
+            if (SHA_ENGINE_AUTOMATIC != engine)
+                return engine;
+            return expectedLength < this->m_deviceThreshold ? SHA_ENGINE_SOFTWARE : SHA_ENGINE_DEVICE;
+        }
+
+        /**
+         * @return Engine picked by the most recent start()
+         */
+        ShaEngine engine () const {
+            return this->m_engine;
+        }
+
+    protected:
+        /** Count, opcode, mode, length and CRC around one block */
+        static const uint8_t COMMAND_SIZE = ATCA_CMD_SIZE_MIN + BLOCK_SIZE;
+        /** Packets start with the byte the HAL reserves for the word address */
+        static const size_t  PACKET_SIZE  = 1 + COMMAND_SIZE;
+        static const size_t  DATA_OFFSET  = 6;
+
+    protected:
+        /**
+         * @brief Frame the staged block, wait for the previous one to finish, and send it
+         */
+        PropWare::ErrorCode send_block () {
+            uint8_t *const packet = this->m_packets[this->m_next];
+            packet[1] = COMMAND_SIZE;
+            packet[2] = ATCA_SHA;
+            packet[3] = SHA_MODE_SHA256_UPDATE;
+            packet[4] = static_cast<uint8_t>(BLOCK_SIZE);
+            packet[5] = static_cast<uint8_t>(BLOCK_SIZE >> 8);
+            atCRC(COMMAND_SIZE - ATCA_CRC_SIZE, &packet[1], &packet[1 + COMMAND_SIZE - ATCA_CRC_SIZE]);
+
+            PropWare::ErrorCode err = this->complete_block();
+            if (err)
+                return err;
+
+            // Only does anything when the watchdog is due to be re-armed
+            err = atcab_wakeup();
+            if (!err)
+                err = atsend(atGetIFace(atcab_get_device()), packet, COMMAND_SIZE);
+            if (err)
+                return this->fail(err);
+
+            this->m_inFlight = true;
+            this->m_next ^= 1;
+            this->m_staged = 0;
+            return 0;
+        }
+
+        /**
+         * @brief Wait for the block in flight, if any, and check its status
+         */
+        PropWare::ErrorCode complete_block () {
+            if (!this->m_inFlight)
+                return 0;
+            this->m_inFlight = false;
+
+            // Returns as soon as the device answers when the HAL is set up for COMPLETION_ACK_POLLING
+            atca_delay_ms(SHA_EXECUTION_MAX_MS);
+
+            uint8_t  response[ATCA_RSP_SIZE_MIN];
+            uint16_t length = sizeof(response);
+            PropWare::ErrorCode err = atreceive(atGetIFace(atcab_get_device()), response, &length);
+            if (!err && (ATCA_RSP_SIZE_MIN != length || ATCA_SUCCESS != atCheckCrc(response)))
+                err = ATCA_RX_CRC_ERROR;
+            if (!err)
+                err = isATCAError(response);
+            return err ? this->fail(err) : 0;
+        }
+
+        PropWare::ErrorCode fail (const PropWare::ErrorCode err) {
+            this->m_status = err;
+            return err;
+        }
+
+        /**
+         * @brief Let the device go back to whatever its owner had it doing before start()
+         */
+        void release_device () {
+            if (this->m_inFlight) {
+                atca_delay_ms(SHA_EXECUTION_MAX_MS);
+                this->m_inFlight = false;
+            }
+            this->m_active = false;
+            if (this->m_halConfig) {
+                this->m_halConfig->holdAwake = this->m_heldAwake;
+                if (!this->m_heldAwake)
+                    atcab_idle();
+                this->m_halConfig = NULL;
+            }
+        }
+
+    protected:
+        size_t              m_deviceThreshold;
+        ShaEngine           m_engine;
+        bool                m_active;
+        /** First error of the current message: the device's SHA context is lost and later calls fail with it */
+        PropWare::ErrorCode m_status;
+
+        atcac_sha2_256_ctx  m_context;
+
+        PropHalConfig       *m_halConfig;
+        bool                m_heldAwake;
+        bool                m_inFlight;
+        /** Packet being gathered; the other one is executing when m_inFlight */
+        uint8_t             m_next;
+        size_t              m_staged;
+        uint8_t             m_packets[2][PACKET_SIZE];
+};
@@ -0,0 +1,64 @@
+/**
+ * @file    TraceRecorder.cpp
+ *
+ * @author  David Zemon
+ *
+ * @copyright
+ * The MIT License (MIT)<br>
+ * <br>Copyright (c) 2019 David Zemon<br>
+ * <br>Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:<br>
+ * <br>The above copyright notice and this permission notice shall be included in all copies or substantial portions
+ * of the Software.<br>
+ * <br>THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "TraceRecorder.h"
+
+#include <PropWare/memory/blockstorage.h>
+
+#include <cstring>
+
+PropWare::ErrorCode TraceRecorder::flush (const PropWare::BlockStorage &storage, const uint32_t firstBlock) {
+    PropWare::ErrorCode err;
+    const size_t        blockSize = storage.get_sector_size();
+    uint8_t             block[MAX_BLOCK_SIZE];
+
+    if (MAX_BLOCK_SIZE < blockSize)
+        return ATCA_INVALID_SIZE;
+
+    while (this->pending() >= blockSize) {
+        for (size_t i = 0; i < blockSize; ++i)
+            block[i] = this->m_buffer[(this->m_head + i) & this->m_mask];
+        check_errors(storage.write_data_block(firstBlock + 1 + this->m_flushedBytes / blockSize, block));
+        this->m_head += blockSize;
+        this->m_flushedBytes += blockSize;
+    }
+
+    // Left in the ring, to be completed by later records and written again
+    const size_t partial = this->pending();
+    if (partial) {
+        memset(block, 0, blockSize);
+        for (size_t i = 0; i < partial; ++i)
+            block[i] = this->m_buffer[(this->m_head + i) & this->m_mask];
+        check_errors(storage.write_data_block(firstBlock + 1 + this->m_flushedBytes / blockSize, block));
+    }
+
+    TraceHeader header;
+    header.magic          = TraceHeader::MAGIC;
+    header.version        = TraceHeader::VERSION;
+    header.recordSize     = sizeof(TraceRecord);
+    header.clockFrequency = CLKFREQ;
+    header.blockSize      = blockSize;
+    header.bytes          = this->m_flushedBytes + partial;
+    header.dropped        = this->m_dropped;
+    memset(block, 0, blockSize);
+    memcpy(block, &header, sizeof(header));
+    return storage.write_data_block(firstBlock, block);
+}
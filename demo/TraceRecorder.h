@@ -0,0 +1,214 @@
+/**
+ * @file    TraceRecorder.h
+ *
+ * @author  David Zemon
+ *
+ * @copyright
+ * The MIT License (MIT)<br>
+ * <br>Copyright (c) 2019 David Zemon<br>
+ * <br>Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:<br>
+ * <br>The above copyright notice and this permission notice shall be included in all copies or substantial portions
+ * of the Software.<br>
+ * <br>THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <atca_command.h>
+#include <PropWare/PropWare.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace PropWare {
+class BlockStorage;
+}
+
+/**
+ * @brief What a trace record describes
+ */
+typedef enum {
+    TRACE_WAKE,
+    TRACE_SEND,
+    TRACE_RECEIVE,
+    TRACE_IDLE,
+    TRACE_SLEEP
+} TraceKind;
+
+/**
+ * @brief One bus transaction, as stored in the ring and on the card
+ *
+ * Followed by `stored` payload bytes, padded to a multiple of four. Little-endian on both the Propeller and the
+ * hosts that replay traces, so the layout is used as-is on both ends.
+ */
+struct TraceRecord {
+    /** `CNT` when the transaction started */
+    uint32_t startedAt;
+    /** Duration in clock ticks */
+    uint32_t ticks;
+    uint8_t  kind;
+    uint8_t  bus;
+    uint8_t  address;
+    /** ATCA_STATUS the HAL returned */
+    uint8_t  status;
+    /** Bytes on the wire after the address (excluding the word address byte) */
+    uint8_t  length;
+    /** Payload bytes following the record: `length`, or 0 if only the CRC was kept */
+    uint8_t  stored;
+    /** CRC-16 (the CryptoAuth polynomial) over the payload */
+    uint16_t crc;
+};
+
+/**
+ * @brief First block of a trace on the card
+ *
+ * Records start in the next block and are packed back to back, across block boundaries.
+ */
+struct TraceHeader {
+    static const uint32_t MAGIC   = 0x54433249; // "I2CT"
+    static const uint16_t VERSION = 1;
+
+    uint32_t magic;
+    uint16_t version;
+    uint16_t recordSize;
+    uint32_t clockFrequency;
+    uint32_t blockSize;
+    /** Bytes of records following this block */
+    uint32_t bytes;
+    /** Records lost because the ring was full */
+    uint32_t dropped;
+};
+
+/**
+ * @brief Record every transaction the HAL puts on the bus, for analysis off-target
+ *
+ * Records go to a ring in hub RAM from whichever cog is driving the bus, and flush() moves them to an SD card (or any
+ * other BlockStorage) from the application's cog. When the ring is full, new records are dropped and counted rather
+ * than stalling the bus. Command packets are stored in full so that a trace can be replayed (see trace_replay.cpp);
+ * responses carry key material and random numbers, so by default only their CRC is kept.
+ *
+ * @code
+ * uint8_t       traceBuffer[4096];
+ * TraceRecorder trace(traceBuffer);
+ * hal_prop_set_trace_recorder(&trace);
+ * ...
+ * PropWare::SD sd;
+ * check_errors(sd.start());
+ * check_errors(trace.flush(sd, TRACE_FIRST_BLOCK));
+ * @endcode
+ */
+class TraceRecorder {
+    public:
+        /**
+         * @param[in] buffer    Ring storage. Its size must be a power of two and at least twice the storage's block
+         *                      size, since up to one block of records stays in the ring between flushes.
+         */
+        template<size_t N>
+        explicit TraceRecorder (uint8_t (&buffer)[N])
+                : m_buffer(buffer),
+                  m_mask(N - 1),
+                  m_head(0),
+                  m_tail(0),
+                  m_dropped(0),
+                  m_storeResponses(false),
+                  m_flushedBytes(0) {
+            static_assert(0 == (N & (N - 1)), "TraceRecorder buffer size must be a power of two");
+        }
+
+        /**
+         * @brief Keep the bytes of responses too, not just their CRC. Only for test keys.
+         */
+        void store_responses (const bool store) {
+            this->m_storeResponses = store;
+        }
+
+        /**
+         * @brief Called by the HAL after each transaction
+         */
+        void record (const TraceKind kind, const uint8_t bus, const uint8_t address, const uint32_t startedAt,
+                     const uint32_t ticks, const uint8_t status, const uint8_t *payload, const uint8_t length) {
+            TraceRecord entry;
+            entry.startedAt = startedAt;
+            entry.ticks     = ticks;
+            entry.kind      = static_cast<uint8_t>(kind);
+            entry.bus       = bus;
+            entry.address   = address;
+            entry.status    = status;
+            entry.length    = length;
+            entry.stored    = (TRACE_SEND == kind || this->m_storeResponses) ? length : 0;
+
+            uint8_t crc[ATCA_CRC_SIZE] = {0, 0};
+            if (length)
+                atCRC(length, payload, crc);
+            entry.crc = static_cast<uint16_t>(crc[0] | (crc[1] << 8));
+
+            const uint32_t size = sizeof(entry) + padded(entry.stored);
+            if (this->m_mask + 1 - (this->m_tail - this->m_head) < size) {
+                ++this->m_dropped;
+                return;
+            }
+            const uint8_t padding[3] = {0, 0, 0};
+            uint32_t      tail       = this->m_tail;
+            tail = this->put(tail, reinterpret_cast<const uint8_t *>(&entry), sizeof(entry));
+            tail = this->put(tail, payload, entry.stored);
+            tail = this->put(tail, padding, padded(entry.stored) - entry.stored);
+            // Publish the record only once it is complete
+            this->m_tail = tail;
+        }
+
+        /**
+         * @return Bytes recorded and not yet written out in full blocks
+         */
+        size_t pending () const {
+            return this->m_tail - this->m_head;
+        }
+
+        uint32_t dropped () const {
+            return this->m_dropped;
+        }
+
+        /**
+         * @brief Append everything recorded so far to the trace at `firstBlock`, then update the trace's header
+         *
+         * Full blocks are written once. The last, partial block is written padded and rewritten by the next flush,
+         * so a trace read back at any point is complete up to the last flush.
+         *
+         * @param[in] storage       Started block device
+         * @param[in] firstBlock    Block address of the trace header; records follow it
+         */
+        PropWare::ErrorCode flush (const PropWare::BlockStorage &storage, const uint32_t firstBlock);
+
+    public:
+        /** Largest block size flush() supports. SD cards use 512-byte blocks. */
+        static const size_t MAX_BLOCK_SIZE = 512;
+
+    protected:
+        static uint32_t padded (const uint32_t length) {
+            return (length + 3) & ~3u;
+        }
+
+        uint32_t put (uint32_t position, const uint8_t *data, const size_t length) {
+            for (size_t i = 0; i < length; ++i)
+                this->m_buffer[position++ & this->m_mask] = data[i];
+            return position;
+        }
+
+    protected:
+        uint8_t *const    m_buffer;
+        const uint32_t    m_mask;
+        /** Advanced by flush() only */
+        volatile uint32_t m_head;
+        /** Advanced by record() only */
+        volatile uint32_t m_tail;
+        volatile uint32_t m_dropped;
+        bool              m_storeResponses;
+        /** Bytes of records in full blocks on the card */
+        uint32_t          m_flushedBytes;
+};
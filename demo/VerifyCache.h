@@ -0,0 +1,204 @@
+/**
+ * @file    VerifyCache.h
+ *
+ * @author  David Zemon
+ *
+ * @copyright
+ * The MIT License (MIT)<br>
+ * <br>Copyright (c) 2019 David Zemon<br>
+ * <br>Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:<br>
+ * <br>The above copyright notice and this permission notice shall be included in all copies or substantial portions
+ * of the Software.<br>
+ * <br>THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <atca_basic.h>
+#include <atca_crypto_sw_sha2.h>
+#include <PropWare/PropWare.h>
+
+#include <cstring>
+
+/**
+ * @brief Remembers signatures that verified, so that checking the same one again never touches the bus
+ *
+ * Firmware manifests, peer certificates and signed configuration get verified over and over, and each
+ * `atcab_verify_extern()` costs a wake and about 60 ms of execution. The cache keys each positive result by the
+ * SHA-256 of the public key, message digest and signature: three software compressions (time them on the target
+ * with Sha256Stream::measure_software_block_micros()). Failed verifications are never stored: a wrong signature always
+ * goes to the device.
+ *
+ * Entries made with a key read from a slot are tagged with that slot. Whoever rewrites the slot must call
+ * invalidate_slot(), or the old key's signatures keep passing.
+ *
+ * Uses the library's current device on a miss, like the atcab_* functions: select it first, and hold the LibraryLock
+ * from another cog. Not safe to share between cogs.
+ *
+ * @code
+ * VerifyCache<16> verifyCache;
+ *
+ * uint8_t trustedKey[ATCA_PUB_KEY_SIZE];
+ * check_errors(cryptoDevice.get_public_key(TRUSTED_SLOT, trustedKey));
+ * bool verified;
+ * check_errors(verifyCache.verify_extern(manifestDigest, manifestSignature, trustedKey, &verified, TRUSTED_SLOT));
+ *
+ * check_errors(cryptoDevice.write_public_key(TRUSTED_SLOT, newTrustedKey));
+ * verifyCache.invalidate_slot(TRUSTED_SLOT);
+ * @endcode
+ *
+ * @tparam ENTRIES  Positive results remembered. The least recently used one makes way for a new one.
+ */
+template<size_t ENTRIES>
+class VerifyCache {
+    static_assert(0 < ENTRIES, "VerifyCache needs at least one entry");
+
+    public:
+        /** Tag for entries whose public key did not come from a slot */
+        static const uint16_t NO_SLOT = 0xFFFF;
+
+        struct Stats {
+            /** Verifications answered from the cache */
+            uint32_t hits;
+            /** Verifications sent to the device */
+            uint32_t misses;
+            /** Entries dropped to make room for a newer result */
+            uint32_t evictions;
+            /** Entries dropped by invalidate_slot() or clear() */
+            uint32_t invalidations;
+        };
+
+    public:
+        VerifyCache ()
+                : m_clock(0) {
+            for (auto &entry : this->m_entries)
+                drop(entry);
+            memset(&this->m_stats, 0, sizeof(this->m_stats));
+        }
+
+        /**
+         * @brief Same as `atcab_verify_extern()`, answered from the cache when this signature verified before
+         *
+         * @param[in]   keySlot     Slot the public key was read from, for invalidate_slot(), or NO_SLOT
+         *
+         * @return 0 upon success (even if the signature did not verify), error code otherwise
+         */
+        PropWare::ErrorCode verify_extern (const uint8_t digest[ATCA_SHA_DIGEST_SIZE],
+                                           const uint8_t signature[ATCA_SIG_SIZE],
+                                           const uint8_t publicKey[ATCA_PUB_KEY_SIZE], bool *verified,
+                                           const uint16_t keySlot = NO_SLOT) {
+            uint8_t key[ATCA_SHA_DIGEST_SIZE];
+            compute_key(digest, signature, publicKey, key);
+
+            Entry *const entry = this->find(key);
+            if (entry) {
+                entry->lastUsed = ++this->m_clock;
+                ++this->m_stats.hits;
+                *verified = true;
+                return 0;
+            }
+
+            ++this->m_stats.misses;
+            const PropWare::ErrorCode err = atcab_verify_extern(digest, signature, publicKey, verified);
+            if (!err && *verified)
+                this->store(key, keySlot);
+            return err;
+        }
+
+        /**
+         * @brief Forget every result that was verified with the key read from `slot`
+         */
+        void invalidate_slot (const uint16_t slot) {
+            for (auto &entry : this->m_entries)
+                if (entry.used && entry.keySlot == slot) {
+                    drop(entry);
+                    ++this->m_stats.invalidations;
+                }
+        }
+
+        void clear () {
+            for (auto &entry : this->m_entries)
+                if (entry.used) {
+                    drop(entry);
+                    ++this->m_stats.invalidations;
+                }
+            this->m_clock = 0;
+        }
+
+        /**
+         * @return Entries in use
+         */
+        size_t size () const {
+            size_t used = 0;
+            for (const auto &entry : this->m_entries)
+                used += entry.used;
+            return used;
+        }
+
+        const Stats &stats () const {
+            return this->m_stats;
+        }
+
+    protected:
+        struct Entry {
+            uint8_t  key[ATCA_SHA_DIGEST_SIZE];
+            uint32_t lastUsed;
+            uint16_t keySlot;
+            bool     used;
+        };
+
+    protected:
+        static void compute_key (const uint8_t digest[ATCA_SHA_DIGEST_SIZE], const uint8_t signature[ATCA_SIG_SIZE],
+                                 const uint8_t publicKey[ATCA_PUB_KEY_SIZE], uint8_t key[ATCA_SHA_DIGEST_SIZE]) {
+            atcac_sha2_256_ctx context;
+            atcac_sw_sha2_256_init(&context);
+            atcac_sw_sha2_256_update(&context, publicKey, ATCA_PUB_KEY_SIZE);
+            atcac_sw_sha2_256_update(&context, digest, ATCA_SHA_DIGEST_SIZE);
+            atcac_sw_sha2_256_update(&context, signature, ATCA_SIG_SIZE);
+            atcac_sw_sha2_256_finish(&context, key);
+        }
+
+        Entry *find (const uint8_t key[ATCA_SHA_DIGEST_SIZE]) {
+            for (auto &entry : this->m_entries)
+                if (entry.used && !memcmp(entry.key, key, ATCA_SHA_DIGEST_SIZE))
+                    return &entry;
+            return NULL;
+        }
+
+        void store (const uint8_t key[ATCA_SHA_DIGEST_SIZE], const uint16_t keySlot) {
+            Entry *victim = &this->m_entries[0];
+            for (auto &entry : this->m_entries) {
+                if (!entry.used) {
+                    victim = &entry;
+                    break;
+                }
+                if (entry.lastUsed < victim->lastUsed)
+                    victim = &entry;
+            }
+            if (victim->used)
+                ++this->m_stats.evictions;
+
+            memcpy(victim->key, key, ATCA_SHA_DIGEST_SIZE);
+            victim->lastUsed = ++this->m_clock;
+            victim->keySlot  = keySlot;
+            victim->used     = true;
+        }
+
+        static void drop (Entry &entry) {
+            memset(entry.key, 0, ATCA_SHA_DIGEST_SIZE);
+            entry.used = false;
+        }
+
+    protected:
+        Entry    m_entries[ENTRIES];
+        /** Stamped on an entry whenever it is stored or hit. 32 bits do not wrap in the life of a device. */
+        uint32_t m_clock;
+        Stats    m_stats;
+};
@@ -2,6 +2,10 @@
 // Created by david on 1/16/19.
 //
 
+#include "atca_hal_prop.h"
+#include "I2CCog.h"
+#include "TraceRecorder.h"
+
 #include <cryptoauthlib.h>
 #include <atca_hal.h>
 #include <PropWare/serial/i2c/i2cmaster.h>
@@ -17,6 +21,199 @@ static I2CMaster g_i2c (Pin::Mask::P1, Pin::Mask::P2);
 static I2CMaster    *i2cBuses[]         = {&pwI2c, &g_i2c};
 static const size_t AVAILABLE_I2C_BUSES = Utility::size_of_array(i2cBuses);
 
+/** Pins of each entry in i2cBuses, for the cog transport */
+static const struct {
+    Pin::Mask scl;
+    Pin::Mask sda;
+} BUS_PINS[] = {
+    {Pin::Mask::P28, Pin::Mask::P29},
+    {Pin::Mask::P1, Pin::Mask::P2}
+};
+
+static const int NO_LOCK  = -1;
+static const int NO_OWNER = -1;
+
+static const size_t COG_COUNT = 8;
+
+/** Guards g_nextTicket only. The library lock itself is the ticket being served. */
+static int                     g_libraryLock           = NO_LOCK;
+static volatile uint32_t       g_nextTicket            = 0;
+static volatile uint32_t       g_nowServing            = 0;
+static volatile int            g_libraryLockOwner      = NO_OWNER;
+/** Nested acquires by the owner, which are matched by as many releases before the lock is passed on */
+static unsigned int            g_libraryLockDepth      = 0;
+/** Cogs that gave up the lock in atca_delay_ms(), one bit per cog */
+static volatile int            g_yieldedCogs           = 0;
+/** Depth each yielded cog held the lock at, restored by resume() */
+static unsigned int            g_yieldedDepth[COG_COUNT];
+/** Device whose command each yielded cog is waiting for. Its response buffer is not ours to touch until collected. */
+static ATCADevice volatile     g_yieldedDevices[COG_COUNT];
+static LibraryLock::Statistics g_libraryLockStatistics = {0, 0, 0, 0};
+
+/** The library's hal_i2c_discover_devices() does not say how large its array is. Matches atcab's own limit. */
+static const int     MAX_DISCOVERED_DEVICES = 10;
+/** Info(Revision) does not take longer than this on any supported part */
+static const uint8_t INFO_EXECUTION_MS      = 1;
+static const uint8_t INFO_RESPONSE_SIZE     = 7;
+static const uint8_t WAKE_TOKEN_SIZE        = 4;
+/** Where CryptoAuth parts ship and are usually re-addressed to (7-bit 0x60-0x67) */
+static const uint8_t DEFAULT_DISCOVERY_ADDRESSES[] = {0xC0, 0xC2, 0xC4, 0xC6, 0xC8, 0xCA, 0xCC, 0xCE};
+
+/** SDA low time for the wake condition when the cog transport generates it directly (tWLO is 60 us minimum) */
+static const uint32_t COG_WAKE_PULSE_US = 80;
+
+static TraceRecorder *g_traceRecorder = NULL;
+static WaitTask      *g_waitTask      = NULL;
+
+/**
+ * The library sends a command and then calls atca_delay_ms() with the opcode's worst-case execution time. When ACK
+ * polling is enabled, hal_i2c_send() leaves a note here so that the delay can be cut short.
+ */
+static struct {
+    ATCAIface iface;
+    uint8_t   opcode;
+} g_pendingCommand = {NULL, 0};
+
+/**
+ * @return False for the commands that leave TempKey alone whatever their parameters. Every other one may replace or
+ *         invalidate it.
+ */
+static bool may_change_temp_key (const uint8_t opcode) {
+    return ATCA_READ != opcode && ATCA_WRITE != opcode && ATCA_INFO != opcode;
+}
+
+static PropHalConfig *hal_config (const ATCAIfaceCfg *cfg) {
+    return static_cast<PropHalConfig *>(cfg->cfg_data);
+}
+
+#ifdef PROPCRYPTO_HAL_STATS
+static HalStats *hal_stats (const PropHalConfig *halConfig) {
+    return halConfig ? halConfig->stats : NULL;
+}
+
+static uint32_t stats_clock () {
+    return CNT;
+}
+#else
+// Constant results let the compiler drop every use of the statistics
+static HalStats *hal_stats (const PropHalConfig *halConfig) {
+    return NULL;
+}
+
+static uint32_t stats_clock () {
+    return 0;
+}
+#endif
+
+static uint32_t stats_micros (const uint32_t since) {
+    return (stats_clock() - since) / MICROSECOND;
+}
+
+static void trace (const ATCAIfaceCfg *cfg, const TraceKind kind, const uint32_t startedAt, const ATCA_STATUS status,
+                   const uint8_t *payload, const size_t length) {
+    if (g_traceRecorder)
+        g_traceRecorder->record(kind, cfg->atcai2c.bus, cfg->atcai2c.slave_address, startedAt, CNT - startedAt,
+                                static_cast<uint8_t>(status), payload, static_cast<uint8_t>(length));
+}
+
+static bool use_cog (const PropHalConfig *halConfig) {
+    return halConfig && TRANSPORT_COG == halConfig->transport && I2CCog::instance().running();
+}
+
+static I2CCog::Bus cog_bus (const ATCAIfaceCfg *cfg) {
+    const auto  &pins   = BUS_PINS[cfg->atcai2c.bus];
+    const auto  halfBit = CLKFREQ / cfg->atcai2c.baud / 2;
+    I2CCog::Bus bus;
+    bus.sclMask      = pins.scl;
+    bus.sdaMask      = pins.sda;
+    bus.halfBitTicks = halfBit > I2C_COG_MIN_HALF_BIT + I2C_COG_HOLD_OVERHEAD
+                       ? halfBit - I2C_COG_HOLD_OVERHEAD
+                       : I2C_COG_MIN_HALF_BIT;
+    return bus;
+}
+
+/**
+ * @brief Address the device once and report whether it acknowledged
+ */
+static bool ping (ATCAIface iface) {
+    const auto cfg = atgetifacecfg(iface);
+    if (use_cog(hal_config(cfg)))
+        return I2CCog::instance().poll(cog_bus(cfg), cfg->atcai2c.slave_address, 0, 0);
+    else
+        return ((I2CMaster *) atgetifacehaldat(iface))->ping(cfg->atcai2c.slave_address);
+}
+
+/**
+ * @brief Write a lone word address (idle, sleep) to the device
+ */
+static bool put_word_address (ATCAIface iface, const uint8_t wordAddress) {
+    const auto cfg = atgetifacecfg(iface);
+    if (use_cog(hal_config(cfg)))
+        return I2C_COG_SUCCESS == I2CCog::instance().send(cog_bus(cfg), cfg->atcai2c.slave_address, wordAddress,
+                                                           NULL, 0);
+    else
+        return ((I2CMaster *) atgetifacehaldat(iface))->put(cfg->atcai2c.slave_address, wordAddress);
+}
+
+/**
+ * @brief Issue the wake condition. Shared by hal_i2c_wake() and discovery, which has no ATCAIface yet.
+ */
+static void wake_pulse (I2CMaster &i2c, const uint32_t baud) {
+    // Waking the device requires holding SDA low for a period of time. Easiest way to do this is to set the
+    // frequency to 100kHz and then ping address 0. We're not looking for a response - just want to hold SDA low for
+    // a little while.
+    i2c.set_frequency(100000);
+    i2c.ping(0);
+    i2c.set_frequency(baud);
+}
+
+static void poll_for_completion (ATCAIface iface, const uint8_t opcode, const uint32_t maxDelayMs) {
+    const auto     cfg       = atgetifacecfg(iface);
+    const auto     i2c       = (I2CMaster *) atgetifacehaldat(iface);
+    const auto     halConfig = hal_config(cfg);
+    const uint32_t interval  = MICROSECOND * halConfig->pollIntervalUs;
+    const uint32_t timeout   = MILLISECOND * maxDelayMs;
+    const uint32_t start     = CNT;
+
+    // The device NACKs its address until execution completes
+    bool     ready;
+    uint32_t elapsed;
+    if (LibraryLock::yielded()) {
+        // Another cog may be using the bus between our polls
+        do {
+            waitcnt(CNT + interval);
+            LibraryLock::acquire(NULL);
+            ready = ping(iface);
+            LibraryLock::release();
+            elapsed = CNT - start;
+        } while (!ready && elapsed < timeout);
+    } else if (use_cog(halConfig)) {
+        waitcnt(CNT + interval);
+        ready   = I2CCog::instance().poll(cog_bus(cfg), cfg->atcai2c.slave_address, interval,
+                                             timeout > interval ? timeout - interval : 0);
+        elapsed = CNT - start;
+    } else {
+        do {
+            waitcnt(CNT + interval);
+            ready   = i2c->ping(cfg->atcai2c.slave_address);
+            elapsed = CNT - start;
+        } while (!ready && elapsed < timeout);
+    }
+
+    if (halConfig->completionReport) {
+        const auto entry = halConfig->completionReport->entry_for(opcode);
+        if (entry) {
+            ++entry->commands;
+            if (ready) {
+                if (elapsed < timeout)
+                    entry->savedMicros += (timeout - elapsed) / MICROSECOND;
+            } else {
+                ++entry->fallbacks;
+            }
+        }
+    }
+}
+
 ATCA_STATUS hal_i2c_init (void *hal, ATCAIfaceCfg *cfg) {
     if (cfg->atcai2c.bus >= AVAILABLE_I2C_BUSES) {
         return ATCA_COMM_FAIL;
@@ -24,6 +221,15 @@ ATCA_STATUS hal_i2c_init (void *hal, ATCAIfaceCfg *cfg) {
     auto *const i2c = i2cBuses[cfg->atcai2c.bus];
     i2c->set_frequency(cfg->atcai2c.baud);
     ((ATCAHAL_t *) hal)->hal_data = i2c;
+
+    const auto halConfig = hal_config(cfg);
+    if (halConfig && TRANSPORT_COG == halConfig->transport) {
+        if (!I2CCog::instance().start())
+            return ATCA_COMM_FAIL;
+        // Let go of the lines in this cog; from here on the transport cog pulls them low when it needs to
+        Pin(BUS_PINS[cfg->atcai2c.bus].scl).set_dir_in();
+        Pin(BUS_PINS[cfg->atcai2c.bus].sda).set_dir_in();
+    }
     return ATCA_SUCCESS;
 }
 
@@ -32,30 +238,99 @@ ATCA_STATUS hal_i2c_post_init (ATCAIface iface) {
 }
 
 ATCA_STATUS hal_i2c_send (ATCAIface iface, uint8_t *txdata, int txlength) {
-    const auto cfg = atgetifacecfg(iface);
-    const auto i2c = (I2CMaster *) atgetifacehaldat(iface);
+    const auto cfg       = atgetifacecfg(iface);
+    const auto i2c       = (I2CMaster *) atgetifacehaldat(iface);
+    const auto halConfig = hal_config(cfg);
+    const auto stats     = hal_stats(halConfig);
+    const auto started   = stats_clock();
+    const auto startedAt = CNT;
 
     // The Microchip library inserts an extra (blank) byte into the txdata array for us to insert the 0x03. The
     // PropWare library does not expect that at all and therefore we send txdata starting with txdata[1]
-    if (i2c->put(cfg->atcai2c.slave_address, static_cast<uint8_t>(0x03), &txdata[1], static_cast<size_t>(txlength)))
-        return ATCA_SUCCESS;
+    bool sent;
+    if (use_cog(halConfig))
+        sent = I2C_COG_SUCCESS == I2CCog::instance().send(cog_bus(cfg), cfg->atcai2c.slave_address, 0x03, &txdata[1],
+                                                           static_cast<size_t>(txlength));
     else
+        sent = i2c->put(cfg->atcai2c.slave_address, static_cast<uint8_t>(0x03), &txdata[1],
+                        static_cast<size_t>(txlength));
+    trace(cfg, TRACE_SEND, startedAt, sent ? ATCA_SUCCESS : ATCA_TX_TIMEOUT, &txdata[1],
+          static_cast<size_t>(txlength));
+
+    if (stats) {
+        stats->current = stats->entry_for(txdata[2]);
+        if (stats->current) {
+            ++stats->current->commands;
+            stats->current->phases[HalStats::PHASE_SEND].record(stats_micros(started));
+            if (!sent)
+                ++stats->current->nacks;
+        } else {
+            ++stats->untracked;
+        }
+        stats->sentAt = stats_clock();
+    }
+
+    if (sent) {
+        if (halConfig && COMPLETION_ACK_POLLING == halConfig->completion) {
+            g_pendingCommand.iface  = iface;
+            g_pendingCommand.opcode = txdata[2];
+        }
+        if (halConfig && may_change_temp_key(txdata[2]))
+            ++halConfig->volatileEpoch;
+        return ATCA_SUCCESS;
+    } else {
+        // Whatever we believed, the device isn't listening. Make sure the next wake is a real one.
+        if (halConfig) {
+            halConfig->awake = false;
+            ++halConfig->volatileEpoch;
+        }
         return ATCA_TX_TIMEOUT;
+    }
 }
 
-ATCA_STATUS hal_i2c_receive (ATCAIface iface, uint8_t *rxdata, uint16_t *rxlength) {
+static ATCA_STATUS receive_with_cog (ATCAIfaceCfg *cfg, uint8_t *rxdata, uint16_t *rxlength,
+                                     const uint16_t rxDataMaxSize, HalStats::Entry *command) {
     ATCA_STATUS status;
-    const auto  cfg           = atgetifacecfg(iface);
-    const auto  i2c           = (I2CMaster *) atgetifacehaldat(iface);
-    const auto  rxDataMaxSize = *rxlength;
-    auto        retries       = cfg->rx_retries;
+    const auto  bus     = cog_bus(cfg);
+    auto        retries = cfg->rx_retries;
+    bool        retry   = false;
 
-    *rxlength = 0; // Set the actual length now so that any errors report accurate return values
-    if (!rxDataMaxSize) {
-        return ATCA_SMALL_BUFFER;
-    }
+    do {
+        if (command && retry)
+            ++command->retries;
+        retry = true;
+
+        uint16_t length = rxDataMaxSize;
+        switch (I2CCog::instance().receive(bus, cfg->atcai2c.slave_address, rxdata, &length)) {
+            case I2C_COG_SUCCESS:
+                *rxlength = length;
+                return ATCA_SUCCESS;
+            case I2C_COG_INVALID_SIZE:
+                return ATCA_INVALID_SIZE;
+            case I2C_COG_SMALL_BUFFER:
+                return ATCA_SMALL_BUFFER;
+            default:
+                if (command)
+                    ++command->nacks;
+                status = ATCA_COMM_FAIL;
+        }
+    } while (--retries > 0);
+    return status;
+}
+
+static ATCA_STATUS receive_with_i2c_master (ATCAIface iface, uint8_t *rxdata, uint16_t *rxlength,
+                                            const uint16_t rxDataMaxSize, HalStats::Entry *command) {
+    ATCA_STATUS status;
+    const auto  cfg     = atgetifacecfg(iface);
+    const auto  i2c     = (I2CMaster *) atgetifacehaldat(iface);
+    auto        retries = cfg->rx_retries;
+    bool        retry   = false;
 
     do {
+        if (command && retry)
+            ++command->retries;
+        retry = true;
+
         i2c->start();
         const auto success = i2c->send_byte(cfg->atcai2c.slave_address | 0x01);
         if (success) {
@@ -79,6 +354,8 @@ ATCA_STATUS hal_i2c_receive (ATCAIface iface, uint8_t *rxdata, uint16_t *rxlengt
             *rxlength = expectedDataLength;
             status = ATCA_SUCCESS;
         } else {
+            if (command)
+                ++command->nacks;
             status = ATCA_COMM_FAIL;
         }
     } while (--retries > 0 && status != ATCA_SUCCESS);
@@ -86,48 +363,174 @@ ATCA_STATUS hal_i2c_receive (ATCAIface iface, uint8_t *rxdata, uint16_t *rxlengt
     return status;
 }
 
-ATCA_STATUS hal_i2c_wake (ATCAIface iface) {
+static ATCA_STATUS read_response (ATCAIface iface, uint8_t *rxdata, uint16_t *rxlength, const uint16_t rxDataMaxSize,
+                                  HalStats::Entry *command) {
     const auto cfg = atgetifacecfg(iface);
-    const auto i2c = (I2CMaster *) atgetifacehaldat(iface);
+    if (use_cog(hal_config(cfg)))
+        return receive_with_cog(cfg, rxdata, rxlength, rxDataMaxSize, command);
+    else
+        return receive_with_i2c_master(iface, rxdata, rxlength, rxDataMaxSize, command);
+}
+
+/**
+ * @return True if the response is worth reading again: its CRC does not match, or its length byte made no sense
+ */
+static bool response_damaged (const ATCA_STATUS status, const uint8_t *rxdata) {
+    switch (status) {
+        case ATCA_SUCCESS:
+            return ATCA_SUCCESS != atCheckCrc(rxdata);
+        case ATCA_INVALID_SIZE:
+        case ATCA_SMALL_BUFFER:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief hal_i2c_receive() without the trace, for the wake response
+ */
+static ATCA_STATUS receive (ATCAIface iface, uint8_t *rxdata, uint16_t *rxlength) {
+    const auto cfg           = atgetifacecfg(iface);
+    const auto rxDataMaxSize = *rxlength;
+
+    g_pendingCommand.iface = NULL;
+    *rxlength = 0; // Set the actual length now so that any errors report accurate return values
+    if (!rxDataMaxSize) {
+        return ATCA_SMALL_BUFFER;
+    }
+
+    // Wake responses arrive outside of any command and are not recorded here
+    const auto stats   = hal_stats(hal_config(cfg));
+    const auto command = stats ? stats->current : NULL;
+    const auto started = stats_clock();
+    if (command)
+        command->phases[HalStats::PHASE_EXECUTE].record((started - stats->sentAt) / MICROSECOND);
+
+    auto status = read_response(iface, rxdata, rxlength, rxDataMaxSize, command);
+
+    const auto halConfig = hal_config(cfg);
+    if (halConfig && RECEIVE_REREAD_ON_CRC_ERROR == halConfig->receive) {
+        for (uint8_t reread = 0; response_damaged(status, rxdata) && reread < halConfig->maxRereads; ++reread) {
+            if (command)
+                ++command->rereads;
+            // Word address 0x00 (reset) points the device back at the start of its I/O buffer
+            if (!put_word_address(iface, 0x00))
+                break;
+            *rxlength = 0;
+            status = read_response(iface, rxdata, rxlength, rxDataMaxSize, command);
+        }
+        if (ATCA_SUCCESS == status && response_damaged(status, rxdata))
+            status = ATCA_RX_CRC_ERROR;
+    }
+
+    if (command) {
+        command->phases[HalStats::PHASE_RECEIVE].record(stats_micros(started));
+        stats->current = NULL;
+    }
+    return status;
+}
+
+ATCA_STATUS hal_i2c_receive (ATCAIface iface, uint8_t *rxdata, uint16_t *rxlength) {
+    const auto startedAt = CNT;
+    const auto status    = receive(iface, rxdata, rxlength);
+    trace(atgetifacecfg(iface), TRACE_RECEIVE, startedAt, status, rxdata, *rxlength);
+    return status;
+}
+
+ATCA_STATUS hal_i2c_wake (ATCAIface iface) {
+    const auto cfg       = atgetifacecfg(iface);
+    const auto i2c       = (I2CMaster *) atgetifacehaldat(iface);
+    const auto halConfig = hal_config(cfg);
+    const auto stats     = hal_stats(halConfig);
 
     uint8_t  data[]   = {0x00, 0x00, 0x00, 0x00};
     uint16_t dataSize = sizeof(data);
 
-    // Waking the device requires holding SDA low for a period of time. Easiest way to do this is to set the
-    // frequency to 100kHz and then ping address 0. We're not looking for a response - just want to hold SDA low for
-    // a little while.
-    i2c->set_frequency(100000);
-    i2c->ping(0); // Wake the device
-    i2c->set_frequency(cfg->atcai2c.baud);
+    // A command whose send failed never got as far as its receive
+    if (stats)
+        stats->current = NULL;
+
+    if (halConfig && halConfig->holdAwake && halConfig->awake) {
+        const uint32_t awakeFor = CNT - halConfig->wokeAt;
+        if (awakeFor < MILLISECOND * PropHalConfig::WATCHDOG_REARM_MS)
+            return ATCA_SUCCESS;
+        // Nothing was sent for too long: the device already went to sleep and took TempKey with it
+        if (awakeFor >= MILLISECOND * PropHalConfig::WATCHDOG_MS)
+            ++halConfig->volatileEpoch;
+
+        // The watchdog is about to expire. Idle (which keeps TempKey) and wake again to restart it.
+        const uint32_t idledAt = CNT;
+        const bool     idled   = put_word_address(iface, 0x02);
+        trace(cfg, TRACE_IDLE, idledAt, idled ? ATCA_SUCCESS : ATCA_TX_TIMEOUT, NULL, 0);
+        halConfig->awake = false;
+    }
+
+    const uint32_t wokeAt = CNT;
+    bool           answered;
+    if (use_cog(halConfig)) {
+        const auto bus = cog_bus(cfg);
+        I2CCog::instance().wake(bus, MICROSECOND * COG_WAKE_PULSE_US, MICROSECOND * cfg->wake_delay);
+        answered = I2CCog::instance().poll(bus, cfg->atcai2c.slave_address, 0, 0);
+    } else {
+        wake_pulse(*i2c, cfg->atcai2c.baud);
 
-    waitcnt(CNT + MICROSECOND * cfg->wake_delay);
-    if (!i2c->ping(cfg->atcai2c.slave_address)) {
-        return ATCA_TIMEOUT;
+        waitcnt(CNT + MICROSECOND * cfg->wake_delay);
+        answered = i2c->ping(cfg->atcai2c.slave_address);
+    }
+
+    ATCA_STATUS status;
+    if (!answered) {
+        status = ATCA_TIMEOUT;
     } else {
-        const auto status = hal_i2c_receive(iface, data, &dataSize);
-        if (status != ATCA_SUCCESS)
-            return status;
-        else
-            return hal_check_wake(data, dataSize);
+        status = receive(iface, data, &dataSize);
+        if (status == ATCA_SUCCESS)
+            status = hal_check_wake(data, dataSize);
+        if (status == ATCA_SUCCESS && halConfig) {
+            halConfig->awake  = true;
+            halConfig->wokeAt = wokeAt;
+        }
     }
+
+    trace(cfg, TRACE_WAKE, wokeAt, status, data, dataSize);
+    if (stats) {
+        stats->wake.record((CNT - wokeAt) / MICROSECOND);
+        if (ATCA_SUCCESS != status)
+            ++stats->wakeFailures;
+    }
+    return status;
 }
 
 ATCA_STATUS hal_i2c_idle (ATCAIface iface) {
-    const auto cfg = atgetifacecfg(iface);
-    const auto i2c = (I2CMaster *) atgetifacehaldat(iface);
-    if (i2c->put(cfg->atcai2c.slave_address, 0x02))
-        return ATCA_SUCCESS;
-    else
-        return ATCA_TX_TIMEOUT;
+    const auto cfg       = atgetifacecfg(iface);
+    const auto halConfig = hal_config(cfg);
+
+    if (halConfig) {
+        // Leave the device awake for the next command in the session
+        if (halConfig->holdAwake && halConfig->awake)
+            return ATCA_SUCCESS;
+        halConfig->awake = false;
+    }
+
+    const uint32_t startedAt = CNT;
+    const auto     status    = put_word_address(iface, 0x02) ? ATCA_SUCCESS : ATCA_TX_TIMEOUT;
+    trace(cfg, TRACE_IDLE, startedAt, status, NULL, 0);
+    return status;
 }
 
 ATCA_STATUS hal_i2c_sleep (ATCAIface iface) {
-    const auto cfg = atgetifacecfg(iface);
-    const auto i2c = (I2CMaster *) atgetifacehaldat(iface);
-    if (i2c->put(cfg->atcai2c.slave_address, 0x01))
-        return ATCA_SUCCESS;
-    else
-        return ATCA_TX_TIMEOUT;
+    const auto cfg       = atgetifacecfg(iface);
+    const auto halConfig = hal_config(cfg);
+
+    if (halConfig) {
+        halConfig->awake = false;
+        ++halConfig->volatileEpoch;
+    }
+
+    const uint32_t startedAt = CNT;
+    const auto     status    = put_word_address(iface, 0x01) ? ATCA_SUCCESS : ATCA_TX_TIMEOUT;
+    trace(cfg, TRACE_SLEEP, startedAt, status, NULL, 0);
+    return status;
 }
 
 ATCA_STATUS hal_i2c_release (void *hal_data) {
@@ -143,16 +546,301 @@ void atca_delay_10us (uint32_t delay) {
 }
 
 void atca_delay_ms (uint32_t delay) {
-    waitcnt(CNT + MILLISECOND * delay);
+    const auto iface  = g_pendingCommand.iface;
+    const auto opcode = g_pendingCommand.opcode;
+    g_pendingCommand.iface = NULL;
+
+    // Nothing below touches the library, so other cogs may use it for their own devices until this one is done
+    const uint32_t startedAt = CNT;
+    if (g_waitTask) {
+        // Still holding the lock, if we did: the task's own commands take it again and yield it in turn
+        const auto device = atcab_get_device();
+        g_waitTask->run(delay);
+        hal_prop_select_device(device);
+    }
+    const auto owner = LibraryLock::yield();
+
+    if (iface) {
+        poll_for_completion(iface, opcode, delay);
+    } else {
+        const uint32_t elapsed = CNT - startedAt;
+        if (elapsed < MILLISECOND * delay)
+            waitcnt(startedAt + MILLISECOND * delay);
+    }
+    if (owner)
+        LibraryLock::resume(owner);
 }
 
 ATCA_STATUS hal_i2c_discover_buses (int i2c_buses[], int max_buses) {
-    i2c_buses[0] = 0;
-
-    if (2 <= max_buses)
-        i2c_buses[1] = 1;
+    // An I2C bus needs pull-ups: with nothing attached, the released lines do not read high
+    int found = 0;
+    for (size_t bus = 0; bus < AVAILABLE_I2C_BUSES; ++bus)
+        if (Pin(BUS_PINS[bus].scl).read() && Pin(BUS_PINS[bus].sda).read() && found < max_buses)
+            i2c_buses[found++] = static_cast<int>(bus);
 
+    for (int i = found; i < max_buses; ++i)
+        i2c_buses[i] = -1;
     return ATCA_SUCCESS;
 }
 
+ATCA_STATUS hal_i2c_discover_devices (int bus_num, ATCAIfaceCfg *cfg, int *found) {
+    if (0 > bus_num || AVAILABLE_I2C_BUSES <= static_cast<size_t>(bus_num))
+        return ATCA_BAD_PARAM;
+    return hal_prop_discover_devices(1u << bus_num, cfg_ateccx08a_i2c_default, cfg, MAX_DISCOVERED_DEVICES, found);
+}
+
+}
+
+void hal_prop_set_trace_recorder (TraceRecorder *const recorder) {
+    g_traceRecorder = recorder;
+}
+
+void hal_prop_set_wait_task (WaitTask *const task) {
+    g_waitTask = task;
+}
+
+void hal_prop_select_device (const ATCADevice device) {
+    _gDevice = device;
+}
+
+bool LibraryLock::start () {
+    if (NO_LOCK == g_libraryLock)
+        g_libraryLock = locknew();
+    return NO_LOCK != g_libraryLock;
+}
+
+/**
+ * @brief Wait for the calling cog's turn at the library lock
+ *
+ * @return True if another cog held the lock or was already waiting for it
+ */
+static bool take_turn () {
+    // The hub lock is held for a few instructions only, however long the wait for our turn
+    while (lockset(g_libraryLock));
+    const uint32_t ticket = g_nextTicket++;
+    lockclr(g_libraryLock);
+
+    const bool contended = ticket != g_nowServing;
+    while (ticket != g_nowServing);
+    return contended;
+}
+
+/**
+ * @return True if another cog yielded the lock while `device` executes one of its commands
+ */
+static bool executing_elsewhere (const ATCADevice device) {
+    for (size_t cog = 0; cog < COG_COUNT; ++cog)
+        if (cog != static_cast<size_t>(cogid()) && device == g_yieldedDevices[cog])
+            return true;
+    return false;
+}
+
+void LibraryLock::acquire (const ATCADevice device) {
+    if (NO_LOCK != g_libraryLock) {
+        if (cogid() == g_libraryLockOwner) {
+            ++g_libraryLockDepth;
+        } else {
+            const uint32_t startedAt = CNT;
+            bool           contended = take_turn();
+            // A command to a device that is still executing another cog's would clobber its response. Pass our turn
+            // on, so that cog can resume and collect it, and join the end of the line once it has.
+            while (device && executing_elsewhere(device)) {
+                contended = true;
+                ++g_nowServing;
+                while (executing_elsewhere(device));
+                take_turn();
+            }
+            g_libraryLockOwner = cogid();
+            g_libraryLockDepth = 1;
+
+            ++g_libraryLockStatistics.acquisitions;
+            if (contended) {
+                const uint32_t waited = (CNT - startedAt) / MICROSECOND;
+                ++g_libraryLockStatistics.contentions;
+                g_libraryLockStatistics.totalWaitMicros += waited;
+                if (waited > g_libraryLockStatistics.maxWaitMicros)
+                    g_libraryLockStatistics.maxWaitMicros = waited;
+            }
+        }
+    }
+    if (device)
+        hal_prop_select_device(device);
+}
+
+void LibraryLock::release () {
+    if (NO_LOCK != g_libraryLock && cogid() == g_libraryLockOwner && !--g_libraryLockDepth) {
+        g_libraryLockOwner = NO_OWNER;
+        ++g_nowServing;
+    }
+}
+
+ATCADevice LibraryLock::yield () {
+    if (NO_LOCK == g_libraryLock || cogid() != g_libraryLockOwner)
+        return NULL;
+    const auto device = atcab_get_device();
+    if (!device)
+        return NULL;
+    g_yieldedCogs |= 1 << cogid();
+    g_yieldedDepth[cogid()]   = g_libraryLockDepth;
+    g_yieldedDevices[cogid()] = device;
+    g_libraryLockDepth        = 1;
+    release();
+    return device;
+}
+
+void LibraryLock::resume (const ATCADevice device) {
+    acquire(device);
+    g_libraryLockDepth        = g_yieldedDepth[cogid()];
+    g_yieldedDevices[cogid()] = NULL;
+    g_yieldedCogs &= ~(1 << cogid());
+}
+
+bool LibraryLock::yielded () {
+    return g_yieldedCogs & (1 << cogid());
+}
+
+LibraryLock::Statistics LibraryLock::statistics () {
+    return g_libraryLockStatistics;
+}
+
+void LibraryLock::clear_statistics () {
+    const Statistics cleared = {0, 0, 0, 0};
+    acquire(NULL);
+    g_libraryLockStatistics = cleared;
+    release();
+}
+
+static ATCADeviceType device_type (const uint8_t revision[4]) {
+    switch (revision[2]) {
+        case 0x50:
+            return ATECC508A;
+        case 0x60:
+            return ATECC608A;
+        case 0x10:
+            return ATECC108A;
+        case 0x00:
+        case 0x05:
+            return (0x02 == revision[1] || 0x04 == revision[1]) ? ATSHA204A : ATCA_DEV_UNKNOWN;
+        default:
+            return ATCA_DEV_UNKNOWN;
+    }
+}
+
+/*
+ * Discovery has no ATCAIface yet. These take the transport from the configuration's PropHalConfig, like the
+ * interface functions do.
+ */
+
+static void discovery_wake (const ATCAIfaceCfg &cfg) {
+    if (use_cog(hal_config(&cfg)))
+        // No delay per bus: the caller waits out wake_delay once, after every bus has been woken
+        I2CCog::instance().wake(cog_bus(&cfg), MICROSECOND * COG_WAKE_PULSE_US, 0);
+    else
+        wake_pulse(*i2cBuses[cfg.atcai2c.bus], cfg.atcai2c.baud);
+}
+
+static bool discovery_send (const ATCAIfaceCfg &cfg, const uint8_t wordAddress, const uint8_t *data,
+                            const size_t length) {
+    if (use_cog(hal_config(&cfg)))
+        return I2C_COG_SUCCESS == I2CCog::instance().send(cog_bus(&cfg), cfg.atcai2c.slave_address, wordAddress,
+                                                           data, length);
+    else if (length)
+        return i2cBuses[cfg.atcai2c.bus]->put(cfg.atcai2c.slave_address, wordAddress, data, length);
+    else
+        return i2cBuses[cfg.atcai2c.bus]->put(cfg.atcai2c.slave_address, wordAddress);
+}
+
+/**
+ * @brief Read a packet of exactly `size` bytes (length byte included). Reading has no effect on anything but a
+ *        CryptoAuth device's I/O buffer pointer.
+ */
+static bool discovery_receive (const ATCAIfaceCfg &cfg, uint8_t *packet, const uint8_t size) {
+    if (use_cog(hal_config(&cfg))) {
+        uint16_t length = size;
+        return I2C_COG_SUCCESS == I2CCog::instance().receive(cog_bus(&cfg), cfg.atcai2c.slave_address, packet,
+                                                              &length) && size == length;
+    }
+
+    auto *const i2c = i2cBuses[cfg.atcai2c.bus];
+    i2c->start();
+    bool valid = i2c->send_byte(static_cast<uint8_t>(cfg.atcai2c.slave_address | 0x01));
+    if (valid) {
+        packet[0] = i2c->read_byte(true);
+        valid     = size == packet[0];
+        if (valid) {
+            for (size_t j = 1; j < size - 1u; ++j)
+                packet[j] = i2c->read_byte(true);
+            packet[size - 1] = i2c->read_byte(false);
+        }
+    }
+    i2c->stop();
+    return valid;
+}
+
+ATCA_STATUS hal_prop_discover_devices (const uint32_t busMask, const ATCAIfaceCfg &base, ATCAIfaceCfg cfg[],
+                                       const int maxDevices, int *found, const uint8_t addresses[],
+                                       const size_t addressCount) {
+    if (!cfg || !found || 0 > maxDevices || (!addresses && addressCount))
+        return ATCA_BAD_PARAM;
+    *found = 0;
+
+    const uint8_t *const probed     = addresses ? addresses : DEFAULT_DISCOVERY_ADDRESSES;
+    const size_t         probeCount = addresses ? addressCount : sizeof(DEFAULT_DISCOVERY_ADDRESSES);
+
+    // The buses are the library's, whichever cog is using it
+    LibraryLock::Scope lock(NULL);
+
+    ATCAIfaceCfg candidates[MAX_DISCOVERED_DEVICES];
+    size_t       candidateCount = 0;
+
+    // One wake pulse per bus, then a single wake delay covers all of them
+    for (size_t bus = 0; bus < AVAILABLE_I2C_BUSES; ++bus) {
+        if (busMask & (1u << bus)) {
+            ATCAIfaceCfg busCfg = base;
+            busCfg.atcai2c.bus = static_cast<uint8_t>(bus);
+            discovery_wake(busCfg);
+        }
+    }
+    waitcnt(CNT + MICROSECOND * base.wake_delay);
+
+    // A freshly woken CryptoAuth device answers a read with its wake token. Only those are sent a command.
+    for (size_t bus = 0; bus < AVAILABLE_I2C_BUSES; ++bus) {
+        if (!(busMask & (1u << bus)))
+            continue;
+        for (size_t i = 0; i < probeCount && candidateCount < MAX_DISCOVERED_DEVICES; ++i) {
+            ATCAIfaceCfg &candidate = candidates[candidateCount];
+            uint8_t      token[WAKE_TOKEN_SIZE];
+            candidate = base;
+            candidate.atcai2c.bus           = static_cast<uint8_t>(bus);
+            candidate.atcai2c.slave_address = probed[i];
+            if (discovery_receive(candidate, token, sizeof(token))
+                && ATCA_SUCCESS == hal_check_wake(token, sizeof(token)))
+                ++candidateCount;
+        }
+    }
+
+    // Every candidate executes its Info command at the same time
+    uint8_t command[] = {0x07, ATCA_INFO, 0x00, 0x00, 0x00, 0x00, 0x00};
+    atCRC(sizeof(command) - ATCA_CRC_SIZE, command, &command[sizeof(command) - ATCA_CRC_SIZE]);
+    for (size_t i = 0; i < candidateCount; ++i)
+        discovery_send(candidates[i], 0x03, command, sizeof(command));
+    waitcnt(CNT + MILLISECOND * INFO_EXECUTION_MS);
+
+    for (size_t i = 0; i < candidateCount; ++i) {
+        uint8_t    response[INFO_RESPONSE_SIZE];
+        const bool valid = discovery_receive(candidates[i], response, sizeof(response));
+        discovery_send(candidates[i], 0x02, NULL, 0);
+
+        const auto deviceType = valid && ATCA_SUCCESS == atCheckCrc(response) ? device_type(&response[1])
+                                                                                : ATCA_DEV_UNKNOWN;
+        if (ATCA_DEV_UNKNOWN != deviceType && *found < maxDevices) {
+            ATCAIfaceCfg &result = cfg[(*found)++];
+            result = candidates[i];
+            result.iface_type = ATCA_I2C_IFACE;
+            result.devtype    = deviceType;
+            result.cfg_data   = NULL;
+        }
+    }
+
+    return ATCA_SUCCESS;
 }
@@ -0,0 +1,468 @@
+/**
+ * @file    atca_hal_prop.h
+ *
+ * @author  David Zemon
+ *
+ * @copyright
+ * The MIT License (MIT)<br>
+ * <br>Copyright (c) 2019 David Zemon<br>
+ * <br>Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:<br>
+ * <br>The above copyright notice and this permission notice shall be included in all copies or substantial portions
+ * of the Software.<br>
+ * <br>THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <atca_device.h>
+#include <atca_iface.h>
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief How the HAL waits for a command to finish executing
+ */
+typedef enum {
+    /** Wait out the library's worst-case execution time for the opcode */
+    COMPLETION_FIXED_DELAY,
+    /**
+     * Poll the device address and return as soon as the device acknowledges, falling back to the full worst-case
+     * delay if it never does
+     */
+    COMPLETION_ACK_POLLING
+} CompletionMode;
+
+/**
+ * @brief Which code drives the I2C bus for a device
+ */
+typedef enum {
+    /** PropWare::I2CMaster, one call per byte from the CMM-compiled HAL */
+    TRANSPORT_I2C_MASTER,
+    /**
+     * Whole packets, wake pulses and address polling handed to a dedicated cog running native code (see I2CCog).
+     * Costs one cog, shared by every device that selects it.
+     */
+    TRANSPORT_COG
+} Transport;
+
+/**
+ * @brief What the HAL does with a response that arrives damaged
+ */
+typedef enum {
+    /**
+     * Hand every response to the library as read. The library rejects a bad CRC and the whole command, execution
+     * time included, has to be issued again.
+     */
+    RECEIVE_AS_READ,
+    /**
+     * Check the CRC in the HAL and, while it is bad, read the same response again. The device keeps its response in
+     * the I/O buffer until the next command, so a re-read costs only the bus time of the response. Transient noise
+     * is recovered from without repeating the command; a response that is still damaged after the last re-read is
+     * reported as ATCA_RX_CRC_ERROR.
+     */
+    RECEIVE_REREAD_ON_CRC_ERROR
+} ReceiveMode;
+
+/**
+ * @brief Per-opcode record of the time ACK polling saved over the fixed delay
+ */
+struct CompletionReport {
+    static const size_t MAX_OPCODES = 12;
+
+    struct Entry {
+        uint8_t  opcode;
+        uint32_t commands;
+        /** Commands that never acknowledged and fell back to the full delay */
+        uint32_t fallbacks;
+        /** Total microseconds not spent waiting, compared to the fixed delay */
+        uint32_t savedMicros;
+    };
+
+    CompletionReport () {
+        this->clear();
+    }
+
+    void clear () {
+        for (auto &entry : this->entries) {
+            entry.opcode      = 0;
+            entry.commands    = 0;
+            entry.fallbacks   = 0;
+            entry.savedMicros = 0;
+        }
+    }
+
+    /**
+     * @return Entry for the opcode, claiming a free one if necessary, or NULL if the report is full
+     */
+    Entry *entry_for (const uint8_t opcode) {
+        for (auto &entry : this->entries)
+            if (entry.opcode == opcode || !entry.commands) {
+                entry.opcode = opcode;
+                return &entry;
+            }
+        return NULL;
+    }
+
+    Entry entries[MAX_OPCODES];
+};
+
+/**
+ * @brief Where the time goes in each command, and how often the bus misbehaves
+ *
+ * Filled in by the HAL for a device whose PropHalConfig::stats points here. Only available when the program is built
+ * with PROPCRYPTO_HAL_STATS defined (CMake option of the same name); otherwise the HAL contains no instrumentation
+ * at all. Times are measured with `CNT` and recorded in microseconds.
+ *
+ * A command is split into phases: sending the command packet, waiting for execution (from the end of the send to the
+ * start of the receive, whichever way the HAL waits), and receiving the response including retries. Wakes are not
+ * tied to an opcode and are kept separately.
+ */
+struct HalStats {
+    static const size_t MAX_OPCODES    = 12;
+    static const size_t HISTOGRAM_BINS = 8;
+
+    typedef enum {
+        PHASE_SEND,
+        PHASE_EXECUTE,
+        PHASE_RECEIVE,
+        PHASES
+    } Phase;
+
+    struct Latency {
+        uint32_t count;
+        uint32_t minMicros;
+        uint32_t maxMicros;
+        uint32_t totalMicros;
+        /** Bin n counts samples below histogram_limit(n) and at or above the previous bin's limit */
+        uint16_t histogram[HISTOGRAM_BINS];
+
+        void clear () {
+            this->count       = 0;
+            this->minMicros   = 0xFFFFFFFF;
+            this->maxMicros   = 0;
+            this->totalMicros = 0;
+            for (auto &bin : this->histogram)
+                bin = 0;
+        }
+
+        void record (const uint32_t micros) {
+            ++this->count;
+            if (micros < this->minMicros)
+                this->minMicros = micros;
+            if (micros > this->maxMicros)
+                this->maxMicros = micros;
+            this->totalMicros += micros;
+
+            size_t bin = 0;
+            while (bin < HISTOGRAM_BINS - 1 && micros >= histogram_limit(bin))
+                ++bin;
+            if (0xFFFF != this->histogram[bin])
+                ++this->histogram[bin];
+        }
+
+        uint32_t average () const {
+            return this->count ? this->totalMicros / this->count : 0;
+        }
+
+        /**
+         * @return Upper bound of bin n in microseconds: 64 us, then four times wider for each following bin. The last
+         *         bin has no upper bound.
+         */
+        static uint32_t histogram_limit (const size_t bin) {
+            return 64u << (2 * bin);
+        }
+    };
+
+    struct Entry {
+        uint8_t  opcode;
+        uint32_t commands;
+        /** Receive attempts beyond the first, as allowed by `ATCAIfaceCfg::rx_retries` */
+        uint32_t retries;
+        /** Command packets and response reads whose address was not acknowledged */
+        uint32_t nacks;
+        /** Responses read again because of a bad CRC or length, with RECEIVE_REREAD_ON_CRC_ERROR */
+        uint32_t rereads;
+        Latency  phases[PHASES];
+    };
+
+    HalStats () {
+        this->clear();
+    }
+
+    void clear () {
+        this->wake.clear();
+        this->wakeFailures = 0;
+        this->untracked    = 0;
+        for (auto &entry : this->entries) {
+            entry.opcode   = 0;
+            entry.commands = 0;
+            entry.retries  = 0;
+            entry.nacks    = 0;
+            entry.rereads  = 0;
+            for (auto &phase : entry.phases)
+                phase.clear();
+        }
+        this->current = NULL;
+        this->sentAt  = 0;
+    }
+
+    /**
+     * @return Entry for the opcode, claiming a free one if necessary, or NULL if the table is full
+     */
+    Entry *entry_for (const uint8_t opcode) {
+        for (auto &entry : this->entries)
+            if (entry.opcode == opcode || !entry.commands) {
+                entry.opcode = opcode;
+                return &entry;
+            }
+        return NULL;
+    }
+
+    /** Wake pulse to wake response, successful or not */
+    Latency  wake;
+    uint32_t wakeFailures;
+    /** Commands not recorded because every entry was taken by another opcode */
+    uint32_t untracked;
+    Entry    entries[MAX_OPCODES];
+
+    /** Maintained by the HAL: command between its send and its receive */
+    Entry    *current;
+    /** Maintained by the HAL: `CNT` at the end of the current command's send */
+    uint32_t sentAt;
+};
+
+/**
+ * @brief Propeller-specific HAL settings and state for one device
+ *
+ * Attach an instance to a device through `ATCAIfaceCfg::cfg_data`; the HAL treats a NULL `cfg_data` as "all
+ * defaults". The instance must outlive the library's use of the configuration.
+ */
+struct PropHalConfig {
+    /**
+     * The device's watchdog puts it to sleep 1.3 s (nominal) after a wake. Held sessions are re-armed with an
+     * idle/wake pair once they have been awake this long.
+     */
+    static const uint32_t WATCHDOG_REARM_MS        = 1000;
+    /** Nominal watchdog period: a device left awake this long has gone to sleep */
+    static const uint32_t WATCHDOG_MS              = 1300;
+    static const uint16_t DEFAULT_POLL_INTERVAL_US = 200;
+    static const uint8_t  DEFAULT_MAX_REREADS      = 3;
+
+    PropHalConfig ()
+            : holdAwake(false),
+              awake(false),
+              wokeAt(0),
+              volatileEpoch(0),
+              completion(COMPLETION_FIXED_DELAY),
+              pollIntervalUs(DEFAULT_POLL_INTERVAL_US),
+              completionReport(NULL),
+              transport(TRANSPORT_I2C_MASTER),
+              receive(RECEIVE_AS_READ),
+              maxRereads(DEFAULT_MAX_REREADS) {
+#ifdef PROPCRYPTO_HAL_STATS
+        this->stats = NULL;
+#endif
+    }
+
+    /**
+     * When set, the library's per-command wake and idle become no-ops while the device is known to be awake, so a
+     * batch of commands pays for a single wake. Cleared by the owner to end the session.
+     */
+    bool     holdAwake;
+    /** Maintained by the HAL: the device answered a wake and has not been idled or put to sleep since */
+    bool     awake;
+    /** Maintained by the HAL: `CNT` when the current wake pulse was issued */
+    uint32_t wokeAt;
+    /**
+     * Maintained by the HAL: advanced whenever the device may have lost TempKey and its other volatile state - a sleep
+     * command, a watchdog expiry within a held session, or a command the device did not acknowledge - and whenever a
+     * command other than Read, Write or Info is sent, from any cog, since it may replace TempKey
+     */
+    uint32_t volatileEpoch;
+
+    CompletionMode   completion;
+    /** Time between address polls with COMPLETION_ACK_POLLING */
+    uint16_t         pollIntervalUs;
+    /** Optional: filled in by the HAL with the latency saved by ACK polling */
+    CompletionReport *completionReport;
+
+    /** Choose before `atcab_init()`: initializing the interface is what launches the transport cog */
+    Transport transport;
+
+    ReceiveMode receive;
+    /** Re-reads of one response allowed with RECEIVE_REREAD_ON_CRC_ERROR, on top of the first read */
+    uint8_t     maxRereads;
+
+#ifdef PROPCRYPTO_HAL_STATS
+    /** Optional: filled in by the HAL with latency, retry and NACK counts */
+    HalStats *stats;
+#endif
+};
+
+/**
+ * @brief Find and identify the CryptoAuth devices on the selected buses
+ *
+ * Every bus is woken at once and the devices on all of them are identified with a single Info command round, so the
+ * time taken depends on neither the number of buses nor the number of devices. Only the listed addresses are probed,
+ * and only with reads until one returns a CryptoAuth wake token: nothing is ever written to another kind of device,
+ * such as the EEPROM that holds the Propeller's boot image. Devices must be asleep or idle beforehand, and are left
+ * idle.
+ *
+ * Takes the LibraryLock, and uses the transport cog if `base` selects it.
+ *
+ * @param[in]   busMask         Bit n set to scan bus n
+ * @param[in]   base            Baud, wake delay, retries and PropHalConfig to discover with. The returned
+ *                              configurations copy all but the PropHalConfig.
+ * @param[out]  cfg             One ready-to-use configuration per recognized ATSHA204A, ATECC108A, ATECC508A or
+ *                              ATECC608A
+ * @param[in]   maxDevices      Capacity of `cfg`
+ * @param[out]  found           Number of entries written to `cfg`
+ * @param[in]   addresses       8-bit addresses to probe on every bus, or NULL for 0xC0-0xCE, where CryptoAuth parts
+ *                              ship and are usually re-addressed to
+ * @param[in]   addressCount    Length of `addresses`
+ *
+ * @return ATCA_SUCCESS even if nothing was found, ATCA_BAD_PARAM for a bad argument
+ */
+ATCA_STATUS hal_prop_discover_devices (const uint32_t busMask, const ATCAIfaceCfg &base, ATCAIfaceCfg cfg[],
+                                       const int maxDevices, int *found, const uint8_t addresses[] = NULL,
+                                       const size_t addressCount = 0);
+
+class TraceRecorder;
+
+/**
+ * @brief Record every transaction on every bus from now on (see TraceRecorder), or stop with NULL
+ */
+void hal_prop_set_trace_recorder (TraceRecorder *const recorder);
+
+/**
+ * @brief Work for the calling cog while one of its commands executes
+ *
+ * Without other cogs to hand the LibraryLock to, the time a command spends executing is otherwise lost. A wait task
+ * may use it to send commands to other devices: their execution then overlaps the first one's, and the command that
+ * was waiting collects its response afterwards. The library's current device is restored when the task returns.
+ */
+class WaitTask {
+    public:
+        /**
+         * @brief Called from atca_delay_ms(), possibly again from within a command issued by an earlier call
+         *
+         * Must not touch the device whose command is executing, and should return well within its watchdog period.
+         *
+         * @param[in] delay     Worst-case execution time of the command, in milliseconds
+         */
+        virtual void run (const uint32_t delay) = 0;
+};
+
+/**
+ * @brief Run `task` at the start of every command's execution time, or stop with NULL
+ *
+ * Meant for a single cog: the task runs before the LibraryLock is yielded to other cogs.
+ */
+void hal_prop_set_wait_task (WaitTask *const task);
+
+/**
+ * @brief Make `device` the one that `atcab_*` calls talk to, without releasing the one it replaces
+ *
+ * atcab_init_device() releases, and therefore deletes, the library's current device before taking the new one: used
+ * to switch between devices, it frees each one it switches away from, and re-selecting the current device frees that.
+ * This only assigns the library's global. Devices stay owned by whoever created them with newATCADevice().
+ */
+void hal_prop_select_device (const ATCADevice device);
+
+/**
+ * @brief Hub lock that lets several cogs share cryptoauthlib
+ *
+ * The library keeps its current device in a single global. A cog holding the lock owns that global and the I2C
+ * buses. While a command executes, the HAL hands the lock to any cog waiting for it and, when it takes the lock back,
+ * restores the holder's device. Commands on different chips therefore overlap their execution time. A cog acquiring
+ * for the device that is executing waits until the yielded command's response has been collected: the chip has a
+ * single I/O buffer, which a second command would overwrite. Each chip must therefore have exactly one ATCADevice.
+ * Programs that use the library from a single cog never need to touch this.
+ *
+ * Waiting cogs are served in the order they asked: the hub lock only guards the dispenser of numbered tickets, and
+ * each cog then waits for its number to come up. No cog can be starved by others that keep re-acquiring, including
+ * ones that take the lock back after a yield, which join the end of the line. The holding cog may acquire again
+ * (with the same device or NULL); the lock is passed on when every acquire has been matched by a release.
+ *
+ * Hold it for one command at a time, as CryptoDevice does, so that other cogs wait for at most one command's bus
+ * traffic.
+ *
+ * @note Sharing a bus between cogs requires TRANSPORT_COG: PropWare::I2CMaster drives SCL from whichever cog last
+ *       used it, and the Propeller ORs the outputs of all cogs together.
+ */
+class LibraryLock {
+    public:
+        /**
+         * @brief How often cogs got in each other's way
+         *
+         * Maintained under the lock; read from another cog, the fields may be one acquisition apart.
+         */
+        struct Statistics {
+            /** Every first-level acquire, including the HAL's own while it polls a yielded command */
+            uint32_t acquisitions;
+            /** Acquisitions that found another cog holding the lock or already waiting for it */
+            uint32_t contentions;
+            uint32_t totalWaitMicros;
+            uint32_t maxWaitMicros;
+        };
+
+    public:
+        /**
+         * @brief Hold the lock for the lifetime of the object
+         */
+        class Scope {
+            public:
+                explicit Scope (const ATCADevice device) {
+                    LibraryLock::acquire(device);
+                }
+
+                ~Scope () {
+                    LibraryLock::release();
+                }
+        };
+
+    public:
+        /**
+         * @brief Allocate the hub lock. Call from one cog before any other cog uses the library; later calls are
+         *        harmless.
+         *
+         * @return False if all eight hub locks are taken
+         */
+        static bool start ();
+
+        /**
+         * @brief Block until the lock is free and `device` is not executing another cog's command, then make it the
+         *        library's current device (unless NULL)
+         */
+        static void acquire (const ATCADevice device);
+
+        static void release ();
+
+        /**
+         * @brief Used by the HAL: give up the lock while the device is busy, if the calling cog holds it
+         *
+         * Until resume(), other cogs may only acquire the lock for other devices (or NULL).
+         *
+         * @return Device to pass back to resume(), or NULL if the calling cog does not hold the lock
+         */
+        static ATCADevice yield ();
+
+        static void resume (const ATCADevice device);
+
+        /**
+         * @return True if the calling cog gave up the lock with yield() and must take it for any bus access
+         */
+        static bool yielded ();
+
+        static Statistics statistics ();
+
+        static void clear_statistics ();
+};
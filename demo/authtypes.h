@@ -23,32 +23,6 @@
 
 #include <cstdint>
 
-/**
- * @brief Combine slot configuration values into a two-byte slot configuration
- *
- * @param[in] writeConfig
- * @param[in] writeKey
- * @param[in] isSecret          Instance of IsSecret
- * @param[in] encryptRead       Instance of IsEncrypted
- * @param[in] limitedUse        Instance of SlotMultiUseLimitation
- * @param[in] noMac             Instance of SlotMacAllowed
- * @param[in] readKey           Either a slot ID for the key to be used for encrypting reads of this slot or
- *                              combination of `(EcdhOutputTarget | EcdhPermission | MessageSignatureEnable |
- *                              ExternalSignatureEnable)`
- */
-#define SLOT_CONFIGURATION(writeConfig, writeKey, isSecret, encryptRead, limitedUse, noMac, readKey) ( \
-    /* High order byte */ \
-    (((writeConfig) & 0x0f) << 12) | \
-    (((writeKey) & 0x0f) << 4) | \
-    \
-    /* Low order byte */ \
-    isSecret | \
-    encryptRead | \
-    limitedUse | \
-    noMac | \
-    (readKey & 0x0f) \
-)
-
 typedef enum {
     SLOT_IS_PUBLIC,
     SLOT_IS_SECRET = 0x80
@@ -89,40 +63,160 @@ typedef enum {
     ENABLE_EXT_SIGNATURES = 0x01
 } ExternalSignatureEnable;
 
+/**
+ * KeyConfig bits 2-4
+ */
+typedef enum {
+    KEY_TYPE_P256 = 4,
+    KEY_TYPE_AES  = 6,
+    /** SHA key or other data */
+    KEY_TYPE_DATA = 7
+} KeyType;
+
+/**
+ * @brief Two-byte SlotConfig word for one data slot
+ *
+ * The encoding follows the ATECC508A datasheet (section 2.2.1) and does not depend on how the compiler lays out
+ * bitfields: bits 0-3 ReadKey, 4 NoMac, 5 LimitedUse, 6 EncryptRead, 7 IsSecret, 8-11 WriteKey, 12-15 WriteConfig.
+ * Every member is constexpr, so a SlotConfig used as a constant costs nothing at runtime.
+ */
 class SlotConfig {
     public:
-        static const SlotConfig PUBLIC_KEY;
+        /**
+         * @brief Slot holding an ECC private key whose public key can be regenerated with GenKey
+         */
+        static constexpr SlotConfig public_key () {
+            return SlotConfig(1, false, false, false, true, 0, 0b0010);
+        }
 
     public:
-        SlotConfig (unsigned int readKeyId,
-                    bool disableMacCommand,
-                    bool limitedUse,
-                    bool encryptedRead,
-                    bool isSecret,
-                    unsigned int writeKeyId,
-                    unsigned int writeConfig)
-                : readKeyId(readKeyId),
-                  disableMacCommand(disableMacCommand),
-                  limitedUse(limitedUse),
-                  encryptedRead(encryptedRead),
-                  isSecret(isSecret),
-                  writeKeyId(writeKeyId),
-                  writeConfig(writeConfig) {
-        }
-
-        uint16_t raw () const {
-            return *(uint16_t *) this;
-        }
-
-        // @formatter:off
-        unsigned int    readKeyId:          4;
-        bool            disableMacCommand:  1;
-        bool            limitedUse:         1;
-        bool            encryptedRead:      1;
-        bool            isSecret:           1;
-        unsigned int    writeKeyId:         4;
-        unsigned int    writeConfig:        4;
-        // @formatter:on
+        /**
+         * @param[in] readKeyId         Either a slot ID for the key to be used for encrypting reads of this slot or
+         *                              combination of `(EcdhOutputTarget | EcdhPermission | MessageSignatureEnable |
+         *                              ExternalSignatureEnable)`
+         */
+        constexpr SlotConfig (unsigned int readKeyId,
+                              bool disableMacCommand,
+                              bool limitedUse,
+                              bool encryptedRead,
+                              bool isSecret,
+                              unsigned int writeKeyId,
+                              unsigned int writeConfig)
+                : m_raw(static_cast<uint16_t>((readKeyId & 0x0f)
+                                              | (disableMacCommand ? VERFICATION_ONLY : 0)
+                                              | (limitedUse ? SLOT_USE_LIMITED : 0)
+                                              | (encryptedRead ? SLOT_IS_ENCRYPTED : 0)
+                                              | (isSecret ? SLOT_IS_SECRET : 0)
+                                              | ((writeKeyId & 0x0f) << 8)
+                                              | ((writeConfig & 0x0f) << 12))) {
+        }
+
+        /**
+         * @param[in] raw   SlotConfig word as read from the configuration zone
+         */
+        constexpr explicit SlotConfig (const uint16_t raw = 0)
+                : m_raw(raw) {
+        }
+
+        constexpr uint16_t raw () const {
+            return this->m_raw;
+        }
+
+        constexpr unsigned int read_key () const {
+            return this->m_raw & 0x0f;
+        }
+
+        constexpr bool disable_mac_command () const {
+            return this->m_raw & VERFICATION_ONLY;
+        }
+
+        constexpr bool limited_use () const {
+            return this->m_raw & SLOT_USE_LIMITED;
+        }
+
+        constexpr bool encrypted_read () const {
+            return this->m_raw & SLOT_IS_ENCRYPTED;
+        }
+
+        constexpr bool is_secret () const {
+            return this->m_raw & SLOT_IS_SECRET;
+        }
+
+        constexpr unsigned int write_key () const {
+            return (this->m_raw >> 8) & 0x0f;
+        }
+
+        constexpr unsigned int write_config () const {
+            return this->m_raw >> 12;
+        }
+
+    protected:
+        uint16_t m_raw;
 };
 
-const SlotConfig SlotConfig::PUBLIC_KEY(1, false, false, false, true, 0, 0b0010);
+/**
+ * @brief Two-byte KeyConfig word for one data slot
+ *
+ * Encoded per the ATECC508A datasheet (section 2.2.5): bit 0 Private, 1 PubInfo, 2-4 KeyType, 5 Lockable, 6 ReqRandom,
+ * 7 ReqAuth, 8-11 AuthKey, 12 IntrusionDisable, 14-15 X509id.
+ */
+class KeyConfig {
+    public:
+        constexpr KeyConfig (bool isPrivate,
+                             bool pubInfo,
+                             KeyType keyType,
+                             bool lockable,
+                             bool requireRandom = false,
+                             bool requireAuth = false,
+                             unsigned int authKeyId = 0,
+                             bool intrusionDisable = false,
+                             unsigned int x509Id = 0)
+                : m_raw(static_cast<uint16_t>((isPrivate ? 0x0001 : 0)
+                                              | (pubInfo ? 0x0002 : 0)
+                                              | ((keyType & 0x07) << 2)
+                                              | (lockable ? 0x0020 : 0)
+                                              | (requireRandom ? 0x0040 : 0)
+                                              | (requireAuth ? 0x0080 : 0)
+                                              | ((authKeyId & 0x0f) << 8)
+                                              | (intrusionDisable ? 0x1000 : 0)
+                                              | ((x509Id & 0x03) << 14))) {
+        }
+
+        /**
+         * @param[in] raw   KeyConfig word as read from the configuration zone
+         */
+        constexpr explicit KeyConfig (const uint16_t raw = 0)
+                : m_raw(raw) {
+        }
+
+        constexpr uint16_t raw () const {
+            return this->m_raw;
+        }
+
+        constexpr bool is_private () const {
+            return this->m_raw & 0x0001;
+        }
+
+        constexpr bool pub_info () const {
+            return this->m_raw & 0x0002;
+        }
+
+        constexpr unsigned int key_type () const {
+            return (this->m_raw >> 2) & 0x07;
+        }
+
+        constexpr bool lockable () const {
+            return this->m_raw & 0x0020;
+        }
+
+        constexpr bool require_auth () const {
+            return this->m_raw & 0x0080;
+        }
+
+        constexpr unsigned int auth_key () const {
+            return (this->m_raw >> 8) & 0x0f;
+        }
+
+    protected:
+        uint16_t m_raw;
+};
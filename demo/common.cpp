@@ -21,37 +21,93 @@
 
 #include "common.h"
 
-#include <PropWare/utility/utility.h>
 #include <PropWare/hmi/output/printer.h>
 #include <atca_basic.h>
 
-using PropWare::Utility;
-
 const Printer::Format HEX_FMT(2, '0', 16);
 
+static const char   HEX_DIGITS[]   = "0123456789ABCDEF";
+static const size_t BYTES_PER_LINE = 16;
+
+static char *append_hex (char *cursor, const uint8_t byte) {
+    *cursor++ = HEX_DIGITS[byte >> 4];
+    *cursor++ = HEX_DIGITS[byte & 0x0F];
+    return cursor;
+}
+
 void print_block (const Printer &printer, const uint8_t *const data, const size_t length) {
-    char buffer[256];
-    auto bufferSize = Utility::size_of_array(buffer);
-    atcab_bin2hex(data, length, buffer, &bufferSize);
-    printer << buffer;
+    // Each byte takes three characters: two digits and the separator or line break that follows it
+    char line[3 * BYTES_PER_LINE + 1];
+    for (size_t start = 0; start < length; start += BYTES_PER_LINE) {
+        const size_t end    = length - start < BYTES_PER_LINE ? length : start + BYTES_PER_LINE;
+        char         *cursor = line;
+        if (start)
+            *cursor++ = '\n';
+        for (size_t i = start; i < end; ++i) {
+            if (i != start)
+                *cursor++ = ' ';
+            cursor = append_hex(cursor, data[i]);
+        }
+        *cursor = '\0';
+        printer.puts(line);
+    }
+}
+
+void print_hexdump (const Printer &printer, const uint8_t *const data, const size_t length, const size_t address) {
+    printer.puts("         0  1  2  3  4  5  6  7    8  9  A  B  C  D  E  F\n");
+
+    // "0x0000: " + sixteen bytes with a "- " in the middle + sixteen characters + line break
+    char line[8 + 3 * BYTES_PER_LINE + 2 + BYTES_PER_LINE + 2];
+    for (size_t start = 0; start < length; start += BYTES_PER_LINE) {
+        const size_t offset = address + start;
+        char         *cursor = line;
+        *cursor++ = '0';
+        *cursor++ = 'x';
+        cursor = append_hex(cursor, static_cast<uint8_t>(offset >> 8));
+        cursor = append_hex(cursor, static_cast<uint8_t>(offset));
+        *cursor++ = ':';
+
+        for (size_t i = 0; i < BYTES_PER_LINE; ++i) {
+            *cursor++ = ' ';
+            if (BYTES_PER_LINE / 2 == i) {
+                *cursor++ = '-';
+                *cursor++ = ' ';
+            }
+            if (start + i < length) {
+                cursor = append_hex(cursor, data[start + i]);
+            } else {
+                *cursor++ = ' ';
+                *cursor++ = ' ';
+            }
+        }
+
+        *cursor++ = ' ';
+        for (size_t i = 0; i < BYTES_PER_LINE && start + i < length; ++i) {
+            const uint8_t byte = data[start + i];
+            *cursor++ = (' ' <= byte && byte <= '~') ? static_cast<char>(byte) : '.';
+        }
+        *cursor++ = '\n';
+        *cursor   = '\0';
+        printer.puts(line);
+    }
 }
 
 Printer &operator<< (Printer &printer, const ATCADeviceType deviceType) {
     switch (deviceType) {
         case ATSHA204A:
-            pwOut << "ATSHA204A";
+            printer << "ATSHA204A";
             break;
         case ATECC108A:
-            pwOut << "ATECC108A";
+            printer << "ATECC108A";
             break;
         case ATECC508A:
-            pwOut << "ATECC508A";
+            printer << "ATECC508A";
             break;
         case ATECC608A:
-            pwOut << "ATECC608A";
+            printer << "ATECC608A";
             break;
         default:
-            pwOut << "UNKNOWN";
+            printer << "UNKNOWN";
     }
     return printer;
 }
@@ -70,3 +126,50 @@ Printer &operator<< (Printer &printer, const ATCAIfaceCfg &cfg) {
 
     return printer;
 }
+
+static void print_latency (const Printer &printer, const char *name, const HalStats::Latency &latency) {
+    printer << "    " << name << " min_us=" << (latency.count ? latency.minMicros : 0)
+            << " avg_us=" << latency.average()
+            << " max_us=" << latency.maxMicros
+            << " histogram=";
+    for (size_t bin = 0; bin < HalStats::HISTOGRAM_BINS; ++bin)
+        printer << (bin ? "/" : "") << latency.histogram[bin];
+    printer << '\n';
+}
+
+Printer &operator<< (Printer &printer, const HalStats &stats) {
+    printer << "HalStats (histogram bins end at";
+    for (size_t bin = 0; bin < HalStats::HISTOGRAM_BINS - 1; ++bin)
+        printer << ' ' << HalStats::Latency::histogram_limit(bin);
+    printer << " us)\n"
+            << "  wakes=" << stats.wake.count << " wake_failures=" << stats.wakeFailures
+            << " untracked_commands=" << stats.untracked << '\n';
+    print_latency(printer, "wake", stats.wake);
+    for (const auto &entry : stats.entries) {
+        if (entry.commands) {
+            printer << "  opcode=0x" << HEX_FMT << entry.opcode << Printer::DEFAULT_FORMAT
+                    << " commands=" << entry.commands
+                    << " retries=" << entry.retries
+                    << " nacks=" << entry.nacks
+                    << " rereads=" << entry.rereads << '\n';
+            print_latency(printer, "send", entry.phases[HalStats::PHASE_SEND]);
+            print_latency(printer, "execute", entry.phases[HalStats::PHASE_EXECUTE]);
+            print_latency(printer, "receive", entry.phases[HalStats::PHASE_RECEIVE]);
+        }
+    }
+    return printer;
+}
+
+Printer &operator<< (Printer &printer, const CompletionReport &report) {
+    printer << "CompletionReport\n";
+    for (const auto &entry : report.entries) {
+        if (entry.commands) {
+            printer << "  opcode=0x" << HEX_FMT << entry.opcode << Printer::DEFAULT_FORMAT
+                    << " commands=" << entry.commands
+                    << " fallbacks=" << entry.fallbacks
+                    << " saved_us=" << entry.savedMicros
+                    << " avg_saved_us=" << entry.savedMicros / entry.commands << '\n';
+        }
+    }
+    return printer;
+}
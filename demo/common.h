@@ -21,20 +21,34 @@
 
 #pragma once
 
+#include "atca_hal_prop.h"
+
 #include <PropWare/hmi/output/printer.h>
 
 #include <atca_basic.h>
 
 using PropWare::Printer;
 
-#define SPLIT(x) static_cast<uint8_t>(x), static_cast<uint8_t>(x >> 8)
-
-#define SWAP(x) static_cast<uint16_t>((x << 8) | (x & 0xff))
-
 extern const Printer::Format HEX_FMT;
 
+/**
+ * @brief Print `data` as space-separated hex bytes, sixteen to a line
+ *
+ * Encodes one line at a time into a small buffer, so any length takes the same stack.
+ */
 void print_block (const Printer &printer, const uint8_t *const data, const size_t length);
 
+/**
+ * @brief Print `data` in the offset/hex/ASCII layout of PropWare::BlockStorage::print_block(), with constant stack
+ *
+ * @param[in]   address     Offset printed for the first byte
+ */
+void print_hexdump (const Printer &printer, const uint8_t *const data, const size_t length, const size_t address = 0);
+
 Printer &operator<< (Printer &printer, const ATCADeviceType deviceType);
 
 Printer &operator<< (Printer &printer, const ATCAIfaceCfg &cfg);
+
+Printer &operator<< (Printer &printer, const HalStats &stats);
+
+Printer &operator<< (Printer &printer, const CompletionReport &report);
@@ -0,0 +1,603 @@
+/**
+ * @file    cryptoauth_bench.cpp
+ *
+ * @author  David Zemon
+ *
+ * @copyright
+ * The MIT License (MIT)<br>
+ * <br>Copyright (c) 2019 David Zemon<br>
+ * <br>Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:<br>
+ * <br>The above copyright notice and this permission notice shall be included in all copies or substantial portions
+ * of the Software.<br>
+ * <br>THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Host-side throughput benchmark for the Propeller HAL. atca_hal_prop.cpp is compiled unmodified against the
+ * simulator's PropWare stand-ins and talks to an in-process ATECC508A model, so all latencies below are in simulated
+ * time: what the real Propeller + chip would see, independent of the speed of the machine running the benchmark.
+ */
+
+#include "atca_hal_prop.h"
+#include "ConfigImage.h"
+#include "MerkleBatch.h"
+#include "Provisioner.h"
+#include "Sha256Stream.h"
+#include "VerifyCache.h"
+
+#include <Atecc508a.h>
+#include <simulator.h>
+#include <PropWare/gpio/pin.h>
+
+#include <atca_basic.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+using PropWare::Pin;
+
+static const unsigned int DEFAULT_ITERATIONS = 200;
+static const uint16_t     SIGNING_SLOT       = 0;
+static const uint16_t     GENKEY_SLOT        = 2;
+/**
+ * Software SHA-256 costs nothing in simulated time, so its column uses this per-block estimate for CMM code at 80 MHz
+ * instead of a measurement. Everything derived from it is printed as an estimate; on the board,
+ * Sha256Stream::measure_software_block_micros() gives the real figure.
+ */
+static const uint32_t     SOFTWARE_SHA_BLOCK_MICROS = 4000;
+
+/**
+ * Slot layout of the demo: private keys in slots 0-2, data in the rest
+ */
+struct LineConfig {
+    static constexpr ConfigLayout layout () {
+        // @formatter:off
+        return ConfigLayout{
+            0xC0, 0x55, 0x00,
+            {
+                SlotConfig::public_key(), SlotConfig(0x2087), SlotConfig(0x208F), SlotConfig(0x8FC4),
+                SlotConfig(0x8F8F),     SlotConfig(0x8F8F), SlotConfig(0x8F9F), SlotConfig(0x8FAF),
+                SlotConfig(),           SlotConfig(),       SlotConfig(),       SlotConfig(),
+                SlotConfig(),           SlotConfig(),       SlotConfig(),       SlotConfig(0x8FAF)
+            },
+            {
+                KeyConfig(true, true, KEY_TYPE_P256, true),    KeyConfig(true, true, KEY_TYPE_P256, true),
+                KeyConfig(true, true, KEY_TYPE_P256, true),    KeyConfig(false, false, KEY_TYPE_DATA, false),
+                KeyConfig(false, false, KEY_TYPE_DATA, false), KeyConfig(false, false, KEY_TYPE_DATA, false),
+                KeyConfig(false, false, KEY_TYPE_DATA, false), KeyConfig(false, false, KEY_TYPE_DATA, false),
+                KeyConfig(false, false, KEY_TYPE_DATA, true),  KeyConfig(false, false, KEY_TYPE_DATA, true),
+                KeyConfig(false, false, KEY_TYPE_DATA, true),  KeyConfig(false, false, KEY_TYPE_DATA, true),
+                KeyConfig(false, false, KEY_TYPE_DATA, true),  KeyConfig(false, false, KEY_TYPE_DATA, true),
+                KeyConfig(false, false, KEY_TYPE_DATA, true),  KeyConfig(false, false, KEY_TYPE_DATA, false)
+            }
+        };
+        // @formatter:on
+    }
+};
+
+static const size_t LINE_UNITS = 4;
+
+/** Rows that reported an error. Any makes the exit status non-zero. */
+static unsigned int g_failedRows = 0;
+
+static void usage (const char *name) {
+    printf("Usage: %s [-n iterations] [-b baud] [-w wake_delay_us] [-r rx_retries] [-p poll_interval_us] "
+           "[--worst-case]\n", name);
+}
+
+static uint64_t percentile (const std::vector<uint64_t> &sorted, const unsigned int percent) {
+    return sorted[(sorted.size() - 1) * percent / 100];
+}
+
+static void run (const char *name, const unsigned int iterations, const std::function<ATCA_STATUS ()> &operation) {
+    std::vector<uint64_t> latencies;
+    unsigned int          failures     = 0;
+    const uint64_t        bytesAtStart = sim::I2CBus::on(Pin::Mask::P28).bytes_transferred();
+
+    latencies.reserve(iterations);
+    for (unsigned int i = 0; i < iterations; ++i) {
+        const uint64_t start = sim::Clock::now();
+        if (ATCA_SUCCESS != operation())
+            ++failures;
+        latencies.push_back(sim::Clock::micros(sim::Clock::now() - start));
+    }
+
+    const uint64_t bytes = sim::I2CBus::on(Pin::Mask::P28).bytes_transferred() - bytesAtStart;
+    uint64_t       total = 0;
+    for (const auto latency : latencies)
+        total += latency;
+    std::sort(latencies.begin(), latencies.end());
+
+    printf("%-28s %10.1f %10llu %10llu %10llu %8u\n", name, total ? iterations * 1e6 / total : 0.0,
+           (unsigned long long) percentile(latencies, 50), (unsigned long long) percentile(latencies, 99),
+           (unsigned long long) (bytes / iterations), failures);
+    if (failures)
+        ++g_failedRows;
+}
+
+/**
+ * @brief Sign `messages` messages in batches of up to BATCH_SIZE and check every proof
+ *
+ * Only the device's time is simulated: the software SHA-256 that builds the trees costs nothing here. On the
+ * Propeller, add roughly two compressions per message for the tree to the time per message.
+ */
+template<size_t BATCH_SIZE>
+static void run_batches (const char *name, const unsigned int messages, const uint8_t publicKey[ATCA_PUB_KEY_SIZE]) {
+    typedef typename MerkleBatch<BATCH_SIZE>::Proof Proof;
+
+    MerkleBatch<BATCH_SIZE>            batch;
+    Proof                              proof;
+    std::vector<Proof>                 proofs;
+    std::vector<std::vector<uint8_t> > signatures;
+    unsigned int                       failures   = 0;
+    unsigned int                       proofBytes = 0;
+    uint8_t                            message[32];
+
+    const auto message_for = [&message] (const unsigned int i) {
+        memset(message, 0, sizeof(message));
+        memcpy(message, &i, sizeof(i));
+    };
+    const auto sign = [&] () {
+        if (!batch.seal() || ATCA_SUCCESS != atcab_sign(SIGNING_SLOT, batch.digest(), batch.signature()))
+            ++failures;
+        for (uint16_t i = 0; i < batch.size(); ++i) {
+            batch.proof(i, &proof);
+            proofs.push_back(proof);
+            signatures.push_back(std::vector<uint8_t>(batch.signature(), batch.signature() + ATCA_SIG_SIZE));
+            proofBytes += 4 + proof.count * MerkleTree::DIGEST_SIZE;
+        }
+        batch.reset();
+    };
+
+    const uint64_t start = sim::Clock::now();
+    for (unsigned int i = 0; i < messages; ++i) {
+        message_for(i);
+        batch.add(message, sizeof(message));
+        if (batch.full())
+            sign();
+    }
+    if (batch.size())
+        sign();
+    const uint64_t micros = sim::Clock::micros(sim::Clock::now() - start);
+
+    // Verification is per message whichever way it was signed, so it is checked but not timed
+    for (unsigned int i = 0; i < messages; ++i) {
+        bool verified = false;
+        message_for(i);
+        if (ATCA_SUCCESS != proofs[i].verify(message, sizeof(message), signatures[i].data(), publicKey, &verified)
+            || !verified)
+            ++failures;
+    }
+    // A proof must not verify any other message
+    message_for(messages);
+    bool verified = true;
+    if (ATCA_SUCCESS != proofs[0].verify(message, sizeof(message), signatures[0].data(), publicKey, &verified)
+        || verified)
+        ++failures;
+
+    printf("%-28s %10.1f %10llu %10u %8u\n", name, micros ? messages * 1e6 / micros : 0.0,
+           (unsigned long long) (micros / messages), proofBytes / messages, failures);
+    if (failures)
+        ++g_failedRows;
+}
+
+/**
+ * @brief Verify `count` signatures in turn, `iterations` times in all, through a cache of ENTRIES results
+ *
+ * Every lookup is charged the software SHA-256 of its key at SOFTWARE_SHA_BLOCK_MICROS per block.
+ */
+template<size_t ENTRIES>
+static void run_verify_cache (const char *name, const unsigned int iterations,
+                              const uint8_t digests[][ATCA_SHA_DIGEST_SIZE], const uint8_t signatures[][ATCA_SIG_SIZE],
+                              const size_t count, const uint8_t publicKey[ATCA_PUB_KEY_SIZE]) {
+    static const size_t KEY_BLOCKS = (ATCA_PUB_KEY_SIZE + ATCA_SHA_DIGEST_SIZE + ATCA_SIG_SIZE + 9
+                                      + Sha256Stream::BLOCK_SIZE - 1) / Sha256Stream::BLOCK_SIZE;
+
+    VerifyCache<ENTRIES> cache;
+    size_t               next = 0;
+    run(name, iterations, [&] () {
+        const size_t i        = next++ % count;
+        bool         verified = false;
+        sim::Clock::advance(sim::Clock::ticks_from_micros(KEY_BLOCKS * SOFTWARE_SHA_BLOCK_MICROS));
+        const auto result = static_cast<ATCA_STATUS>(cache.verify_extern(digests[i], signatures[i], publicKey,
+                                                                         &verified, SIGNING_SLOT));
+        return (ATCA_SUCCESS == result && !verified) ? ATCA_CHECKMAC_VERIFY_FAILED : result;
+    });
+    printf("%-28s %lu hits, %lu misses, %lu evictions, %lu us estimated per lookup\n", "",
+           (unsigned long) cache.stats().hits, (unsigned long) cache.stats().misses,
+           (unsigned long) cache.stats().evictions, (unsigned long) (KEY_BLOCKS * SOFTWARE_SHA_BLOCK_MICROS));
+}
+
+/**
+ * @brief Provision one batch of blank parts and report the line rate
+ *
+ * @param[in] units     Bus and address of each part
+ */
+static void run_provisioning (const char *name, const ATCAIfaceCfg &base, const uint8_t units[LINE_UNITS][2],
+                              const unsigned int maxNesting) {
+    static const ProvisioningProfile profile = {ConfigImage<LineConfig>::DATA, true, (1 << 1) | (1 << 2), true};
+
+    Provisioner<LINE_UNITS> provisioner(profile);
+    provisioner.set_max_nesting(maxNesting);
+    for (size_t i = 0; i < LINE_UNITS; ++i) {
+        ATCAIfaceCfg cfg          = base;
+        cfg.atcai2c.bus           = units[i][0];
+        cfg.atcai2c.slave_address = units[i][1];
+        provisioner.add(cfg);
+    }
+
+    const uint64_t start  = sim::Clock::now();
+    const size_t   done   = provisioner.provision();
+    const uint64_t micros = sim::Clock::micros(sim::Clock::now() - start);
+
+    unsigned int retries = 0;
+    unsigned int written = 0;
+    for (size_t i = 0; i < provisioner.size(); ++i) {
+        retries += provisioner.result(i).retries;
+        written += provisioner.result(i).configBytesWritten;
+    }
+    printf("%-28s %10.1f %10llu %10u %8u %8u\n", name, micros ? done * 3600e6 / micros : 0.0,
+           (unsigned long long) micros, written / LINE_UNITS, retries, (unsigned int) (LINE_UNITS - done));
+    if (LINE_UNITS != done)
+        ++g_failedRows;
+    for (size_t i = 0; i < provisioner.size(); ++i) {
+        const auto &result = provisioner.result(i);
+        printf("  bus %u, address 0x%02X: step %d, status 0x%02X, %u keys, %lu us, key[0] %02X%02X%02X%02X...\n",
+               result.bus, result.address, result.step, result.status, result.keyCount, (unsigned long) result.micros,
+               result.publicKeys[0][0], result.publicKeys[0][1], result.publicKeys[0][2], result.publicKeys[0][3]);
+    }
+}
+
+int main (int argc, char *argv[]) {
+    unsigned int iterations = DEFAULT_ITERATIONS;
+    bool         worstCase  = false;
+
+    PropHalConfig    halConfig;
+    CompletionReport completionReport;
+#ifdef PROPCRYPTO_HAL_STATS
+    HalStats         halStats;
+#endif
+
+    ATCAIfaceCfg cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.iface_type            = ATCA_I2C_IFACE;
+    cfg.devtype               = ATECC508A;
+    cfg.atcai2c.slave_address = sim::Atecc508a::DEFAULT_ADDRESS;
+    cfg.atcai2c.bus           = 0;
+    cfg.atcai2c.baud          = 1000000;
+    cfg.wake_delay            = 800;
+    cfg.rx_retries            = 3;
+    cfg.cfg_data              = &halConfig;
+
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp("--worst-case", argv[i])) {
+            worstCase = true;
+        } else if (i + 1 < argc && !strcmp("-n", argv[i])) {
+            iterations = static_cast<unsigned int>(strtoul(argv[++i], NULL, 0));
+        } else if (i + 1 < argc && !strcmp("-b", argv[i])) {
+            cfg.atcai2c.baud = static_cast<uint32_t>(strtoul(argv[++i], NULL, 0));
+        } else if (i + 1 < argc && !strcmp("-w", argv[i])) {
+            cfg.wake_delay = static_cast<uint16_t>(strtoul(argv[++i], NULL, 0));
+        } else if (i + 1 < argc && !strcmp("-p", argv[i])) {
+            halConfig.pollIntervalUs = static_cast<uint16_t>(strtoul(argv[++i], NULL, 0));
+        } else if (i + 1 < argc && !strcmp("-r", argv[i])) {
+            cfg.rx_retries = static_cast<int>(strtol(argv[++i], NULL, 0));
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (!iterations) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    sim::Atecc508a device;
+    device.provision();
+    device.use_worst_case_timing(worstCase);
+    sim::I2CBus::on(Pin::Mask::P28).attach(device);
+
+    // Two more parts on the second bus, only for discovery
+    sim::Atecc508a secondBusDevices[] = {sim::Atecc508a(0xC0), sim::Atecc508a(0xC4)};
+    for (auto &secondBusDevice : secondBusDevices)
+        sim::I2CBus::on(Pin::Mask::P1).attach(secondBusDevice);
+
+    // Blank parts for the provisioning runs, two per bus for each run
+    const uint8_t sequentialUnits[LINE_UNITS][2] = {{0, 0xC2}, {0, 0xC4}, {1, 0xC2}, {1, 0xC6}};
+    const uint8_t pipelinedUnits[LINE_UNITS][2]  = {{0, 0xC6}, {0, 0xC8}, {1, 0xC8}, {1, 0xCA}};
+    std::vector<sim::Atecc508a> blankDevices;
+    blankDevices.reserve(2 * LINE_UNITS);
+    for (const auto *units : {sequentialUnits, pipelinedUnits}) {
+        for (size_t i = 0; i < LINE_UNITS; ++i) {
+            uint8_t serial[ATCA_SERIAL_NUM_SIZE] = {0x01, 0x23, 0, 0, 0, 0, 0, 0, 0xEE};
+            serial[4] = static_cast<uint8_t>(blankDevices.size());
+            blankDevices.push_back(sim::Atecc508a(units[i][1], serial));
+        }
+    }
+    for (size_t i = 0; i < blankDevices.size(); ++i)
+        sim::I2CBus::on((i % LINE_UNITS) < 2 ? Pin::Mask::P28 : Pin::Mask::P1).attach(blankDevices[i]);
+
+    ATCAIfaceCfg   discovered[4];
+    int            found;
+    const uint64_t discoveryStart = sim::Clock::now();
+    hal_prop_discover_devices(0x3, cfg, discovered, 4, &found);
+    printf("Discovered %d devices on both buses in %llu us:\n", found,
+           (unsigned long long) sim::Clock::micros(sim::Clock::now() - discoveryStart));
+    for (int i = 0; i < found; ++i)
+        printf("  bus %u, address 0x%02X, device type %d\n", discovered[i].atcai2c.bus,
+               discovered[i].atcai2c.slave_address, discovered[i].devtype);
+    printf("\n");
+
+    ATCA_STATUS status = atcab_init(&cfg);
+    uint8_t     publicKey[ATCA_PUB_KEY_SIZE];
+    if (ATCA_SUCCESS == status)
+        status = atcab_genkey(SIGNING_SLOT, publicKey);
+    if (ATCA_SUCCESS != status) {
+        printf("Failed to set up the simulated device: 0x%02X\n", status);
+        return 1;
+    }
+
+    uint8_t message[ATCA_SHA_DIGEST_SIZE];
+    uint8_t signature[ATCA_SIG_SIZE];
+    uint8_t buffer[ATCA_ECC_CONFIG_SIZE];
+    uint8_t payload[256];
+    for (size_t i = 0; i < sizeof(payload); ++i)
+        payload[i] = static_cast<uint8_t>(i);
+    memset(message, 0xA5, sizeof(message));
+    atcab_sign(SIGNING_SLOT, message, signature);
+
+    printf("%u iterations, %lu Hz, wake delay %u us, %s execution times\n\n", iterations,
+           (unsigned long) cfg.atcai2c.baud, cfg.wake_delay, worstCase ? "worst-case" : "typical");
+
+    const auto header = [] (const char *title) {
+        printf("%s:\n%-28s %10s %10s %10s %10s %8s\n", title, "operation", "ops/sec", "p50 (us)", "p99 (us)",
+               "bytes/op", "errors");
+    };
+    const auto suite  = [&] () {
+        run("atcab_info", iterations, [&] () {
+            return atcab_info(buffer);
+        });
+        run("atcab_read_serial_number", iterations, [&] () {
+            return atcab_read_serial_number(buffer);
+        });
+        run("atcab_read_config_zone", iterations, [&] () {
+            return atcab_read_config_zone(buffer);
+        });
+        run("atcab_random", iterations, [&] () {
+            return atcab_random(buffer);
+        });
+        run("atcab_sha (256 bytes)", iterations, [&] () {
+            return atcab_sha(sizeof(payload), payload, buffer);
+        });
+        run("atcab_genkey", iterations, [&] () {
+            return atcab_genkey(GENKEY_SLOT, buffer);
+        });
+        run("atcab_get_pubkey", iterations, [&] () {
+            return atcab_get_pubkey(SIGNING_SLOT, buffer);
+        });
+        run("atcab_sign", iterations, [&] () {
+            return atcab_sign(SIGNING_SLOT, message, buffer);
+        });
+        run("atcab_verify_extern", iterations, [&] () {
+            bool             verified = false;
+            const ATCA_STATUS result  = atcab_verify_extern(message, signature, publicKey, &verified);
+            return (ATCA_SUCCESS == result && !verified) ? ATCA_CHECKMAC_VERIFY_FAILED : result;
+        });
+        run("atcab_wakeup + atcab_idle", iterations, [&] () {
+            const ATCA_STATUS result = atcab_wakeup();
+            return ATCA_SUCCESS == result ? atcab_idle() : result;
+        });
+        run("atcab_wakeup + atcab_sleep", iterations, [&] () {
+            const ATCA_STATUS result = atcab_wakeup();
+            return ATCA_SUCCESS == result ? atcab_sleep() : result;
+        });
+    };
+
+    header("Fixed execution delays");
+    suite();
+
+    printf("\n");
+    header("ACK polling");
+    halConfig.completion       = COMPLETION_ACK_POLLING;
+    halConfig.completionReport = &completionReport;
+#ifdef PROPCRYPTO_HAL_STATS
+    halConfig.stats            = &halStats;
+#endif
+    suite();
+    printf("\n%-8s %10s %10s %14s\n", "opcode", "commands", "fallbacks", "avg saved (us)");
+    for (const auto &entry : completionReport.entries)
+        if (entry.commands)
+            printf("0x%02X     %10lu %10lu %14lu\n", entry.opcode, (unsigned long) entry.commands,
+                   (unsigned long) entry.fallbacks, (unsigned long) (entry.savedMicros / entry.commands));
+#ifdef PROPCRYPTO_HAL_STATS
+    halConfig.stats = NULL;
+    printf("\n%-8s %10s %8s %8s %12s %12s %12s %12s\n", "opcode", "commands", "retries", "nacks", "send (us)",
+           "execute (us)", "max exec", "receive (us)");
+    for (const auto &entry : halStats.entries)
+        if (entry.commands)
+            printf("0x%02X     %10lu %8lu %8lu %12lu %12lu %12lu %12lu\n", entry.opcode,
+                   (unsigned long) entry.commands, (unsigned long) entry.retries, (unsigned long) entry.nacks,
+                   (unsigned long) entry.phases[HalStats::PHASE_SEND].average(),
+                   (unsigned long) entry.phases[HalStats::PHASE_EXECUTE].average(),
+                   (unsigned long) entry.phases[HalStats::PHASE_EXECUTE].maxMicros,
+                   (unsigned long) entry.phases[HalStats::PHASE_RECEIVE].average());
+    printf("%lu wakes, %lu failed, %lu us average\n", (unsigned long) halStats.wake.count,
+           (unsigned long) halStats.wakeFailures, (unsigned long) halStats.wake.average());
+#endif
+
+    // Same commands again, all inside one wake (see CryptoDevice::Session)
+    printf("\n");
+    header("ACK polling, held awake between commands");
+    halConfig.holdAwake = true;
+    atcab_wakeup();
+    run("atcab_info", iterations, [&] () {
+        return atcab_info(buffer);
+    });
+    run("atcab_read_serial_number", iterations, [&] () {
+        return atcab_read_serial_number(buffer);
+    });
+    run("atcab_random", iterations, [&] () {
+        return atcab_random(buffer);
+    });
+    run("atcab_sign", iterations, [&] () {
+        return atcab_sign(SIGNING_SLOT, message, buffer);
+    });
+    halConfig.holdAwake = false;
+    atcab_idle();
+
+    // Whole packets through the transport cog instead of byte-at-a-time I2CMaster calls
+    printf("\n");
+    header("ACK polling, cog transport");
+    atcab_release();
+    halConfig.transport        = TRANSPORT_COG;
+    halConfig.completionReport = NULL;
+    if (ATCA_SUCCESS != atcab_init(&cfg)) {
+        printf("Failed to start the cog transport\n");
+        return 1;
+    }
+    suite();
+
+    // Noise on the bus damages the first response of every command. Without help from the HAL, the library reports
+    // the bad CRC and the command has to be issued again, execution time and all.
+    printf("\n");
+    header("Cog transport, one damaged response per command");
+    run("random, command repeated", iterations, [&] () {
+        device.corrupt_responses(1);
+        const ATCA_STATUS result = atcab_random(buffer);
+        return ATCA_SUCCESS == result ? result : atcab_random(buffer);
+    });
+    run("get_pubkey, command repeated", iterations, [&] () {
+        device.corrupt_responses(1);
+        const ATCA_STATUS result = atcab_get_pubkey(SIGNING_SLOT, buffer);
+        return ATCA_SUCCESS == result ? result : atcab_get_pubkey(SIGNING_SLOT, buffer);
+    });
+    halConfig.receive = RECEIVE_REREAD_ON_CRC_ERROR;
+    run("random, response re-read", iterations, [&] () {
+        device.corrupt_responses(1);
+        return atcab_random(buffer);
+    });
+    run("get_pubkey, response re-read", iterations, [&] () {
+        device.corrupt_responses(1);
+        return atcab_get_pubkey(SIGNING_SLOT, buffer);
+    });
+    halConfig.receive = RECEIVE_AS_READ;
+
+    // One signature per batch instead of per message, each message carrying a proof of inclusion instead
+    printf("\n%u messages, cog transport, ACK polling:\n%-28s %10s %10s %10s %8s\n", iterations, "signing",
+           "msgs/sec", "us/msg", "proof B", "errors");
+    // The odd sizes promote a node on some level and so need more than 2n - 1 nodes: 3 + 2 + 1, 100 + 50 + ... + 1
+    static_assert(6 == MerkleTree::node_count(3) && 202 == MerkleTree::node_count(100), "Merkle tree node count");
+    run_batches<1>("one signature per message", iterations, publicKey);
+    run_batches<3>("Merkle batches of 3", iterations, publicKey);
+    run_batches<8>("Merkle batches of 8", iterations, publicKey);
+    run_batches<32>("Merkle batches of 32", iterations, publicKey);
+    run_batches<100>("Merkle batches of 100", iterations, publicKey);
+    run_batches<128>("Merkle batches of 128", iterations, publicKey);
+
+    // The same few signatures checked over and over, as with firmware manifests and peer certificates. With fewer
+    // entries than signatures, least-recently-used eviction throws out every entry just before it would be needed.
+    printf("\n");
+    header("Verify, 4 signatures in turn (cache rows include an estimate of the software SHA-256, not a measurement)");
+    const size_t VERIFY_SIGNATURES = 4;
+    uint8_t      verifyDigests[VERIFY_SIGNATURES][ATCA_SHA_DIGEST_SIZE];
+    uint8_t      verifySignatures[VERIFY_SIGNATURES][ATCA_SIG_SIZE];
+    for (size_t i = 0; i < VERIFY_SIGNATURES; ++i) {
+        memset(verifyDigests[i], static_cast<int>(i), ATCA_SHA_DIGEST_SIZE);
+        atcab_sign(SIGNING_SLOT, verifyDigests[i], verifySignatures[i]);
+    }
+    size_t nextVerify = 0;
+    run("no cache", iterations, [&] () {
+        const size_t      i        = nextVerify++ % VERIFY_SIGNATURES;
+        bool              verified = false;
+        const ATCA_STATUS result   = atcab_verify_extern(verifyDigests[i], verifySignatures[i], publicKey, &verified);
+        return (ATCA_SUCCESS == result && !verified) ? ATCA_CHECKMAC_VERIFY_FAILED : result;
+    });
+    run_verify_cache<2>("cache of 2", iterations, verifyDigests, verifySignatures, VERIFY_SIGNATURES, publicKey);
+    run_verify_cache<8>("cache of 8", iterations, verifyDigests, verifySignatures, VERIFY_SIGNATURES, publicKey);
+
+    // Device SHA-256 against the software fallback, with the stream fed in pieces that do not line up with blocks
+    printf("\nSHA-256 (software column estimated at %lu us per block, not measured):\n"
+           "%-10s %14s %14s %14s %10s %8s\n", (unsigned long) SOFTWARE_SHA_BLOCK_MICROS, "bytes", "atcab_sha (us)",
+           "stream (us)", "est. sw (us)", "automatic", "errors");
+    uint64_t firstStreamMicros = 0;
+    uint64_t lastStreamMicros  = 0;
+    size_t   firstBlocks       = 0;
+    size_t   lastBlocks        = 0;
+    std::vector<uint8_t> shaPayload(65536);
+    for (size_t i = 0; i < shaPayload.size(); ++i)
+        shaPayload[i] = static_cast<uint8_t>(i * 7);
+    for (size_t size = 64; size <= shaPayload.size(); size *= 4) {
+        const size_t CHUNK_SIZE = 100;
+        Sha256Stream sha;
+        unsigned int failures   = 0;
+        uint8_t      expected[ATCA_SHA_DIGEST_SIZE];
+        uint8_t      digest[ATCA_SHA_DIGEST_SIZE];
+
+        sha.hash(shaPayload.data(), size, expected, SHA_ENGINE_SOFTWARE);
+
+        // atcab_sha() takes a 16-bit length, so its 64 KB row is one byte short and not compared
+        uint64_t start = sim::Clock::now();
+        if (ATCA_SUCCESS != atcab_sha(static_cast<uint16_t>(size < 65535 ? size : 65535), shaPayload.data(), digest)
+            || (size < 65535 && memcmp(expected, digest, sizeof(digest))))
+            ++failures;
+        const uint64_t libraryMicros = sim::Clock::micros(sim::Clock::now() - start);
+
+        start = sim::Clock::now();
+        PropWare::ErrorCode err = sha.start(size, SHA_ENGINE_DEVICE);
+        for (size_t offset = 0; !err && offset < size; offset += CHUNK_SIZE)
+            err = sha.update(&shaPayload[offset], size - offset < CHUNK_SIZE ? size - offset : CHUNK_SIZE);
+        const PropWare::ErrorCode finished = sha.finish(digest);
+        if (err || finished || memcmp(expected, digest, sizeof(digest)))
+            ++failures;
+        const uint64_t streamMicros = sim::Clock::micros(sim::Clock::now() - start);
+
+        const size_t   blocks         = (size + 9 + Sha256Stream::BLOCK_SIZE - 1) / Sha256Stream::BLOCK_SIZE;
+        const uint64_t softwareMicros = blocks * SOFTWARE_SHA_BLOCK_MICROS;
+        if (!firstBlocks) {
+            firstBlocks       = blocks;
+            firstStreamMicros = streamMicros;
+        }
+        lastBlocks       = blocks;
+        lastStreamMicros = streamMicros;
+
+        printf("%-10lu %14llu %14llu %14llu %10s %8u\n", (unsigned long) size, (unsigned long long) libraryMicros,
+               (unsigned long long) streamMicros, (unsigned long long) softwareMicros,
+               SHA_ENGINE_DEVICE == sha.engine_for(size) ? "device" : "software", failures);
+        if (failures)
+            ++g_failedRows;
+    }
+    // The stream's cost is linear in the blocks: a fixed part for wake, Start and End, and one per block
+    const auto deviceBlockMicros = static_cast<uint32_t>((lastStreamMicros - firstStreamMicros)
+                                                         / (lastBlocks - firstBlocks));
+    const auto deviceFixedMicros = static_cast<uint32_t>(firstStreamMicros > firstBlocks * deviceBlockMicros
+                                                         ? firstStreamMicros - firstBlocks * deviceBlockMicros : 0);
+    printf("Device: %lu us + %lu us per block. Threshold at the estimated software cost: %lu bytes (default %lu)\n",
+           (unsigned long) deviceFixedMicros, (unsigned long) deviceBlockMicros,
+           (unsigned long) Sha256Stream::device_threshold_for(SOFTWARE_SHA_BLOCK_MICROS, deviceFixedMicros,
+                                                              deviceBlockMicros),
+           (unsigned long) Sha256Stream::DEFAULT_DEVICE_THRESHOLD);
+
+    // A production line's worth of blank parts: every key generation blocks the cog for most of 100 ms, unless the
+    // other units' commands are issued in the meantime
+    printf("\n%u blank devices on two buses, %u config bytes per unit at most:\n%-28s %10s %10s %10s %8s %8s\n",
+           (unsigned int) LINE_UNITS, (unsigned int) ConfigZone::SIZE, "provisioning", "units/hour", "total (us)",
+           "bytes/unit", "retries", "failed");
+    run_provisioning("no overlap", cfg, sequentialUnits, 0);
+    run_provisioning("pipelined", cfg, pipelinedUnits, Provisioner<LINE_UNITS>::DEFAULT_MAX_NESTING);
+
+    atcab_release();
+    if (g_failedRows)
+        printf("\n%u rows reported errors\n", g_failedRows);
+    return g_failedRows ? 1 : 0;
+}
@@ -20,38 +20,27 @@
  */
 
 #include "CryptoDevice.h"
+#include "ConfigZone.h"
 #include "common.h"
 #include "authtypes.h"
+#include "ConfigImage.h"
+#include "LinkSettingsStore.h"
+#include "LogSink.h"
 
 #include <PropWare/hmi/output/printer.h>
-#include <PropWare/memory/blockstorage.h>
+#include <PropWare/utility/utility.h>
 
 #include <atca_basic.h>
 
 using PropWare::Printer;
 using PropWare::Utility;
-using PropWare::BlockStorage;
-
-#define PUBLIC_KEY_CONFIG SLOT_CONFIGURATION(0b0010, 0, SLOT_IS_SECRET, SLOT_IS_PLAIN_TEXT, SLOT_USE_UNLIMITED, \
-                                      NO_USAGE_RESTRICTIONS, 1)
-
-/**
- * @brief Swap the bytes and split them into two distinct parameters that can be added as literals in a byte-array
- */
-#define _PUB_KEY SPLIT(SWAP(SlotConfig::PUBLIC_KEY.raw()))
 
 /**
- * @brief Complete configuration data for the ATECC508A
+ * @brief Complete configuration for the ATECC508A: the factory settings with slot 0 turned into a public_key() slot
  *
  * Data can only be written to devices in 4- or 32-byte chunks, so it's not worth trying to write the configuration
- * in a byte-by-byte manner. For this reason, we'll just configure the entire configuration zone at once and hardcode
- * a big block.
- *
- * 0xFF will be used for the read-only bytes serial number and revision information
- *
- * @note This method is NOT ideal because it prevents the program from computing a valid CRC for the configuration
- *       data block. It would be better to read the configuration zone at runtime, then set only the bits/bytes that
- *       matter for the application, calculate a CRC, and then write the data back with the checksum included.
+ * in a byte-by-byte manner. ConfigImage<DemoConfig>::DATA is the whole zone, built by the compiler; handing it to
+ * ConfigZone::set_bytes() and then CryptoDevice::apply_config() writes back only the words that differ from the device.
  *
  * Before messing with your device, do a read of your configuration zone data and save it off. This is the results of my
  * read, prior to any writes:
@@ -66,67 +55,96 @@ using PropWare::BlockStorage;
  * 0x0060: 33 00 33 00 33 00 1C 00 - 1C 00 1C 00 1C 00 1C 00 3.3.3...........
  * 0x0070: 3C 00 3C 00 3C 00 3C 00 - 3C 00 3C 00 3C 00 1C 00 <.<.<.<.<.<.<...
  */
-// @formatter:off
-static const uint8_t CONFIG_ZONE_DATA_ATECC508A[] = {
-//            0     1     2     3     4     5     6     7       8     9     A     B     C     D     E     F
-/* 0x00 */ 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,   0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-/* 0x10 */ 0xC0, 0x00, 0x55, 0x00,
-
-// Special slot configuration (bytes 20-51)
-/* 0x10 */                         _PUB_KEY  , 0x87, 0x20,   0x8F, 0x20, 0xC4, 0x8F, 0x8F, 0x8F, 0x8F, 0x8F,
-/* 0x20 */ 0x9F, 0x8F, 0xAF, 0x8F, 0x00, 0x00, 0x00, 0x00,   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-/* 0x30 */ 0x00, 0x00, 0xAF, 0x8F,
-
-// Normal configuration again
-/* 0x30 */                         0xFF, 0xFF, 0xFF, 0xFF,   0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF,
-/* 0x40 */ 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF,   0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-/* 0x50 */ 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x55, 0x55,   0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-
-// Special key configuration (bytes 96-127)
-/* 0x60 */ 0x33, 0x00, 0x33, 0x00, 0x33, 0x00, 0x1C, 0x00,   0x1C, 0x00, 0x1C, 0x00, 0x1C, 0x00, 0x1C, 0x00,
-/* 0x70 */ 0x3C, 0x00, 0x3C, 0x00, 0x3C, 0x00, 0x3C, 0x00,   0x3C, 0x00, 0x3C, 0x00, 0x3C, 0x00, 0x1C, 0x00
+struct DemoConfig {
+    static constexpr ConfigLayout layout () {
+        // @formatter:off
+        return ConfigLayout{
+            0xC0, 0x55, 0x00,
+            {
+                SlotConfig::public_key(), SlotConfig(0x2087), SlotConfig(0x208F), SlotConfig(0x8FC4),
+                SlotConfig(0x8F8F),     SlotConfig(0x8F8F), SlotConfig(0x8F9F), SlotConfig(0x8FAF),
+                SlotConfig(),           SlotConfig(),       SlotConfig(),       SlotConfig(),
+                SlotConfig(),           SlotConfig(),       SlotConfig(),       SlotConfig(0x8FAF)
+            },
+            {
+                KeyConfig(true, true, KEY_TYPE_P256, true),    KeyConfig(true, true, KEY_TYPE_P256, true),
+                KeyConfig(true, true, KEY_TYPE_P256, true),    KeyConfig(false, false, KEY_TYPE_DATA, false),
+                KeyConfig(false, false, KEY_TYPE_DATA, false), KeyConfig(false, false, KEY_TYPE_DATA, false),
+                KeyConfig(false, false, KEY_TYPE_DATA, false), KeyConfig(false, false, KEY_TYPE_DATA, false),
+                KeyConfig(false, false, KEY_TYPE_DATA, true),  KeyConfig(false, false, KEY_TYPE_DATA, true),
+                KeyConfig(false, false, KEY_TYPE_DATA, true),  KeyConfig(false, false, KEY_TYPE_DATA, true),
+                KeyConfig(false, false, KEY_TYPE_DATA, true),  KeyConfig(false, false, KEY_TYPE_DATA, true),
+                KeyConfig(false, false, KEY_TYPE_DATA, true),  KeyConfig(false, false, KEY_TYPE_DATA, false)
+            }
+        };
+        // @formatter:on
+    }
 };
-// @formatter:on
 
-PropWare::ErrorCode run (CryptoDevice &cryptoDevice) {
+PropWare::ErrorCode run (CryptoDevice &cryptoDevice, const Printer &out) {
     PropWare::ErrorCode err;
 
     check_errors(cryptoDevice.initialize());
-    pwOut << "initialized\n";
-    check_errors(cryptoDevice.print_serial(pwOut));
-    pwOut << '\n';
-
-    pwOut << "Initial configuration zone:\n";
+    out << "initialized\n";
+
+    // The QuickStart's EEPROM is 64 kB: the settings live above the boot image
+    LinkSettingsStore          linkStore(LinkSettingsStore::DEFAULT_LOCATION);
+    CryptoDevice::LinkSettings linkSettings;
+    if (linkStore.load(&linkSettings) && cryptoDevice.apply_link_settings(linkSettings)) {
+        out << "Stored bus timing: ";
+    } else {
+        check_errors(cryptoDevice.calibrate(&linkSettings));
+        if (!linkStore.save(linkSettings))
+            out << "Failed to store the bus timing (is the EEPROM larger than 32 kB?)\n";
+        out << "Calibrated bus timing: ";
+    }
+    out << linkSettings.baud << " Hz, wake delay " << linkSettings.wakeDelay << " us\n";
+    check_errors(cryptoDevice.print_serial(out));
+    out << '\n';
+
+    out << "Initial configuration zone:\n";
     uint8_t    configData[128];
     const auto configDataSize = Utility::size_of_array(configData);
-    check_errors(atcab_read_config_zone(configData));
-    BlockStorage::print_block(pwOut, configData, configDataSize);
-
-    pwOut << "Slot config: 0x";
-    pwOut.put_int(PUBLIC_KEY_CONFIG, 16, 4, '0');
-    pwOut << '\n';
-
-    pwOut << "Slot config: 0x";
-    pwOut.put_int(SlotConfig::PUBLIC_KEY.raw(), 16, 4, '0');
-    pwOut << '\n';
-
-    //pwOut << "Writing modified configuration zone data\n";
-    //check_errors(atcab_write_config_zone(CONFIG_ZONE_DATA_ATECC508A));
-    //pwOut << "Final configuration zone:\n";
-    //check_errors(atcab_read_config_zone(configData));
-    //BlockStorage::print_block(pwOut, configData, configDataSize);
-
-    //pwOut << "Generating new public/private key: ";
-    //check_errors(cryptoDevice.generate_key(1, &pwOut));
-    //pwOut << '\n';
+    check_errors(cryptoDevice.read_config_zone(configData));
+    print_hexdump(out, configData, configDataSize);
+
+    out << "Slot config: 0x";
+    out.put_int(SlotConfig::public_key().raw(), 16, 4, '0');
+    out << '\n';
+
+    out << "Generated configuration zone:\n";
+    print_hexdump(out, ConfigImage<DemoConfig>::DATA, ConfigImage<DemoConfig>::SIZE);
+
+    //out << "Writing modified configuration zone data\n";
+    //ConfigZone config;
+    //check_errors(cryptoDevice.read_config(config));
+    //config.set_bytes(0, ConfigImage<DemoConfig>::DATA, ConfigImage<DemoConfig>::SIZE);
+    //size_t bytesWritten;
+    //check_errors(cryptoDevice.apply_config(config, &bytesWritten));
+    //out << "Wrote " << bytesWritten << " bytes, lock CRC 0x" << HEX_FMT << config.crc() << '\n';
+    //out << "Final configuration zone:\n";
+    //check_errors(cryptoDevice.read_config_zone(configData));
+    //print_hexdump(out, configData, configDataSize);
+
+    //out << "Generating new public/private key: ";
+    //check_errors(cryptoDevice.generate_key(1, &out));
+    //out << '\n';
 
     return 0;
 }
 
 int main () {
+    // Output goes through a ring buffer drained by another cog, so printing never holds up the device
+    uint32_t      logStack[128];
+    LogSink<1024> logSink(logStack);
+    const Printer logOut(logSink);
+    if (!logSink.start())
+        return 1;
+
     CryptoDevice cryptoDevice;
-    const auto   err = run(cryptoDevice);
-    pwOut << "COMPLETE! Status code = 0x" << HEX_FMT << err << '\n';
+    const auto   err = run(cryptoDevice, logOut);
+    logOut << "COMPLETE! Status code = 0x" << HEX_FMT << err << '\n';
     cryptoDevice.sleep();
+    logSink.flush();
     return 0;
 }
@@ -0,0 +1,199 @@
+/**
+ * @file    encrypted_session_test.cpp
+ *
+ * @author  David Zemon
+ *
+ * @copyright
+ * The MIT License (MIT)<br>
+ * <br>Copyright (c) 2019 David Zemon<br>
+ * <br>Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:<br>
+ * <br>The above copyright notice and this permission notice shall be included in all copies or substantial portions
+ * of the Software.<br>
+ * <br>THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Round-trips data through CryptoDevice::EncryptedSession against a simulated ATECC508A whose secret slot only takes
+ * encrypted reads and writes. Checks that consecutive blocks share one TempKey set-up, that TempKey is set up again
+ * whenever the HAL's volatile epoch says the device may have lost it (a command that replaces it, a sleep), that a
+ * block the device rejects after losing TempKey unnoticed is retried once with a fresh set-up, and that the device
+ * refuses writes made with the wrong key. The exit status is non-zero if any check failed.
+ */
+
+#include "CryptoDevice.h"
+
+#include <Atecc508a.h>
+#include <simulator.h>
+#include <PropWare/gpio/pin.h>
+
+#include <atca_basic.h>
+
+#include <cstdio>
+#include <cstring>
+
+using PropWare::Pin;
+
+static const uint16_t KEY_SLOT    = 9;
+static const uint16_t SECRET_SLOT = 8;
+static const uint8_t  BLOCKS      = 3;
+
+static const uint8_t KEY[ATCA_KEY_SIZE] = {
+    0x37, 0x80, 0xE6, 0x3D, 0x49, 0x68, 0xAD, 0xE5, 0xD8, 0x22, 0xC0, 0x13, 0xFC, 0xC3, 0x23, 0x84,
+    0x5D, 0x1B, 0x56, 0x9F, 0xE7, 0x05, 0xB6, 0x00, 0x06, 0xFE, 0xEC, 0x14, 0x5A, 0x0D, 0xB1, 0xE3
+};
+
+static const uint8_t NUM_IN[NONCE_NUMIN_SIZE] = {
+    0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x10, 0x11, 0x12, 0x13,
+    0x14
+};
+
+static unsigned int g_failures = 0;
+
+static void expect (const bool condition, const char *check) {
+    if (!condition) {
+        printf("FAIL %s\n", check);
+        ++g_failures;
+    }
+}
+
+/**
+ * Key slot: secret and never written again. Secret slot: encrypted reads and writes, both keyed by the key slot.
+ */
+static PropWare::ErrorCode personalize (CryptoDevice &cryptoDevice) {
+    PropWare::ErrorCode err;
+    ConfigZone          config;
+
+    check_errors(cryptoDevice.read_config(config));
+    config.set_slot_config(KEY_SLOT, SlotConfig(0, false, false, false, true, 0, 0b1000));
+    config.set_slot_config(SECRET_SLOT, SlotConfig(KEY_SLOT, false, false, true, true, KEY_SLOT, 0b0100));
+    check_errors(cryptoDevice.apply_config(config));
+    check_errors(cryptoDevice.lock_config(config));
+    check_errors(cryptoDevice.write_zone(ATCA_ZONE_DATA, KEY_SLOT, 0, 0, KEY, ATCA_KEY_SIZE));
+    return cryptoDevice.lock_data_zone();
+}
+
+static void fill (uint8_t *data, const size_t length, const uint8_t seed) {
+    for (size_t i = 0; i < length; ++i)
+        data[i] = static_cast<uint8_t>(seed + 7 * i);
+}
+
+/**
+ * Several blocks written and read back with one Nonce and GenDig between them
+ */
+static void round_trip (CryptoDevice &cryptoDevice) {
+    uint8_t written[BLOCKS * ATCA_BLOCK_SIZE];
+    uint8_t read[BLOCKS * ATCA_BLOCK_SIZE];
+    fill(written, sizeof(written), 0x5A);
+
+    CryptoDevice::EncryptedSession session(cryptoDevice, KEY_SLOT, KEY, NUM_IN);
+    expect(0 == session.status(), "round trip: session wakes the device");
+    expect(0 == session.write_blocks(SECRET_SLOT, 0, written, BLOCKS), "round trip: write");
+    expect(0 == session.read_blocks(SECRET_SLOT, 0, read, BLOCKS), "round trip: read");
+    expect(!memcmp(written, read, sizeof(written)), "round trip: data read back as written");
+    expect(1 == session.setups(), "round trip: one TempKey set-up for every block");
+}
+
+/**
+ * A command that may replace TempKey, and a sleep, each advance the volatile epoch. The next block sets TempKey up
+ * again before it is read, rather than being rejected first.
+ */
+static void epoch_changes (CryptoDevice &cryptoDevice, sim::Atecc508a &device) {
+    uint8_t       expected[ATCA_BLOCK_SIZE];
+    uint8_t       read[ATCA_BLOCK_SIZE];
+    const uint8_t numIn[NONCE_NUMIN_SIZE_PASSTHROUGH] = {0};
+    fill(expected, sizeof(expected), 0x5A);
+
+    CryptoDevice::EncryptedSession session(cryptoDevice, KEY_SLOT, KEY, NUM_IN);
+    expect(0 == session.read_block(SECRET_SLOT, 0, read), "epoch: first read");
+
+    expect(ATCA_SUCCESS == atcab_nonce(numIn), "epoch: TempKey replaced");
+    sim::Atecc508a::Counters before = device.counters();
+    expect(0 == session.read_block(SECRET_SLOT, 0, read), "epoch: read after Nonce");
+    expect(!memcmp(expected, read, sizeof(expected)), "epoch: data correct after Nonce");
+    expect(2 == session.setups(), "epoch: TempKey set up again after Nonce");
+    expect(device.counters().commands == before.commands + 3, "epoch: no rejected read after Nonce");
+
+    expect(ATCA_SUCCESS == atcab_sleep(), "epoch: sleep");
+    before = device.counters();
+    expect(0 == session.read_block(SECRET_SLOT, 0, read), "epoch: read after sleep");
+    expect(!memcmp(expected, read, sizeof(expected)), "epoch: data correct after sleep");
+    expect(3 == session.setups(), "epoch: TempKey set up again after sleep");
+    expect(device.counters().wakes == before.wakes + 1, "epoch: device woken again after sleep");
+    expect(device.counters().commands == before.commands + 3, "epoch: no rejected read after sleep");
+}
+
+/**
+ * The device fell asleep behind the HAL's back, so the epoch still matches. The rejected read is retried once with a
+ * fresh TempKey.
+ */
+static void lost_temp_key (CryptoDevice &cryptoDevice, sim::Atecc508a &device) {
+    uint8_t expected[ATCA_BLOCK_SIZE];
+    uint8_t read[ATCA_BLOCK_SIZE];
+    fill(expected, sizeof(expected), 0x5A);
+
+    CryptoDevice::EncryptedSession session(cryptoDevice, KEY_SLOT, KEY, NUM_IN);
+    expect(0 == session.read_block(SECRET_SLOT, 0, read), "lost TempKey: first read");
+
+    // Sleep word address, straight to the device
+    device.address(sim::Atecc508a::DEFAULT_ADDRESS);
+    device.write(0x01);
+    device.stop();
+
+    expect(0 == session.read_block(SECRET_SLOT, 0, read), "lost TempKey: read retried");
+    expect(!memcmp(expected, read, sizeof(expected)), "lost TempKey: data correct after retry");
+    expect(2 == session.setups(), "lost TempKey: TempKey set up again for the retry");
+}
+
+/**
+ * The write MAC doesn't match when the host computed TempKey with another key, and the slot keeps its contents
+ */
+static void wrong_key (CryptoDevice &cryptoDevice) {
+    uint8_t key[ATCA_KEY_SIZE];
+    uint8_t data[ATCA_BLOCK_SIZE];
+    uint8_t expected[ATCA_BLOCK_SIZE];
+    memcpy(key, KEY, sizeof(key));
+    key[0] ^= 0x01;
+    fill(data, sizeof(data), 0xA5);
+    fill(expected, sizeof(expected), 0x5A);
+
+    {
+        CryptoDevice::EncryptedSession session(cryptoDevice, KEY_SLOT, key, NUM_IN);
+        expect(0 != session.write_block(SECRET_SLOT, 0, data), "wrong key: write refused");
+    }
+
+    CryptoDevice::EncryptedSession session(cryptoDevice, KEY_SLOT, KEY, NUM_IN);
+    expect(0 == session.read_block(SECRET_SLOT, 0, data), "wrong key: read with the right key");
+    expect(!memcmp(expected, data, sizeof(expected)), "wrong key: slot unchanged");
+}
+
+int main () {
+    sim::Atecc508a device;
+    sim::I2CBus::on(Pin::Mask::P28).attach(device);
+
+    CryptoDevice cryptoDevice;
+    if (cryptoDevice.initialize() || personalize(cryptoDevice)) {
+        printf("FAIL device initialization\n");
+        return 1;
+    }
+
+    uint8_t block[ATCA_BLOCK_SIZE];
+    expect(ATCA_SUCCESS != atcab_read_zone(ATCA_ZONE_DATA, SECRET_SLOT, 0, 0, block, sizeof(block)),
+           "secret slot refuses reads without GenDig");
+
+    round_trip(cryptoDevice);
+    epoch_changes(cryptoDevice, device);
+    lost_temp_key(cryptoDevice, device);
+    wrong_key(cryptoDevice);
+
+    cryptoDevice.sleep();
+
+    printf("%s: %u failed checks\n", g_failures ? "FAILED" : "passed", g_failures);
+    return g_failures ? 1 : 0;
+}
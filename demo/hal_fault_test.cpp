@@ -0,0 +1,227 @@
+/**
+ * @file    hal_fault_test.cpp
+ *
+ * @author  David Zemon
+ *
+ * @copyright
+ * The MIT License (MIT)<br>
+ * <br>Copyright (c) 2019 David Zemon<br>
+ * <br>Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:<br>
+ * <br>The above copyright notice and this permission notice shall be included in all copies or substantial portions
+ * of the Software.<br>
+ * <br>THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Injects faults into a simulated ATECC508A and checks that the HAL recovers from each the way it is meant to: damaged
+ * responses are read again after a word-address reset instead of repeating the command, NACKed reads are retried up
+ * to rx_retries times, a device that fell asleep behind the HAL's back is woken for real on the next command, and a
+ * held wake is re-armed before the watchdog expires, and discovery's wake with no delay of its own returns at once.
+ * Every case runs on both transports. The exit status is non-zero if any check failed.
+ */
+
+#include "atca_hal_prop.h"
+
+#include <Atecc508a.h>
+#include <simulator.h>
+#include <PropWare/gpio/pin.h>
+
+#include <atca_basic.h>
+
+#include <cstdio>
+#include <cstring>
+
+using PropWare::Pin;
+
+static const int RX_RETRIES = 3;
+
+static unsigned int g_failures = 0;
+
+static void expect (const bool condition, const char *transport, const char *check) {
+    if (!condition) {
+        printf("FAIL [%s] %s\n", transport, check);
+        ++g_failures;
+    }
+}
+
+static void advance_millis (const uint32_t millis) {
+    sim::Clock::advance(sim::Clock::ticks_from_micros(1000ULL * millis));
+}
+
+/**
+ * A damaged response costs one more read, after word address 0x00 points the device back at its start, and no second
+ * execution. Without the re-read mode, the damage reaches the caller.
+ */
+static void damaged_response (const char *transport, sim::Atecc508a &device, PropHalConfig &halConfig) {
+    uint8_t random[ATCA_KEY_SIZE];
+
+    halConfig.receive = RECEIVE_REREAD_ON_CRC_ERROR;
+    sim::Atecc508a::Counters before = device.counters();
+    device.corrupt_responses(1);
+    expect(ATCA_SUCCESS == atcab_random(random), transport, "re-read: command succeeds");
+    expect(device.counters().commands == before.commands + 1, transport, "re-read: command executed once");
+    expect(device.counters().corruptedResponses == before.corruptedResponses + 1, transport,
+           "re-read: response was damaged");
+    expect(device.counters().ioResets > before.ioResets, transport, "re-read: word address reset before re-reading");
+
+    halConfig.receive = RECEIVE_AS_READ;
+    before = device.counters();
+    device.corrupt_responses(1);
+    expect(ATCA_SUCCESS != atcab_random(random), transport, "plain read: damaged response reported");
+    expect(device.counters().ioResets == before.ioResets, transport, "plain read: no word address reset");
+    expect(ATCA_SUCCESS == atcab_random(random), transport, "plain read: next command succeeds");
+}
+
+/**
+ * A device that is still busy NACKs its address: the read is retried, and given up on after rx_retries attempts
+ */
+static void nacked_reads (const char *transport, sim::Atecc508a &device, PropHalConfig &halConfig) {
+    uint8_t revision[4];
+
+    // Held awake, so that the only reads are command responses and not wake tokens
+    halConfig.holdAwake = true;
+    expect(ATCA_SUCCESS == atcab_wakeup(), transport, "NACK: wake");
+
+    sim::Atecc508a::Counters before = device.counters();
+    device.nack_reads(RX_RETRIES - 1);
+    expect(ATCA_SUCCESS == atcab_info(revision), transport, "NACK: read retried until the device answers");
+    expect(device.counters().nackedReads == before.nackedReads + RX_RETRIES - 1, transport,
+           "NACK: every refused read was retried");
+    expect(device.counters().commands == before.commands + 1, transport, "NACK: command executed once");
+
+    before = device.counters();
+    device.nack_reads(RX_RETRIES);
+    expect(ATCA_SUCCESS != atcab_info(revision), transport, "NACK: gives up after rx_retries reads");
+    expect(device.counters().nackedReads == before.nackedReads + RX_RETRIES, transport,
+           "NACK: no read beyond rx_retries");
+    expect(ATCA_SUCCESS == atcab_info(revision), transport, "NACK: next command succeeds");
+
+    halConfig.holdAwake = false;
+    atcab_idle();
+}
+
+/**
+ * A held device that went to sleep without the HAL noticing (another master, a brown-out) NACKs the next command.
+ * The HAL must not keep believing it is awake: the command after that wakes it for real.
+ */
+static void lost_wake (const char *transport, sim::Atecc508a &device, PropHalConfig &halConfig,
+                       const ATCAIfaceCfg &cfg) {
+    uint8_t revision[4];
+
+    halConfig.holdAwake = true;
+    expect(ATCA_SUCCESS == atcab_wakeup(), transport, "lost wake: wake");
+
+    // Sleep word address, straight to the device
+    device.address(cfg.atcai2c.slave_address);
+    device.write(0x01);
+    device.stop();
+
+    const sim::Atecc508a::Counters before = device.counters();
+    const uint32_t                 epoch  = halConfig.volatileEpoch;
+    expect(ATCA_SUCCESS != atcab_info(revision), transport, "lost wake: NACKed command reported");
+    expect(!halConfig.awake, transport, "lost wake: HAL no longer believes the device is awake");
+    expect(halConfig.volatileEpoch != epoch, transport, "lost wake: volatile state reported lost");
+    expect(ATCA_SUCCESS == atcab_info(revision), transport, "lost wake: next command succeeds");
+    expect(device.counters().wakes == before.wakes + 1, transport, "lost wake: next command woke the device");
+
+    halConfig.holdAwake = false;
+    atcab_idle();
+}
+
+/**
+ * A held wake is renewed with idle and wake once WATCHDOG_REARM_MS have passed, which keeps TempKey. Past the
+ * watchdog, the device has slept and the HAL reports TempKey as lost.
+ */
+static void watchdog_rearm (const char *transport, sim::Atecc508a &device, PropHalConfig &halConfig) {
+    uint8_t       revision[4];
+    const uint8_t numIn[NONCE_NUMIN_SIZE_PASSTHROUGH] = {0};
+
+    halConfig.holdAwake = true;
+    expect(ATCA_SUCCESS == atcab_nonce(numIn), transport, "re-arm: load TempKey");
+
+    sim::Atecc508a::Counters before = device.counters();
+    uint32_t                 epoch  = halConfig.volatileEpoch;
+    advance_millis(PropHalConfig::WATCHDOG_REARM_MS + 100);
+    expect(ATCA_SUCCESS == atcab_info(revision), transport, "re-arm: command after re-arm succeeds");
+    expect(device.counters().wakes == before.wakes + 1, transport, "re-arm: woken again");
+    expect(device.counters().watchdogExpirations == before.watchdogExpirations, transport,
+           "re-arm: watchdog did not expire");
+    expect(device.temp_key_valid(), transport, "re-arm: TempKey kept");
+    expect(halConfig.volatileEpoch == epoch, transport, "re-arm: volatile state not reported lost");
+
+    before = device.counters();
+    epoch  = halConfig.volatileEpoch;
+    advance_millis(PropHalConfig::WATCHDOG_MS + 100);
+    expect(ATCA_SUCCESS == atcab_info(revision), transport, "watchdog: command after expiry succeeds");
+    expect(device.counters().watchdogExpirations == before.watchdogExpirations + 1, transport,
+           "watchdog: expired");
+    expect(halConfig.volatileEpoch != epoch, transport, "watchdog: volatile state reported lost");
+
+    halConfig.holdAwake = false;
+    atcab_idle();
+}
+
+/**
+ * Discovery wakes each bus with no delay of its own and then waits out wake_delay once. A zero delay handed to the
+ * transport cog must not become a wait for the system counter to wrap around.
+ */
+static void discovery (const char *transport, const ATCAIfaceCfg &cfg) {
+    ATCAIfaceCfg found[2];
+    int          count = 0;
+
+    const uint64_t startedAt = sim::Clock::now();
+    expect(ATCA_SUCCESS == hal_prop_discover_devices(1, cfg, found, 2, &count), transport, "discovery: succeeds");
+    expect(sim::Clock::now() - startedAt < sim::Clock::ticks_from_micros(100000), transport,
+           "discovery: done within 100 ms");
+    expect(1 == count && ATECC508A == found[0].devtype, transport, "discovery: device identified");
+}
+
+int main () {
+    PropHalConfig halConfig;
+
+    ATCAIfaceCfg cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.iface_type            = ATCA_I2C_IFACE;
+    cfg.devtype               = ATECC508A;
+    cfg.atcai2c.slave_address = sim::Atecc508a::DEFAULT_ADDRESS;
+    cfg.atcai2c.bus           = 0;
+    cfg.atcai2c.baud          = 1000000;
+    cfg.wake_delay            = 800;
+    cfg.rx_retries            = RX_RETRIES;
+    cfg.cfg_data              = &halConfig;
+
+    sim::Atecc508a device;
+    device.provision();
+    sim::I2CBus::on(Pin::Mask::P28).attach(device);
+
+    const struct {
+        const char *name;
+        Transport  transport;
+    } transports[] = {{"i2c master", TRANSPORT_I2C_MASTER}, {"cog", TRANSPORT_COG}};
+
+    for (const auto &transport : transports) {
+        halConfig.transport = transport.transport;
+        if (ATCA_SUCCESS != atcab_init(&cfg)) {
+            printf("FAIL [%s] library initialization\n", transport.name);
+            return 1;
+        }
+
+        damaged_response(transport.name, device, halConfig);
+        nacked_reads(transport.name, device, halConfig);
+        lost_wake(transport.name, device, halConfig, cfg);
+        watchdog_rearm(transport.name, device, halConfig);
+        discovery(transport.name, cfg);
+
+        atcab_release();
+    }
+
+    printf("%s: %u failed checks\n", g_failures ? "FAILED" : "passed", g_failures);
+    return g_failures ? 1 : 0;
+}
@@ -0,0 +1,91 @@
+/**
+ * @file    i2c_cog.h
+ *
+ * @author  David Zemon
+ *
+ * @copyright
+ * The MIT License (MIT)<br>
+ * <br>Copyright (c) 2019 David Zemon<br>
+ * <br>Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:<br>
+ * <br>The above copyright notice and this permission notice shall be included in all copies or substantial portions
+ * of the Software.<br>
+ * <br>THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+/*
+ * Hub-memory mailbox shared between the HAL and the I2C transport cog (i2c_cog.cogc). This header is included by
+ * both the CMM-compiled C++ side and the cog-model C side, so it must remain plain C.
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Approximate system clock ticks the cog spends on instructions around each half-bit wait. The HAL subtracts it
+ * from the half-bit time so the bus runs close to the configured baud rate.
+ */
+#define I2C_COG_HOLD_OVERHEAD 24
+/** Shortest half-bit wait that `waitcnt(CNT + n)` can still hit without wrapping */
+#define I2C_COG_MIN_HALF_BIT  12
+
+/**
+ * @brief Commands understood by the transport cog
+ *
+ * The HAL fills in the mailbox, then writes `command`. The cog clears `command` back to I2C_COG_IDLE once `status`
+ * (and, for a receive, `length`) are valid.
+ */
+typedef enum {
+    I2C_COG_IDLE,
+    /** START, address, word address, `length` bytes from `buffer`, STOP */
+    I2C_COG_SEND,
+    /**
+     * START, address + read, then a CryptoAuth response: the first byte is the packet length, which determines how
+     * many more bytes are read into `buffer`. `length` is the buffer capacity on entry and the bytes read on exit.
+     */
+    I2C_COG_RECEIVE,
+    /** Hold SDA low for `intervalTicks`, release it, then wait `timeoutTicks` (if not 0) before returning */
+    I2C_COG_WAKE,
+    /** Ping the address every `intervalTicks` until it acknowledges or `timeoutTicks` have passed */
+    I2C_COG_POLL
+} I2CCogCommand;
+
+typedef enum {
+    I2C_COG_SUCCESS,
+    /** The device did not acknowledge its address or a data byte */
+    I2C_COG_NACK,
+    /** The response length byte was smaller than the smallest valid packet */
+    I2C_COG_INVALID_SIZE,
+    /** The response length byte was larger than the buffer */
+    I2C_COG_SMALL_BUFFER
+} I2CCogStatus;
+
+typedef struct {
+    volatile uint32_t command;
+    volatile uint32_t status;
+    uint8_t *volatile buffer;
+    volatile uint32_t length;
+    volatile uint32_t sclMask;
+    volatile uint32_t sdaMask;
+    /** Half of one SCL period, in system clock ticks */
+    volatile uint32_t halfBitTicks;
+    volatile uint32_t intervalTicks;
+    volatile uint32_t timeoutTicks;
+    volatile uint8_t  address;
+    volatile uint8_t  wordAddress;
+} I2CCogMailbox;
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,260 @@
+/**
+ * @file    trace_replay.cpp
+ *
+ * @author  David Zemon
+ *
+ * @copyright
+ * The MIT License (MIT)<br>
+ * <br>Copyright (c) 2019 David Zemon<br>
+ * <br>Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:<br>
+ * <br>The above copyright notice and this permission notice shall be included in all copies or substantial portions
+ * of the Software.<br>
+ * <br>THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Replays a bus trace captured by TraceRecorder against simulated ATECC508As and compares the time each transaction
+ * took on the board with the time it takes against the model. Read the trace off the card first, for instance:
+ *
+ *     dd if=/dev/sdX of=trace.img bs=512 skip=<first block> count=<blocks>
+ *
+ * Transactions start at the same offsets as they did on the board, so execution delays are reproduced as recorded.
+ * A row whose replayed latency differs from the recording by more than the tolerance is flagged, and the exit status
+ * is non-zero if any row was.
+ */
+
+#include "atca_hal_prop.h"
+#include "TraceRecorder.h"
+
+#include <Atecc508a.h>
+#include <simulator.h>
+#include <PropWare/gpio/pin.h>
+
+#include <atca_basic.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <vector>
+
+using PropWare::Pin;
+
+static const unsigned int DEFAULT_TOLERANCE_PERCENT = 10;
+/** Bus n of the HAL is driven by this SCL pin */
+static const uint32_t     BUS_SCL[]                 = {Pin::Mask::P28, Pin::Mask::P1};
+static const size_t       MAX_PACKET                = 0xFF;
+
+static const char *const KIND_NAMES[] = {"wake", "send", "receive", "idle", "sleep"};
+
+struct Row {
+    uint8_t      kind;
+    uint8_t      opcode;
+    unsigned int count;
+    unsigned int statusMismatches;
+    unsigned int lengthMismatches;
+    double       recordedMicros;
+    double       replayedMicros;
+};
+
+struct Target {
+    std::unique_ptr<sim::Atecc508a> model;
+    ATCAIfaceCfg                    cfg;
+    ATCADevice                      device;
+    /** Opcode of the last command sent, to file the response under */
+    uint8_t                         opcode;
+};
+
+static void usage (const char *name) {
+    printf("Usage: %s [-b baud] [-w wake_delay_us] [-r rx_retries] [-t tolerance_percent] [--worst-case] "
+           "trace.img\n", name);
+}
+
+static bool read_trace (const char *path, TraceHeader &header, std::vector<uint8_t> &records) {
+    FILE *const file = fopen(path, "rb");
+    if (!file) {
+        perror(path);
+        return false;
+    }
+
+    bool ok = 1 == fread(&header, sizeof(header), 1, file)
+              && TraceHeader::MAGIC == header.magic
+              && TraceHeader::VERSION == header.version
+              && sizeof(TraceRecord) == header.recordSize
+              && header.blockSize >= sizeof(header)
+              && 0 == fseek(file, header.blockSize, SEEK_SET);
+    if (ok) {
+        records.resize(header.bytes);
+        ok = header.bytes == fread(records.data(), 1, header.bytes, file);
+    }
+    fclose(file);
+    if (!ok)
+        fprintf(stderr, "%s: not a complete version %u trace\n", path, TraceHeader::VERSION);
+    return ok;
+}
+
+int main (int argc, char *argv[]) {
+    ATCAIfaceCfg base;
+    memset(&base, 0, sizeof(base));
+    base.iface_type   = ATCA_I2C_IFACE;
+    base.devtype      = ATECC508A;
+    base.atcai2c.baud = 1000000;
+    base.wake_delay   = 800;
+    base.rx_retries   = 3;
+
+    unsigned int tolerance = DEFAULT_TOLERANCE_PERCENT;
+    bool         worstCase = false;
+    const char   *path     = NULL;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp("--worst-case", argv[i])) {
+            worstCase = true;
+        } else if (i + 1 < argc && !strcmp("-b", argv[i])) {
+            base.atcai2c.baud = static_cast<uint32_t>(strtoul(argv[++i], NULL, 0));
+        } else if (i + 1 < argc && !strcmp("-w", argv[i])) {
+            base.wake_delay = static_cast<uint16_t>(strtoul(argv[++i], NULL, 0));
+        } else if (i + 1 < argc && !strcmp("-r", argv[i])) {
+            base.rx_retries = static_cast<int>(strtol(argv[++i], NULL, 0));
+        } else if (i + 1 < argc && !strcmp("-t", argv[i])) {
+            tolerance = static_cast<unsigned int>(strtoul(argv[++i], NULL, 0));
+        } else if ('-' != argv[i][0] && !path) {
+            path = argv[i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (!path) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    TraceHeader          header;
+    std::vector<uint8_t> records;
+    if (!read_trace(path, header, records))
+        return 1;
+
+    std::map<uint16_t, Target> targets;
+    std::map<uint16_t, Row>    rows;
+    unsigned int               replayed   = 0;
+    unsigned int               skipped    = 0;
+    uint64_t                   lagTicks   = 0;
+    uint32_t                   previousAt = 0;
+    uint64_t                   target     = sim::Clock::now();
+
+    for (size_t offset = 0; offset + sizeof(TraceRecord) <= records.size();) {
+        TraceRecord record;
+        memcpy(&record, &records[offset], sizeof(record));
+        const uint8_t *const payload = &records[offset + sizeof(record)];
+        offset += sizeof(record) + ((record.stored + 3u) & ~3u);
+        if (offset > records.size() || record.kind > TRACE_SLEEP || record.bus >= sizeof(BUS_SCL) / sizeof(BUS_SCL[0])) {
+            ++skipped;
+            continue;
+        }
+
+        // Same gap since the previous transaction as on the board, converted to simulated ticks
+        if (replayed)
+            target += static_cast<uint64_t>(record.startedAt - previousAt) * sim::Clock::FREQUENCY
+                      / header.clockFrequency;
+        previousAt = record.startedAt;
+        if (sim::Clock::now() < target)
+            sim::Clock::advance(target - sim::Clock::now());
+        else
+            lagTicks += sim::Clock::now() - target;
+        ++replayed;
+
+        const uint16_t key = static_cast<uint16_t>(record.bus << 8 | record.address);
+        Target         &device = targets[key];
+        if (!device.model) {
+            device.model.reset(new sim::Atecc508a(record.address));
+            device.model->provision();
+            device.model->use_worst_case_timing(worstCase);
+            sim::I2CBus::on(BUS_SCL[record.bus]).attach(*device.model);
+            device.cfg                       = base;
+            device.cfg.atcai2c.bus           = record.bus;
+            device.cfg.atcai2c.slave_address = record.address;
+            device.device                    = newATCADevice(&device.cfg);
+            if (!device.device) {
+                fprintf(stderr, "Failed to set up bus %u, address 0x%02X\n", record.bus, record.address);
+                return 1;
+            }
+        }
+        const ATCAIface iface = atGetIFace(device.device);
+
+        uint8_t        buffer[MAX_PACKET + 1];
+        uint16_t       length = 0;
+        ATCA_STATUS    status;
+        const uint64_t startedAt = sim::Clock::now();
+        switch (record.kind) {
+            case TRACE_WAKE:
+                status = atwake(iface);
+                break;
+            case TRACE_SEND:
+                if (record.stored != record.length || record.length < 2) {
+                    ++skipped;
+                    continue;
+                }
+                device.opcode = payload[1];
+                buffer[0]     = 0;
+                memcpy(&buffer[1], payload, record.length);
+                status = atsend(iface, buffer, record.length);
+                length = record.length;
+                break;
+            case TRACE_RECEIVE:
+                length = MAX_PACKET;
+                status = atreceive(iface, buffer, &length);
+                break;
+            case TRACE_IDLE:
+                status = atidle(iface);
+                break;
+            default:
+                status = atsleep(iface);
+        }
+        const uint64_t ticks = sim::Clock::now() - startedAt;
+
+        const bool perOpcode = TRACE_SEND == record.kind || TRACE_RECEIVE == record.kind;
+        const auto rowKey    = static_cast<uint16_t>(record.kind << 8 | (perOpcode ? device.opcode : 0));
+        Row        &row      = rows[rowKey];
+        row.kind   = record.kind;
+        row.opcode = perOpcode ? device.opcode : 0;
+        ++row.count;
+        row.recordedMicros += 1e6 * record.ticks / header.clockFrequency;
+        row.replayedMicros += 1e6 * ticks / sim::Clock::FREQUENCY;
+        if (status != record.status)
+            ++row.statusMismatches;
+        if (TRACE_RECEIVE == record.kind && length != record.length)
+            ++row.lengthMismatches;
+    }
+
+    printf("%u transactions replayed, %u skipped, %u dropped while recording, replay ran %llu us behind in total\n\n",
+           replayed, skipped, header.dropped, (unsigned long long) sim::Clock::micros(lagTicks));
+    printf("%-8s %-6s %8s %14s %14s %8s %8s %8s\n", "phase", "opcode", "count", "recorded (us)", "replayed (us)",
+           "delta", "status", "length");
+
+    bool regressed = false;
+    for (const auto &entry : rows) {
+        const Row    &row      = entry.second;
+        const double recorded  = row.recordedMicros / row.count;
+        const double replayed  = row.replayedMicros / row.count;
+        const double delta     = recorded ? 100 * (replayed - recorded) / recorded : 0;
+        const bool   flagged   = delta > tolerance || delta < -static_cast<double>(tolerance)
+                                 || row.statusMismatches || row.lengthMismatches;
+        char         opcode[8] = "";
+        if (TRACE_SEND == row.kind || TRACE_RECEIVE == row.kind)
+            snprintf(opcode, sizeof(opcode), "0x%02X", row.opcode);
+        printf("%-8s %-6s %8u %14.1f %14.1f %+7.1f%% %8u %8u%s\n", KIND_NAMES[row.kind], opcode, row.count, recorded,
+               replayed, delta, row.statusMismatches, row.lengthMismatches, flagged ? "  <--" : "");
+        regressed |= flagged;
+    }
+
+    for (auto &entry : targets)
+        deleteATCADevice(&entry.second.device);
+    return regressed ? 2 : 0;
+}
@@ -0,0 +1,654 @@
+/**
+ * @file    Atecc508a.cpp
+ *
+ * @author  David Zemon
+ *
+ * @copyright
+ * The MIT License (MIT)<br>
+ * <br>Copyright (c) 2019 David Zemon<br>
+ * <br>Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:<br>
+ * <br>The above copyright notice and this permission notice shall be included in all copies or substantial portions
+ * of the Software.<br>
+ * <br>THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "Atecc508a.h"
+
+#include <cstring>
+
+namespace sim {
+
+/**
+ * @brief Configuration zone read from our bench unit before it was ever written (see cryptoauth_demo.cpp)
+ */
+static const uint8_t FACTORY_CONFIG[Atecc508a::CONFIG_SIZE] = {
+    0x01, 0x23, 0x62, 0x53, 0x00, 0x00, 0x50, 0x00, 0x55, 0xDA, 0xF7, 0xA0, 0xEE, 0xC0, 0x49, 0x00,
+    0xC0, 0x00, 0x55, 0x00, 0x83, 0x20, 0x87, 0x20, 0x8F, 0x20, 0xC4, 0x8F, 0x8F, 0x8F, 0x8F, 0x8F,
+    0x9F, 0x8F, 0xAF, 0x8F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0xAF, 0x8F, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF,
+    0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x55, 0x55, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x33, 0x00, 0x33, 0x00, 0x33, 0x00, 0x1C, 0x00, 0x1C, 0x00, 0x1C, 0x00, 0x1C, 0x00, 0x1C, 0x00,
+    0x3C, 0x00, 0x3C, 0x00, 0x3C, 0x00, 0x3C, 0x00, 0x3C, 0x00, 0x3C, 0x00, 0x3C, 0x00, 0x1C, 0x00
+};
+
+static const uint8_t WAKE_TOKEN[] = {0x04, 0x11, 0x33, 0x43};
+
+// Byte offsets into the configuration zone
+static const size_t CONFIG_SLOT_CONFIG = 20;
+static const size_t CONFIG_LOCK_VALUE  = 86;
+static const size_t CONFIG_LOCK_CONFIG = 87;
+static const size_t CONFIG_KEY_CONFIG  = 96;
+
+static const uint8_t LOCKED = 0x00;
+
+/**
+ * @brief Typical execution times from the datasheet, next to the maximums the library waits out
+ */
+static const struct {
+    uint8_t  opcode;
+    uint32_t typicalMicros;
+    uint32_t maximumMillis;
+} EXECUTION_TIMES[] = {
+    {ATCA_GENDIG, 5000,  11},
+    {ATCA_GENKEY, 85000, 115},
+    {ATCA_INFO,   100,   1},
+    {ATCA_LOCK,   8000,  32},
+    {ATCA_NONCE,  1000,  7},
+    {ATCA_RANDOM, 1000,  23},
+    {ATCA_READ,   100,   1},
+    {ATCA_SHA,    2000,  9},
+    {ATCA_SIGN,   42000, 50},
+    {ATCA_VERIFY, 38000, 58},
+    {ATCA_WRITE,  7000,  26}
+};
+
+static void sha256 (uint8_t *digest, const uint8_t *a, const size_t aLength, const uint8_t *b = NULL,
+                    const size_t bLength = 0, const uint8_t *c = NULL, const size_t cLength = 0) {
+    atcac_sha2_256_ctx ctx;
+    atcac_sw_sha2_256_init(&ctx);
+    atcac_sw_sha2_256_update(&ctx, a, aLength);
+    if (b)
+        atcac_sw_sha2_256_update(&ctx, b, bLength);
+    if (c)
+        atcac_sw_sha2_256_update(&ctx, c, cLength);
+    atcac_sw_sha2_256_finish(&ctx, digest);
+}
+
+Atecc508a::Atecc508a (const uint8_t address, const uint8_t *serial)
+        : m_address(address),
+          m_powerState(SLEEP),
+          m_readyAt(0),
+          m_watchdogExpiresAt(0),
+          m_wakeHighMicros(WAKE_HIGH_MICROS),
+          m_worstCase(false),
+          m_wordAddress(WORD_ADDRESS_NONE),
+          m_reading(false),
+          m_inputLength(0),
+          m_outputLength(0),
+          m_outputIndex(0),
+          m_responsesToCorrupt(0),
+          m_corruptNextRead(false),
+          m_readsToNack(0),
+          m_tempKeyValid(false),
+          m_genDigSlot(NO_SLOT),
+          m_shaActive(false) {
+    memcpy(this->m_config, FACTORY_CONFIG, CONFIG_SIZE);
+    if (serial) {
+        memcpy(&this->m_config[0], &serial[0], 4);
+        memcpy(&this->m_config[8], &serial[4], 5);
+    }
+    this->m_config[16] = address;
+    memset(this->m_otp, 0xFF, OTP_SIZE);
+
+    for (uint8_t slot = 0; slot < SLOT_COUNT; ++slot) {
+        const size_t size = slot < 8 ? 36 : (8 == slot ? 416 : 72);
+        this->m_slots[slot].assign(size, 0xFF);
+        this->m_hasPrivateKey[slot] = false;
+    }
+
+    this->m_rng = 0x9E3779B97F4A7C15ULL;
+    for (size_t i = 0; i < 13; ++i)
+        this->m_rng = (this->m_rng ^ this->m_config[i]) * 0x100000001B3ULL;
+
+    memset(&this->m_counters, 0, sizeof(this->m_counters));
+}
+
+void Atecc508a::provision () {
+    this->m_config[CONFIG_LOCK_CONFIG] = LOCKED;
+    this->m_config[CONFIG_LOCK_VALUE]  = LOCKED;
+}
+
+void Atecc508a::sda_low (const uint64_t ticks) {
+    this->check_watchdog();
+    if (AWAKE == this->m_powerState || ticks < Clock::ticks_from_micros(WAKE_LOW_MICROS))
+        return;
+
+    // Idle keeps TempKey, sleep already dropped it
+    this->m_powerState        = AWAKE;
+    this->m_readyAt           = Clock::now() + Clock::ticks_from_micros(this->m_wakeHighMicros);
+    this->m_watchdogExpiresAt = Clock::now() + Clock::ticks_from_micros(WATCHDOG_MICROS);
+    // The wake token is already a complete packet, count and CRC included
+    memcpy(this->m_output, WAKE_TOKEN, sizeof(WAKE_TOKEN));
+    this->m_outputLength = sizeof(WAKE_TOKEN);
+    this->m_outputIndex  = 0;
+    ++this->m_counters.wakes;
+}
+
+bool Atecc508a::address (const uint8_t addressByte) {
+    this->check_watchdog();
+    if ((addressByte & 0xFE) != this->m_address || AWAKE != this->m_powerState || Clock::now() < this->m_readyAt)
+        return false;
+    if ((addressByte & 0x01) && this->m_readsToNack) {
+        --this->m_readsToNack;
+        ++this->m_counters.nackedReads;
+        return false;
+    }
+
+    this->m_reading     = static_cast<bool>(addressByte & 0x01);
+    this->m_wordAddress = WORD_ADDRESS_NONE;
+    this->m_inputLength = 0;
+    return true;
+}
+
+bool Atecc508a::write (const uint8_t byte) {
+    if (WORD_ADDRESS_NONE == this->m_wordAddress) {
+        if (byte > WORD_ADDRESS_COMMAND)
+            return false;
+        this->m_wordAddress = static_cast<WordAddress>(byte);
+        if (WORD_ADDRESS_RESET == byte) {
+            this->m_outputIndex = 0;
+            ++this->m_counters.ioResets;
+        }
+        return true;
+    } else if (WORD_ADDRESS_COMMAND == this->m_wordAddress && this->m_inputLength < MAX_COMMAND_SIZE) {
+        this->m_input[this->m_inputLength++] = byte;
+        return true;
+    } else {
+        return false;
+    }
+}
+
+uint8_t Atecc508a::read () {
+    if (!this->m_outputLength)
+        return 0xFF;
+    uint8_t byte = this->m_output[this->m_outputIndex];
+    // The last data byte, so that the length byte still frames the packet and only the CRC check notices
+    if (this->m_corruptNextRead && this->m_outputIndex == this->m_outputLength - ATCA_CRC_SIZE - 1) {
+        byte ^= 0x10;
+        this->m_corruptNextRead = false;
+        ++this->m_counters.corruptedResponses;
+    }
+    this->m_outputIndex = (this->m_outputIndex + 1) % this->m_outputLength;
+    return byte;
+}
+
+void Atecc508a::stop () {
+    if (!this->m_reading) {
+        switch (this->m_wordAddress) {
+            case WORD_ADDRESS_SLEEP:
+                this->go_to_sleep();
+                break;
+            case WORD_ADDRESS_IDLE:
+                this->m_powerState   = IDLE;
+                this->m_outputLength = 0;
+                break;
+            case WORD_ADDRESS_COMMAND:
+                this->execute();
+                break;
+            default:
+                break;
+        }
+    }
+    this->m_wordAddress = WORD_ADDRESS_NONE;
+}
+
+void Atecc508a::check_watchdog () {
+    if (AWAKE == this->m_powerState && Clock::now() >= this->m_watchdogExpiresAt) {
+        this->go_to_sleep();
+        ++this->m_counters.watchdogExpirations;
+    }
+}
+
+void Atecc508a::go_to_sleep () {
+    this->m_powerState   = SLEEP;
+    this->m_tempKeyValid = false;
+    this->m_shaActive    = false;
+    this->m_outputLength = 0;
+}
+
+void Atecc508a::execute () {
+    ++this->m_counters.commands;
+    this->m_outputLength    = 0;
+    this->m_corruptNextRead = false;
+
+    const uint8_t *packet = this->m_input;
+    const size_t  count   = this->m_inputLength ? packet[0] : 0;
+    if (count < ATCA_CMD_SIZE_MIN || count != this->m_inputLength) {
+        this->respond_status(STATUS_PARSE_ERROR);
+        return;
+    }
+
+    uint8_t crc[ATCA_CRC_SIZE];
+    atCRC(count - ATCA_CRC_SIZE, packet, crc);
+    if (crc[0] != packet[count - 2] || crc[1] != packet[count - 1]) {
+        ++this->m_counters.crcErrors;
+        this->respond_status(STATUS_CRC_ERROR);
+        return;
+    }
+
+    const uint8_t  opcode     = packet[1];
+    const uint8_t  param1     = packet[2];
+    const uint16_t param2     = static_cast<uint16_t>(packet[3] | (packet[4] << 8));
+    const uint8_t  *data      = &packet[5];
+    const size_t   dataLength = count - ATCA_CMD_SIZE_MIN;
+
+    uint8_t status;
+    switch (opcode) {
+        case ATCA_INFO:
+            status = this->execute_info(param1);
+            break;
+        case ATCA_READ:
+            status = this->execute_read(param1, param2);
+            break;
+        case ATCA_WRITE:
+            status = this->execute_write(param1, param2, data, dataLength);
+            break;
+        case ATCA_LOCK:
+            status = this->execute_lock(param1, param2);
+            break;
+        case ATCA_NONCE:
+            status = this->execute_nonce(param1, data, dataLength);
+            break;
+        case ATCA_GENDIG:
+            status = this->execute_gendig(param1, param2, data, dataLength);
+            break;
+        case ATCA_GENKEY:
+            status = this->execute_genkey(param1, param2);
+            break;
+        case ATCA_SIGN:
+            status = this->execute_sign(param1, param2);
+            break;
+        case ATCA_VERIFY:
+            status = this->execute_verify(param1, data, dataLength);
+            break;
+        case ATCA_RANDOM:
+            status = this->execute_random();
+            break;
+        case ATCA_SHA:
+            status = this->execute_sha(param1, data, dataLength);
+            break;
+        default:
+            status = STATUS_PARSE_ERROR;
+    }
+
+    // Commands that produce data respond on their own; everything else reports a status byte
+    if (STATUS_SUCCESS != status || !this->m_outputLength)
+        this->respond_status(status);
+    if (this->m_responsesToCorrupt) {
+        --this->m_responsesToCorrupt;
+        this->m_corruptNextRead = true;
+    }
+    this->m_readyAt = Clock::now() + Clock::ticks_from_micros(this->execution_micros(opcode));
+}
+
+uint8_t Atecc508a::execute_info (const uint8_t mode) {
+    if (mode)
+        return STATUS_PARSE_ERROR;
+    this->respond(&this->m_config[4], 4);
+    return STATUS_SUCCESS;
+}
+
+uint8_t Atecc508a::execute_read (const uint8_t zone, const uint16_t address) {
+    const size_t length = (zone & ATCA_ZONE_READWRITE_32) ? ATCA_BLOCK_SIZE : ATCA_WORD_SIZE;
+    const size_t block  = (address >> 3) & 0x1F;
+    const size_t offset = block * ATCA_BLOCK_SIZE + (address & 0x07) * ATCA_WORD_SIZE;
+
+    switch (zone & 0x03) {
+        case ATCA_ZONE_CONFIG:
+            if (offset + length > CONFIG_SIZE)
+                return STATUS_PARSE_ERROR;
+            this->respond(&this->m_config[offset], length);
+            return STATUS_SUCCESS;
+        case ATCA_ZONE_OTP:
+            if (offset + length > OTP_SIZE)
+                return STATUS_PARSE_ERROR;
+            this->respond(&this->m_otp[offset], length);
+            return STATUS_SUCCESS;
+        case ATCA_ZONE_DATA: {
+            const uint8_t  slot       = static_cast<uint8_t>((address >> 3) & 0x0F);
+            const size_t   dataOffset = (address >> 8) * ATCA_BLOCK_SIZE + (address & 0x07) * ATCA_WORD_SIZE;
+            const uint16_t slotConfig = this->slot_config(slot);
+            // IsSecret without EncryptRead is never readable
+            const bool     encrypted  = 0xC0 == (slotConfig & 0xC0);
+            if (!this->data_locked() || ((slotConfig & 0x80) && !encrypted))
+                return STATUS_EXECUTION_ERROR;
+            if (dataOffset + length > this->m_slots[slot].size())
+                return STATUS_PARSE_ERROR;
+            if (!encrypted) {
+                this->respond(&this->m_slots[slot][dataOffset], length);
+                return STATUS_SUCCESS;
+            }
+
+            // 32 bytes only, XORed with a TempKey that GenDig derived from ReadKey
+            if (ATCA_BLOCK_SIZE != length || !this->temp_key_from(static_cast<uint8_t>(slotConfig & 0x0F)))
+                return STATUS_EXECUTION_ERROR;
+            uint8_t cipherText[ATCA_BLOCK_SIZE];
+            for (size_t i = 0; i < sizeof(cipherText); ++i)
+                cipherText[i] = this->m_slots[slot][dataOffset + i] ^ this->m_tempKey[i];
+            this->respond(cipherText, sizeof(cipherText));
+            return STATUS_SUCCESS;
+        }
+        default:
+            return STATUS_PARSE_ERROR;
+    }
+}
+
+uint8_t Atecc508a::execute_write (const uint8_t zone, const uint16_t address, const uint8_t *data,
+                                  const size_t length) {
+    // Encrypted writes carry the input MAC after the data
+    const bool   encrypted      = static_cast<bool>(zone & ATCA_ZONE_ENCRYPTED);
+    const size_t expectedLength = (zone & ATCA_ZONE_READWRITE_32) ? ATCA_BLOCK_SIZE : ATCA_WORD_SIZE;
+    if (length != expectedLength + (encrypted ? WRITE_MAC_SIZE : 0))
+        return STATUS_PARSE_ERROR;
+    if (encrypted && ATCA_ZONE_DATA != (zone & 0x03))
+        return STATUS_PARSE_ERROR;
+
+    const size_t block  = (address >> 3) & 0x1F;
+    const size_t offset = block * ATCA_BLOCK_SIZE + (address & 0x07) * ATCA_WORD_SIZE;
+
+    switch (zone & 0x03) {
+        case ATCA_ZONE_CONFIG:
+            // Serial number, revision, UserExtra, Selector and the lock bytes can't be touched by Write
+            if (this->config_locked() || offset + length > CONFIG_SIZE || offset < 16
+                    || (offset <= 84 && 84 < offset + length))
+                return STATUS_EXECUTION_ERROR;
+            memcpy(&this->m_config[offset], data, length);
+            return STATUS_SUCCESS;
+        case ATCA_ZONE_OTP:
+            if (this->data_locked() || offset + length > OTP_SIZE)
+                return STATUS_EXECUTION_ERROR;
+            memcpy(&this->m_otp[offset], data, length);
+            return STATUS_SUCCESS;
+        case ATCA_ZONE_DATA: {
+            const uint8_t  slot       = static_cast<uint8_t>((address >> 3) & 0x0F);
+            const size_t   dataOffset = (address >> 8) * ATCA_BLOCK_SIZE + (address & 0x07) * ATCA_WORD_SIZE;
+            const uint16_t slotConfig = this->slot_config(slot);
+            if (dataOffset + expectedLength > this->m_slots[slot].size())
+                return STATUS_PARSE_ERROR;
+            if (!encrypted) {
+                // Once locked, only slots with WriteConfig "Always" accept clear-text writes
+                if (!this->config_locked() || (this->data_locked() && (slotConfig >> 12)))
+                    return STATUS_EXECUTION_ERROR;
+                memcpy(&this->m_slots[slot][dataOffset], data, expectedLength);
+                return STATUS_SUCCESS;
+            }
+
+            // WriteConfig "Encrypt" (01xx): 32 bytes XORed with a TempKey that GenDig derived from WriteKey
+            if (!this->data_locked() || 0x4 != ((slotConfig >> 12) & 0xC) || ATCA_BLOCK_SIZE != expectedLength
+                    || !this->temp_key_from(static_cast<uint8_t>((slotConfig >> 8) & 0x0F)))
+                return STATUS_EXECUTION_ERROR;
+            uint8_t plainText[ATCA_BLOCK_SIZE];
+            uint8_t mac[WRITE_MAC_SIZE];
+            for (size_t i = 0; i < sizeof(plainText); ++i)
+                plainText[i] = data[i] ^ this->m_tempKey[i];
+            this->command_digest(mac, this->m_tempKey, ATCA_WRITE, zone, address, plainText);
+            if (memcmp(mac, &data[ATCA_BLOCK_SIZE], sizeof(mac)))
+                return STATUS_EXECUTION_ERROR;
+            memcpy(&this->m_slots[slot][dataOffset], plainText, expectedLength);
+            return STATUS_SUCCESS;
+        }
+        default:
+            return STATUS_PARSE_ERROR;
+    }
+}
+
+uint8_t Atecc508a::execute_lock (const uint8_t mode, const uint16_t summaryCrc) {
+    uint8_t crc[ATCA_CRC_SIZE];
+    if (LOCK_ZONE_CONFIG == (mode & 0x03)) {
+        if (this->config_locked())
+            return STATUS_EXECUTION_ERROR;
+        if (!(mode & LOCK_ZONE_NO_CRC)) {
+            atCRC(CONFIG_SIZE, this->m_config, crc);
+            if (summaryCrc != (crc[0] | (crc[1] << 8)))
+                return STATUS_EXECUTION_ERROR;
+        }
+        this->m_config[CONFIG_LOCK_CONFIG] = LOCKED;
+    } else if (LOCK_ZONE_DATA == (mode & 0x03)) {
+        if (!this->config_locked() || this->data_locked())
+            return STATUS_EXECUTION_ERROR;
+        if (!(mode & LOCK_ZONE_NO_CRC)) {
+            std::vector<uint8_t> contents;
+            for (uint8_t slot = 0; slot < SLOT_COUNT; ++slot)
+                contents.insert(contents.end(), this->m_slots[slot].begin(), this->m_slots[slot].end());
+            contents.insert(contents.end(), this->m_otp, this->m_otp + OTP_SIZE);
+            atCRC(contents.size(), contents.data(), crc);
+            if (summaryCrc != (crc[0] | (crc[1] << 8)))
+                return STATUS_EXECUTION_ERROR;
+        }
+        this->m_config[CONFIG_LOCK_VALUE] = LOCKED;
+    } else {
+        return STATUS_PARSE_ERROR;
+    }
+    return STATUS_SUCCESS;
+}
+
+uint8_t Atecc508a::execute_nonce (const uint8_t mode, const uint8_t *numIn, const size_t length) {
+    if (NONCE_MODE_PASSTHROUGH == (mode & 0x03)) {
+        if (ATCA_KEY_SIZE != length)
+            return STATUS_PARSE_ERROR;
+        memcpy(this->m_tempKey, numIn, ATCA_KEY_SIZE);
+    } else {
+        if (NONCE_NUMIN_SIZE != length)
+            return STATUS_PARSE_ERROR;
+        uint8_t       randOut[ATCA_KEY_SIZE];
+        const uint8_t params[] = {ATCA_NONCE, mode, 0x00};
+        this->random_bytes(randOut, sizeof(randOut));
+        sha256(this->m_tempKey, randOut, sizeof(randOut), numIn, length, params, sizeof(params));
+        this->respond(randOut, sizeof(randOut));
+    }
+    this->m_tempKeyValid = true;
+    this->m_genDigSlot   = NO_SLOT;
+    this->m_shaActive    = false;
+    return STATUS_SUCCESS;
+}
+
+uint8_t Atecc508a::execute_gendig (const uint8_t zone, const uint16_t keyId, const uint8_t *otherData,
+                                   const size_t length) {
+    // OtherData only matters for keys with NoMac set, which this model doesn't distinguish
+    (void) otherData;
+    if (GENDIG_ZONE_DATA != zone || keyId >= SLOT_COUNT || (length && 4 != length))
+        return STATUS_PARSE_ERROR;
+    if (!this->data_locked() || !this->m_tempKeyValid)
+        return STATUS_EXECUTION_ERROR;
+
+    const uint8_t slot = static_cast<uint8_t>(keyId);
+    this->command_digest(this->m_tempKey, this->m_slots[slot].data(), ATCA_GENDIG, zone, keyId, this->m_tempKey);
+    this->m_genDigSlot = slot;
+    return STATUS_SUCCESS;
+}
+
+uint8_t Atecc508a::execute_genkey (const uint8_t mode, const uint16_t keyId) {
+    if (keyId >= SLOT_COUNT)
+        return STATUS_PARSE_ERROR;
+
+    // Private, P256 key type
+    const uint16_t keyConfig = this->key_config(static_cast<uint8_t>(keyId));
+    if (!this->config_locked() || !(keyConfig & 0x01) || (0x04 << 2) != (keyConfig & 0x1C))
+        return STATUS_EXECUTION_ERROR;
+
+    if (GENKEY_MODE_PRIVATE == mode) {
+        this->random_bytes(this->m_privateKeys[keyId], ATCA_KEY_SIZE);
+        this->m_hasPrivateKey[keyId] = true;
+    } else if (GENKEY_MODE_PUBLIC != mode || !this->m_hasPrivateKey[keyId]) {
+        return STATUS_EXECUTION_ERROR;
+    }
+
+    uint8_t publicKey[ATCA_PUB_KEY_SIZE];
+    this->public_key_for(this->m_privateKeys[keyId], publicKey);
+    this->m_knownKeys[std::vector<uint8_t>(publicKey, publicKey + sizeof(publicKey))] =
+            std::vector<uint8_t>(this->m_privateKeys[keyId], this->m_privateKeys[keyId] + ATCA_KEY_SIZE);
+    this->respond(publicKey, sizeof(publicKey));
+    return STATUS_SUCCESS;
+}
+
+uint8_t Atecc508a::execute_sign (const uint8_t mode, const uint16_t keyId) {
+    if (SIGN_MODE_EXTERNAL != (mode & 0xC0) || keyId >= SLOT_COUNT)
+        return STATUS_PARSE_ERROR;
+    if (!this->m_tempKeyValid || !this->m_hasPrivateKey[keyId] || !(this->slot_config(keyId) & 0x01))
+        return STATUS_EXECUTION_ERROR;
+
+    uint8_t signature[ATCA_SIG_SIZE];
+    this->signature_for(this->m_privateKeys[keyId], this->m_tempKey, signature);
+    this->m_tempKeyValid = false;
+    this->respond(signature, sizeof(signature));
+    return STATUS_SUCCESS;
+}
+
+uint8_t Atecc508a::execute_verify (const uint8_t mode, const uint8_t *data, const size_t length) {
+    if (VERIFY_MODE_EXTERNAL != (mode & 0x07) || ATCA_SIG_SIZE + ATCA_PUB_KEY_SIZE != length)
+        return STATUS_PARSE_ERROR;
+    if (!this->m_tempKeyValid)
+        return STATUS_EXECUTION_ERROR;
+    this->m_tempKeyValid = false;
+
+    const auto privateKey = this->m_knownKeys.find(
+            std::vector<uint8_t>(&data[ATCA_SIG_SIZE], &data[ATCA_SIG_SIZE + ATCA_PUB_KEY_SIZE]));
+    if (this->m_knownKeys.end() == privateKey)
+        return STATUS_MISCOMPARE;
+
+    uint8_t expected[ATCA_SIG_SIZE];
+    this->signature_for(privateKey->second.data(), this->m_tempKey, expected);
+    return memcmp(expected, data, ATCA_SIG_SIZE) ? STATUS_MISCOMPARE : STATUS_SUCCESS;
+}
+
+uint8_t Atecc508a::execute_random () {
+    uint8_t randOut[ATCA_KEY_SIZE];
+    if (this->config_locked()) {
+        this->random_bytes(randOut, sizeof(randOut));
+    } else {
+        // The real part refuses to hand out entropy until the configuration is locked
+        for (size_t i = 0; i < sizeof(randOut); ++i)
+            randOut[i] = static_cast<uint8_t>((i & 0x02) ? 0x00 : 0xFF);
+    }
+    this->respond(randOut, sizeof(randOut));
+    return STATUS_SUCCESS;
+}
+
+uint8_t Atecc508a::execute_sha (const uint8_t mode, const uint8_t *data, const size_t length) {
+    switch (mode & 0x07) {
+        case SHA_MODE_SHA256_START:
+            // The SHA context lives in TempKey
+            atcac_sw_sha2_256_init(&this->m_sha);
+            this->m_shaActive    = true;
+            this->m_tempKeyValid = false;
+            return STATUS_SUCCESS;
+        case SHA_MODE_SHA256_UPDATE:
+            if (!this->m_shaActive)
+                return STATUS_EXECUTION_ERROR;
+            if (ATCA_SHA256_BLOCK_SIZE != length)
+                return STATUS_PARSE_ERROR;
+            atcac_sw_sha2_256_update(&this->m_sha, data, length);
+            return STATUS_SUCCESS;
+        case SHA_MODE_SHA256_END: {
+            if (!this->m_shaActive)
+                return STATUS_EXECUTION_ERROR;
+            if (length >= ATCA_SHA256_BLOCK_SIZE)
+                return STATUS_PARSE_ERROR;
+            uint8_t digest[ATCA_SHA_DIGEST_SIZE];
+            atcac_sw_sha2_256_update(&this->m_sha, data, length);
+            atcac_sw_sha2_256_finish(&this->m_sha, digest);
+            this->m_shaActive = false;
+            this->respond(digest, sizeof(digest));
+            return STATUS_SUCCESS;
+        }
+        default:
+            return STATUS_PARSE_ERROR;
+    }
+}
+
+void Atecc508a::respond (const uint8_t *data, const size_t length) {
+    this->m_output[0] = static_cast<uint8_t>(length + 1 + ATCA_CRC_SIZE);
+    memcpy(&this->m_output[1], data, length);
+    atCRC(length + 1, this->m_output, &this->m_output[length + 1]);
+    this->m_outputLength = length + 1 + ATCA_CRC_SIZE;
+    this->m_outputIndex  = 0;
+}
+
+void Atecc508a::respond_status (const uint8_t status) {
+    this->respond(&status, 1);
+}
+
+uint32_t Atecc508a::execution_micros (const uint8_t opcode) const {
+    const auto custom = this->m_executionOverrides.find(opcode);
+    if (this->m_executionOverrides.end() != custom)
+        return custom->second;
+
+    for (const auto &entry : EXECUTION_TIMES)
+        if (entry.opcode == opcode)
+            return this->m_worstCase ? entry.maximumMillis * 1000 : entry.typicalMicros;
+    return 0;
+}
+
+bool Atecc508a::config_locked () const {
+    return LOCKED == this->m_config[CONFIG_LOCK_CONFIG];
+}
+
+bool Atecc508a::data_locked () const {
+    return LOCKED == this->m_config[CONFIG_LOCK_VALUE];
+}
+
+uint16_t Atecc508a::slot_config (const uint8_t slot) const {
+    const size_t offset = CONFIG_SLOT_CONFIG + 2 * slot;
+    return static_cast<uint16_t>(this->m_config[offset] | (this->m_config[offset + 1] << 8));
+}
+
+uint16_t Atecc508a::key_config (const uint8_t slot) const {
+    const size_t offset = CONFIG_KEY_CONFIG + 2 * slot;
+    return static_cast<uint16_t>(this->m_config[offset] | (this->m_config[offset + 1] << 8));
+}
+
+bool Atecc508a::temp_key_from (const uint8_t slot) const {
+    return this->m_tempKeyValid && slot == this->m_genDigSlot;
+}
+
+void Atecc508a::command_digest (uint8_t *digest, const uint8_t *first, const uint8_t opcode, const uint8_t param1,
+                                const uint16_t param2, const uint8_t *second) const {
+    // SN[8] and SN[0:1], then zeros
+    const uint8_t middle[7 + 25] = {opcode, param1, static_cast<uint8_t>(param2), static_cast<uint8_t>(param2 >> 8),
+                                    this->m_config[12], this->m_config[0], this->m_config[1]};
+    sha256(digest, first, ATCA_KEY_SIZE, middle, sizeof(middle), second, ATCA_KEY_SIZE);
+}
+
+void Atecc508a::random_bytes (uint8_t *out, const size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        // xorshift64*
+        this->m_rng ^= this->m_rng >> 12;
+        this->m_rng ^= this->m_rng << 25;
+        this->m_rng ^= this->m_rng >> 27;
+        out[i] = static_cast<uint8_t>((this->m_rng * 0x2545F4914F6CDD1DULL) >> 56);
+    }
+}
+
+void Atecc508a::public_key_for (const uint8_t *privateKey, uint8_t *publicKey) const {
+    static const uint8_t X[] = {'P', 'U', 'B', 'X'};
+    static const uint8_t Y[] = {'P', 'U', 'B', 'Y'};
+    sha256(&publicKey[0], X, sizeof(X), privateKey, ATCA_KEY_SIZE);
+    sha256(&publicKey[32], Y, sizeof(Y), privateKey, ATCA_KEY_SIZE);
+}
+
+void Atecc508a::signature_for (const uint8_t *privateKey, const uint8_t *digest, uint8_t *signature) const {
+    static const uint8_t R[] = {'S', 'I', 'G', 'R'};
+    static const uint8_t S[] = {'S', 'I', 'G', 'S'};
+    sha256(&signature[0], R, sizeof(R), privateKey, ATCA_KEY_SIZE, digest, ATCA_KEY_SIZE);
+    sha256(&signature[32], S, sizeof(S), privateKey, ATCA_KEY_SIZE, digest, ATCA_KEY_SIZE);
+}
+
+}
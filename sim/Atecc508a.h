@@ -0,0 +1,284 @@
+/**
+ * @file    Atecc508a.h
+ *
+ * @author  David Zemon
+ *
+ * @copyright
+ * The MIT License (MIT)<br>
+ * <br>Copyright (c) 2019 David Zemon<br>
+ * <br>Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:<br>
+ * <br>The above copyright notice and this permission notice shall be included in all copies or substantial portions
+ * of the Software.<br>
+ * <br>THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "simulator.h"
+
+#include <atca_command.h>
+#include <atca_crypto_sw_sha2.h>
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+namespace sim {
+
+/**
+ * @brief Protocol- and timing-level model of an ATECC508A on the I2C bus
+ *
+ * Covers wake/idle/sleep (including the watchdog and TempKey retention rules), the word-address register, packet
+ * CRCs, and the Info, Read, Write, Lock, Nonce, GenDig, GenKey, Sign, Verify, Random and SHA commands. Every command
+ * occupies the device for its execution time, during which the device NACKs its address exactly like the real part.
+ *
+ * GenDig (data zone), encrypted reads of IsSecret/EncryptRead slots and encrypted writes of WriteConfig Encrypt slots
+ * use the datasheet's digests bit for bit, so a host that computes TempKey with cryptoauthlib's atcah_* functions
+ * gets the same answers as from a real part.
+ *
+ * @note Key generation, signing and verification are structurally faithful (sizes, slot rules, pass/fail) but the
+ *       "keys" and "signatures" are SHA-256 derivations, not real P-256 math. The model exists for profiling and
+ *       regression testing the transport, not for checking cryptography.
+ */
+class Atecc508a : public I2CDevice {
+    public:
+        static const uint8_t  DEFAULT_ADDRESS  = 0xC0;
+        static const uint16_t CONFIG_SIZE      = 128;
+        static const uint16_t OTP_SIZE         = 64;
+        static const uint8_t  SLOT_COUNT       = 16;
+        /** Minimum SDA low time that wakes the device (tWLO) */
+        static const uint32_t WAKE_LOW_MICROS  = 60;
+        /** Time from the end of the wake pulse until the device answers (tWHI) */
+        static const uint32_t WAKE_HIGH_MICROS = 500;
+        static const uint32_t WATCHDOG_MICROS  = 1300000;
+
+        /** Status codes written into a four-byte response packet */
+        typedef enum {
+            STATUS_SUCCESS         = 0x00,
+            STATUS_MISCOMPARE      = 0x01,
+            STATUS_PARSE_ERROR     = 0x03,
+            STATUS_EXECUTION_ERROR = 0x0F,
+            STATUS_AFTER_WAKE      = 0x11,
+            STATUS_CRC_ERROR       = 0xFF
+        } Status;
+
+        typedef enum {
+            SLEEP,
+            IDLE,
+            AWAKE
+        } PowerState;
+
+        struct Counters {
+            uint32_t wakes;
+            uint32_t commands;
+            uint32_t crcErrors;
+            uint32_t watchdogExpirations;
+            /** Response bytes damaged by corrupt_responses() */
+            uint32_t corruptedResponses;
+            /** Reads refused by nack_reads() */
+            uint32_t nackedReads;
+            /** Word address 0x00 (reset), which points the I/O buffer back at its first byte */
+            uint32_t ioResets;
+        };
+
+    public:
+        /**
+         * @param[in] address   8-bit (shifted) I2C address
+         * @param[in] serial    Nine-byte serial number, or NULL to use the one captured from our bench unit
+         */
+        Atecc508a (const uint8_t address = DEFAULT_ADDRESS, const uint8_t *serial = NULL);
+
+        /**
+         * @brief Lock the configuration and data zones with the factory slot layout, leaving the device ready for
+         *        key generation, signing, verification and random numbers
+         */
+        void provision ();
+
+        /**
+         * @brief Use the library's worst-case execution times instead of typical ones
+         */
+        void use_worst_case_timing (const bool worstCase) {
+            this->m_worstCase = worstCase;
+        }
+
+        /**
+         * @brief Override the time (in microseconds) a single opcode keeps the device busy
+         */
+        void set_execution_time (const uint8_t opcode, const uint32_t micros) {
+            this->m_executionOverrides[opcode] = micros;
+        }
+
+        void set_wake_high_micros (const uint32_t micros) {
+            this->m_wakeHighMicros = micros;
+        }
+
+        /**
+         * @brief Flip a bit in the first read of each of the next `count` command responses, as noise on the bus
+         *        would
+         *
+         * Only the copy on the wire is damaged: the I/O buffer is intact, so reading the response again returns it
+         * correctly.
+         */
+        void corrupt_responses (const uint32_t count) {
+            this->m_responsesToCorrupt = count;
+        }
+
+        /**
+         * @brief NACK the address of the next `count` reads, as the device does while it is still executing
+         */
+        void nack_reads (const uint32_t count) {
+            this->m_readsToNack = count;
+        }
+
+        PowerState power_state () {
+            this->check_watchdog();
+            return this->m_powerState;
+        }
+
+        bool temp_key_valid () const {
+            return this->m_tempKeyValid;
+        }
+
+        const Counters &counters () const {
+            return this->m_counters;
+        }
+
+        const uint8_t *config_zone () const {
+            return this->m_config;
+        }
+
+    public:
+        virtual void sda_low (const uint64_t ticks);
+
+        virtual bool address (const uint8_t addressByte);
+
+        virtual bool write (const uint8_t byte);
+
+        virtual uint8_t read ();
+
+        virtual void stop ();
+
+    private:
+        typedef enum {
+            WORD_ADDRESS_RESET   = 0x00,
+            WORD_ADDRESS_SLEEP   = 0x01,
+            WORD_ADDRESS_IDLE    = 0x02,
+            WORD_ADDRESS_COMMAND = 0x03,
+            WORD_ADDRESS_NONE    = 0xFF
+        } WordAddress;
+
+        static const size_t  MAX_COMMAND_SIZE  = 155;
+        static const size_t  MAX_RESPONSE_SIZE = 75;
+        static const uint8_t NO_SLOT           = 0xFF;
+
+    private:
+        void check_watchdog ();
+
+        void go_to_sleep ();
+
+        void execute ();
+
+        uint8_t execute_info (const uint8_t mode);
+
+        uint8_t execute_read (const uint8_t zone, const uint16_t address);
+
+        uint8_t execute_write (const uint8_t zone, const uint16_t address, const uint8_t *data, const size_t length);
+
+        uint8_t execute_lock (const uint8_t mode, const uint16_t summaryCrc);
+
+        uint8_t execute_nonce (const uint8_t mode, const uint8_t *numIn, const size_t length);
+
+        uint8_t execute_gendig (const uint8_t zone, const uint16_t keyId, const uint8_t *otherData,
+                                const size_t length);
+
+        uint8_t execute_genkey (const uint8_t mode, const uint16_t keyId);
+
+        uint8_t execute_sign (const uint8_t mode, const uint16_t keyId);
+
+        uint8_t execute_verify (const uint8_t mode, const uint8_t *data, const size_t length);
+
+        uint8_t execute_random ();
+
+        uint8_t execute_sha (const uint8_t mode, const uint8_t *data, const size_t length);
+
+        void respond (const uint8_t *data, const size_t length);
+
+        void respond_status (const uint8_t status);
+
+        uint32_t execution_micros (const uint8_t opcode) const;
+
+        bool config_locked () const;
+
+        bool data_locked () const;
+
+        uint16_t slot_config (const uint8_t slot) const;
+
+        uint16_t key_config (const uint8_t slot) const;
+
+        /**
+         * @return True if TempKey is valid and GenDig last derived it from the key in `slot`
+         */
+        bool temp_key_from (const uint8_t slot) const;
+
+        /**
+         * @brief SHA-256 over the layout that GenDig and the Write MAC share: `first`, the opcode and parameters,
+         *        SN[8], SN[0:1], 25 zero bytes, and `second`
+         */
+        void command_digest (uint8_t *digest, const uint8_t *first, const uint8_t opcode, const uint8_t param1,
+                             const uint16_t param2, const uint8_t *second) const;
+
+        void random_bytes (uint8_t *out, const size_t length);
+
+        void public_key_for (const uint8_t *privateKey, uint8_t *publicKey) const;
+
+        void signature_for (const uint8_t *privateKey, const uint8_t *digest, uint8_t *signature) const;
+
+    private:
+        const uint8_t               m_address;
+        PowerState                  m_powerState;
+        uint64_t                    m_readyAt;
+        uint64_t                    m_watchdogExpiresAt;
+        uint32_t                    m_wakeHighMicros;
+        bool                        m_worstCase;
+        std::map<uint8_t, uint32_t> m_executionOverrides;
+
+        WordAddress m_wordAddress;
+        bool        m_reading;
+        uint8_t     m_input[MAX_COMMAND_SIZE];
+        size_t      m_inputLength;
+        uint8_t     m_output[MAX_RESPONSE_SIZE];
+        size_t      m_outputLength;
+        size_t      m_outputIndex;
+        uint32_t    m_responsesToCorrupt;
+        /** The response in the I/O buffer has not been read yet and is due to be damaged */
+        bool        m_corruptNextRead;
+        uint32_t    m_readsToNack;
+
+        uint8_t              m_config[CONFIG_SIZE];
+        uint8_t              m_otp[OTP_SIZE];
+        std::vector<uint8_t> m_slots[SLOT_COUNT];
+        uint8_t              m_privateKeys[SLOT_COUNT][ATCA_KEY_SIZE];
+        bool                 m_hasPrivateKey[SLOT_COUNT];
+
+        uint8_t            m_tempKey[ATCA_KEY_SIZE];
+        bool               m_tempKeyValid;
+        /** Slot whose key GenDig last folded into TempKey, or NO_SLOT since the last Nonce */
+        uint8_t            m_genDigSlot;
+        atcac_sha2_256_ctx m_sha;
+        bool               m_shaActive;
+        uint64_t           m_rng;
+
+        /** Every public key this model ever produced, so Verify(External) can find the matching private key */
+        std::map<std::vector<uint8_t>, std::vector<uint8_t> > m_knownKeys;
+
+        Counters m_counters;
+};
+
+}
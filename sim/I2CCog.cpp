@@ -0,0 +1,132 @@
+/**
+ * @file    I2CCog.cpp
+ *
+ * @author  David Zemon
+ *
+ * @copyright
+ * The MIT License (MIT)<br>
+ * <br>Copyright (c) 2019 David Zemon<br>
+ * <br>Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:<br>
+ * <br>The above copyright notice and this permission notice shall be included in all copies or substantial portions
+ * of the Software.<br>
+ * <br>THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Simulator stand-in for demo/I2CCog.cpp. Instead of launching i2c_cog.cogc, each mailbox command is carried out
+ * right away on the simulated bus, with the per-call software overhead of the CMM-compiled I2CMaster replaced by
+ * the much smaller cost of native cog code.
+ */
+
+#include "simulator.h"
+
+#include <I2CCog.h>
+#include <PropWare/PropWare.h>
+
+/** CMM cost of filling in the mailbox plus the hub round trip to the cog and back */
+static const uint32_t COMMAND_OVERHEAD = 3 * sim::Clock::TICKS_PER_MICROS;
+/** Cost of the cog's own bookkeeping around each byte or bus condition */
+static const uint32_t NATIVE_OVERHEAD  = 20;
+/** Smallest CryptoAuth response packet: count, one status byte, CRC-16 */
+static const uint32_t RESPONSE_SIZE_MIN = 4;
+
+bool I2CCog::start () {
+    if (NO_LOCK == this->m_lock)
+        this->m_lock = locknew();
+    if (NO_LOCK != this->m_lock)
+        this->m_cogId = 1;
+    return this->running();
+}
+
+static I2CCogStatus do_send (sim::I2CBus &bus, const I2CCogMailbox &m) {
+    bus.start();
+    bool ack = bus.send_byte(m.address) && bus.send_byte(m.wordAddress);
+    for (uint32_t i = 0; ack && i < m.length; ++i)
+        ack = bus.send_byte(m.buffer[i]);
+    bus.stop();
+    return ack ? I2C_COG_SUCCESS : I2C_COG_NACK;
+}
+
+static I2CCogStatus do_receive (sim::I2CBus &bus, I2CCogMailbox &m) {
+    const uint32_t capacity = m.length;
+
+    m.length = 0;
+    bus.start();
+    if (!bus.send_byte(static_cast<uint8_t>(m.address | 0x01))) {
+        bus.stop();
+        return I2C_COG_NACK;
+    }
+
+    const uint8_t count = m.buffer[0] = bus.read_byte(true);
+    if (count < RESPONSE_SIZE_MIN) {
+        bus.stop();
+        return I2C_COG_INVALID_SIZE;
+    }
+    if (count > capacity) {
+        bus.stop();
+        return I2C_COG_SMALL_BUFFER;
+    }
+
+    uint32_t i;
+    for (i = 1; i < count - 1u; ++i)
+        m.buffer[i] = bus.read_byte(true);
+    m.buffer[i] = bus.read_byte(false);
+    bus.stop();
+    m.length = count;
+    return I2C_COG_SUCCESS;
+}
+
+static I2CCogStatus do_poll (sim::I2CBus &bus, const I2CCogMailbox &m) {
+    const uint32_t started = CNT;
+    for (;;) {
+        bus.start();
+        const bool ack = bus.send_byte(m.address);
+        bus.stop();
+        if (ack)
+            return I2C_COG_SUCCESS;
+        if (CNT - started >= m.timeoutTicks)
+            return I2C_COG_NACK;
+        waitcnt(CNT + m.intervalTicks);
+    }
+}
+
+I2CCogStatus I2CCog::execute (const I2CCogCommand command, const Bus &bus) {
+    auto           &simBus  = sim::I2CBus::on(bus.sclMask);
+    const uint32_t overhead = simBus.call_overhead();
+
+    sim::Clock::advance(COMMAND_OVERHEAD);
+    simBus.set_call_overhead(NATIVE_OVERHEAD);
+    simBus.set_frequency(CLKFREQ / (2 * (bus.halfBitTicks + I2C_COG_HOLD_OVERHEAD)));
+
+    I2CCogStatus status;
+    switch (command) {
+        case I2C_COG_SEND:
+            status = do_send(simBus, this->m_mailbox);
+            break;
+        case I2C_COG_RECEIVE:
+            status = do_receive(simBus, this->m_mailbox);
+            break;
+        case I2C_COG_WAKE:
+            simBus.pulse_sda(this->m_mailbox.intervalTicks);
+            if (this->m_mailbox.timeoutTicks)
+                waitcnt(CNT + this->m_mailbox.timeoutTicks);
+            status = I2C_COG_SUCCESS;
+            break;
+        case I2C_COG_POLL:
+            status = do_poll(simBus, this->m_mailbox);
+            break;
+        default:
+            status = I2C_COG_NACK;
+    }
+
+    simBus.set_call_overhead(overhead);
+    this->m_mailbox.status = status;
+    return status;
+}
@@ -0,0 +1,69 @@
+/**
+ * @file    PropWare.h
+ *
+ * @author  David Zemon
+ *
+ * @copyright
+ * The MIT License (MIT)<br>
+ * <br>Copyright (c) 2019 David Zemon<br>
+ * <br>Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:<br>
+ * <br>The above copyright notice and this permission notice shall be included in all copies or substantial portions
+ * of the Software.<br>
+ * <br>THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+/*
+ * Host-side stand-in for the subset of PropWare's core header used by the HAL. Timing macros are backed by the
+ * simulator's virtual clock so that delays cost simulated time, not wall-clock time.
+ */
+
+#include <simulator.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#define CLKFREQ     (sim::Clock::FREQUENCY)
+#define CNT         (static_cast<uint32_t>(sim::Clock::now()))
+#define SECOND      ((unsigned long) CLKFREQ)
+#define MILLISECOND ((unsigned long) (SECOND / 1000))
+#define MICROSECOND ((unsigned long) (MILLISECOND / 1000))
+
+#define check_errors(x)      if ((err = x)) return err
+
+static inline void waitcnt (const uint32_t target) {
+    sim::Clock::wait_until(target);
+}
+
+// The simulator runs everything in "cog 0" and has all eight hub locks to itself
+static inline int cogid () {
+    return 0;
+}
+
+static inline int locknew () {
+    static int next = 0;
+    return next < 8 ? next++ : -1;
+}
+
+static inline int lockset (const int lock) {
+    (void) lock;
+    return 0;
+}
+
+static inline void lockclr (const int lock) {
+    (void) lock;
+}
+
+namespace PropWare {
+
+typedef int ErrorCode;
+
+}
@@ -0,0 +1,49 @@
+/**
+ * @file    runnable.h
+ *
+ * @author  David Zemon
+ *
+ * @copyright
+ * The MIT License (MIT)<br>
+ * <br>Copyright (c) 2019 David Zemon<br>
+ * <br>Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:<br>
+ * <br>The above copyright notice and this permission notice shall be included in all copies or substantial portions
+ * of the Software.<br>
+ * <br>THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+/*
+ * Host-side stand-in for PropWare's Runnable. The simulator has no other cogs to start, so there is no invoke(): tests
+ * call run() themselves where they need it.
+ */
+
+#include <PropWare/PropWare.h>
+
+namespace PropWare {
+
+class Runnable {
+    public:
+        virtual void run () = 0;
+
+    protected:
+        template<size_t N>
+        Runnable (const uint32_t (&stack)[N])
+                : m_stackPointer(stack),
+                  m_stackSizeInBytes(N * sizeof(uint32_t)) {
+        }
+
+    protected:
+        const uint32_t *m_stackPointer;
+        uint32_t       m_stackSizeInBytes;
+};
+
+}
@@ -0,0 +1,58 @@
+/**
+ * @file    pin.h
+ *
+ * @author  David Zemon
+ *
+ * @copyright
+ * The MIT License (MIT)<br>
+ * <br>Copyright (c) 2019 David Zemon<br>
+ * <br>Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:<br>
+ * <br>The above copyright notice and this permission notice shall be included in all copies or substantial portions
+ * of the Software.<br>
+ * <br>THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <PropWare/PropWare.h>
+
+namespace PropWare {
+
+class Port {
+    public:
+        typedef enum {
+            NULL_PIN = 0,
+            P0 = 1u << 0, P1 = 1u << 1, P2 = 1u << 2, P3 = 1u << 3, P4 = 1u << 4, P5 = 1u << 5, P6 = 1u << 6,
+            P7 = 1u << 7, P8 = 1u << 8, P9 = 1u << 9, P10 = 1u << 10, P11 = 1u << 11, P12 = 1u << 12,
+            P13 = 1u << 13, P14 = 1u << 14, P15 = 1u << 15, P16 = 1u << 16, P17 = 1u << 17, P18 = 1u << 18,
+            P19 = 1u << 19, P20 = 1u << 20, P21 = 1u << 21, P22 = 1u << 22, P23 = 1u << 23, P24 = 1u << 24,
+            P25 = 1u << 25, P26 = 1u << 26, P27 = 1u << 27, P28 = 1u << 28, P29 = 1u << 29, P30 = 1u << 30,
+            P31 = 1u << 31
+        } Mask;
+};
+
+class Pin : public Port {
+    public:
+        Pin (const Mask mask = NULL_PIN) {
+            (void) mask;
+        }
+
+        void set_dir_in () const {
+        }
+
+        /**
+         * Simulated buses always have their pull-ups fitted
+         */
+        bool read () const {
+            return true;
+        }
+};
+
+}
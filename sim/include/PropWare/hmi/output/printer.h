@@ -0,0 +1,85 @@
+/**
+ * @file    printer.h
+ *
+ * @author  David Zemon
+ *
+ * @copyright
+ * The MIT License (MIT)<br>
+ * <br>Copyright (c) 2019 David Zemon<br>
+ * <br>Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:<br>
+ * <br>The above copyright notice and this permission notice shall be included in all copies or substantial portions
+ * of the Software.<br>
+ * <br>THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+/*
+ * Host-side stand-in for the subset of PropWare's Printer used by the demo's headers. Output goes to stdout.
+ */
+
+#include <PropWare/PropWare.h>
+
+#include <cstdio>
+
+namespace PropWare {
+
+class Printer {
+    public:
+        struct Format {
+            uint16_t width;
+            uint16_t precision;
+            char     fillChar;
+            uint8_t  radix;
+
+            Format ()
+                    : width(0),
+                      precision(6),
+                      fillChar(' '),
+                      radix(10) {
+            }
+        };
+
+    public:
+        void put_char (const char c) const {
+            putchar(c);
+        }
+
+        void puts (const char *string) const {
+            fputs(string, stdout);
+        }
+
+        void println (const char *string) const {
+            this->puts(string);
+            this->put_char('\n');
+        }
+
+        const Printer &operator<< (const char *string) const {
+            this->puts(string);
+            return *this;
+        }
+
+        const Printer &operator<< (const char c) const {
+            this->put_char(c);
+            return *this;
+        }
+
+        const Printer &operator<< (const int number) const {
+            printf("%d", number);
+            return *this;
+        }
+
+        const Printer &operator<< (const unsigned int number) const {
+            printf("%u", number);
+            return *this;
+        }
+};
+
+}
@@ -0,0 +1,108 @@
+/**
+ * @file    i2cmaster.h
+ *
+ * @author  David Zemon
+ *
+ * @copyright
+ * The MIT License (MIT)<br>
+ * <br>Copyright (c) 2019 David Zemon<br>
+ * <br>Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:<br>
+ * <br>The above copyright notice and this permission notice shall be included in all copies or substantial portions
+ * of the Software.<br>
+ * <br>THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <PropWare/PropWare.h>
+#include <PropWare/gpio/pin.h>
+
+namespace PropWare {
+
+/**
+ * @brief Host-side stand-in for PropWare's I2C master with the same public interface, driving a simulated bus
+ *
+ * Each master is bound to the simulated bus identified by its SCL pin, so devices attached with
+ * `sim::I2CBus::on(Pin::Mask::P28)` appear on `pwI2c`, and so on.
+ */
+class I2CMaster {
+    public:
+        static const unsigned int DEFAULT_FREQUENCY = 400000;
+
+    public:
+        I2CMaster (const Pin::Mask sclMask = Pin::Mask::P28, const Pin::Mask sdaMask = Pin::Mask::P29,
+                   const unsigned int frequency = DEFAULT_FREQUENCY)
+                : m_sclMask(sclMask),
+                  m_frequency(frequency) {
+            (void) sdaMask;
+        }
+
+        void set_frequency (const unsigned int frequency) {
+            this->m_frequency = frequency;
+        }
+
+        void start () const {
+            this->bus().start();
+        }
+
+        void stop () const {
+            this->bus().stop();
+        }
+
+        bool send_byte (const uint8_t byte) const {
+            return this->bus().send_byte(byte);
+        }
+
+        uint8_t read_byte (const bool acknowledge) const {
+            return this->bus().read_byte(acknowledge);
+        }
+
+        bool ping (const uint8_t device) const {
+            this->start();
+            const bool ack = this->send_byte(device);
+            this->stop();
+            return ack;
+        }
+
+        bool put (const uint8_t device, const uint8_t byte) const {
+            this->start();
+            const bool ack = this->send_byte(device) && this->send_byte(byte);
+            this->stop();
+            return ack;
+        }
+
+        bool put (const uint8_t device, const uint8_t address, const uint8_t byte) const {
+            return this->put(device, address, &byte, 1);
+        }
+
+        bool put (const uint8_t device, const uint8_t address, const uint8_t array[], const size_t size) const {
+            this->start();
+            bool ack = this->send_byte(device) && this->send_byte(address);
+            for (size_t i = 0; ack && i < size; ++i)
+                ack = this->send_byte(array[i]);
+            this->stop();
+            return ack;
+        }
+
+    private:
+        sim::I2CBus &bus () const {
+            sim::I2CBus &bus = sim::I2CBus::on(this->m_sclMask);
+            bus.set_frequency(this->m_frequency);
+            return bus;
+        }
+
+    private:
+        const Pin::Mask m_sclMask;
+        unsigned int    m_frequency;
+};
+
+}
+
+extern PropWare::I2CMaster pwI2c;
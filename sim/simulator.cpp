@@ -0,0 +1,133 @@
+/**
+ * @file    simulator.cpp
+ *
+ * @author  David Zemon
+ *
+ * @copyright
+ * The MIT License (MIT)<br>
+ * <br>Copyright (c) 2019 David Zemon<br>
+ * <br>Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:<br>
+ * <br>The above copyright notice and this permission notice shall be included in all copies or substantial portions
+ * of the Software.<br>
+ * <br>THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "simulator.h"
+
+#include <map>
+
+namespace sim {
+
+uint64_t Clock::m_ticks = 0;
+
+I2CBus &I2CBus::on (const uint32_t sclMask) {
+    static std::map<uint32_t, I2CBus> buses;
+    return buses[sclMask];
+}
+
+I2CBus::I2CBus ()
+        : m_selected(NULL),
+          m_addressPending(false),
+          m_sdaLowTicks(0),
+          m_callOverhead(DEFAULT_CALL_OVERHEAD),
+          m_bytesTransferred(0) {
+    this->set_frequency(DEFAULT_FREQUENCY);
+}
+
+void I2CBus::attach (I2CDevice &device) {
+    this->m_devices.push_back(&device);
+}
+
+void I2CBus::set_frequency (const uint32_t frequency) {
+    this->m_bitTicks = Clock::FREQUENCY / frequency;
+}
+
+void I2CBus::start () {
+    Clock::advance(this->m_callOverhead);
+    // A repeated start ends whatever transaction was in flight
+    if (this->m_selected)
+        this->m_selected->stop();
+    this->m_selected       = NULL;
+    this->m_addressPending = true;
+
+    // SDA falls while SCL is high and stays low into the first bit
+    this->bit(false);
+}
+
+void I2CBus::stop () {
+    Clock::advance(this->m_callOverhead);
+    this->bit(false);
+    this->release_sda();
+    if (this->m_selected)
+        this->m_selected->stop();
+    this->m_selected       = NULL;
+    this->m_addressPending = false;
+}
+
+bool I2CBus::send_byte (const uint8_t byte) {
+    Clock::advance(this->m_callOverhead);
+    for (int i = 7; i >= 0; --i)
+        this->bit(static_cast<bool>((byte >> i) & 1));
+    this->release_sda();
+
+    bool ack = false;
+    if (this->m_addressPending) {
+        this->m_addressPending = false;
+        for (auto device : this->m_devices) {
+            if (device->address(byte)) {
+                this->m_selected = device;
+                ack = true;
+                break;
+            }
+        }
+    } else if (this->m_selected) {
+        ack = this->m_selected->write(byte);
+    }
+
+    // Acknowledge bit is driven by the slave and never counts towards a wake pulse
+    Clock::advance(this->m_bitTicks);
+    ++this->m_bytesTransferred;
+    return ack;
+}
+
+uint8_t I2CBus::read_byte (const bool acknowledge) {
+    Clock::advance(this->m_callOverhead);
+    this->release_sda();
+    const uint8_t byte = this->m_selected ? this->m_selected->read() : static_cast<uint8_t>(0xFF);
+    Clock::advance(this->m_bitTicks * 9);
+    ++this->m_bytesTransferred;
+    (void) acknowledge;
+    return byte;
+}
+
+void I2CBus::pulse_sda (const uint64_t ticks) {
+    Clock::advance(this->m_callOverhead);
+    this->m_sdaLowTicks += ticks;
+    Clock::advance(ticks);
+    this->release_sda();
+}
+
+void I2CBus::bit (const bool sdaHigh) {
+    if (sdaHigh)
+        this->release_sda();
+    else
+        this->m_sdaLowTicks += this->m_bitTicks;
+    Clock::advance(this->m_bitTicks);
+}
+
+void I2CBus::release_sda () {
+    if (this->m_sdaLowTicks) {
+        for (auto device : this->m_devices)
+            device->sda_low(this->m_sdaLowTicks);
+        this->m_sdaLowTicks = 0;
+    }
+}
+
+}
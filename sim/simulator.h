@@ -0,0 +1,170 @@
+/**
+ * @file    simulator.h
+ *
+ * @author  David Zemon
+ *
+ * @copyright
+ * The MIT License (MIT)<br>
+ * <br>Copyright (c) 2019 David Zemon<br>
+ * <br>Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:<br>
+ * <br>The above copyright notice and this permission notice shall be included in all copies or substantial portions
+ * of the Software.<br>
+ * <br>THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ * TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace sim {
+
+/**
+ * @brief Virtual system counter shared by every simulated component
+ *
+ * Nothing in the simulator sleeps for real. `waitcnt`, I2C bit times and device execution times all advance this
+ * clock instead, which makes every measurement deterministic and independent of the speed of the host.
+ */
+class Clock {
+    public:
+        /** Matches the 80 MHz system clock of the Propeller boards we ship */
+        static const uint32_t FREQUENCY        = 80000000;
+        static const uint32_t TICKS_PER_MICROS = FREQUENCY / 1000000;
+
+    public:
+        static uint64_t now () {
+            return m_ticks;
+        }
+
+        static void advance (const uint64_t ticks) {
+            m_ticks += ticks;
+        }
+
+        /**
+         * @brief Same semantics as the Propeller's `waitcnt` instruction: block until the low 32 bits of the counter
+         *        match `target`
+         *
+         * A target equal to the counter has already gone by when the instruction compares, so it is met only after a
+         * full wrap of the counter, as on the chip.
+         */
+        static void wait_until (const uint32_t target) {
+            const uint32_t ticks = target - static_cast<uint32_t>(m_ticks);
+            m_ticks += ticks ? ticks : UINT64_C(1) << 32;
+        }
+
+        static uint64_t micros (const uint64_t ticks) {
+            return ticks / TICKS_PER_MICROS;
+        }
+
+        static uint64_t ticks_from_micros (const uint64_t micros) {
+            return micros * TICKS_PER_MICROS;
+        }
+
+    private:
+        static uint64_t m_ticks;
+};
+
+/**
+ * @brief Anything that can sit on a simulated I2C bus
+ */
+class I2CDevice {
+    public:
+        virtual ~I2CDevice () {
+        }
+
+        /**
+         * @brief The master released SDA after holding it low for `ticks` (the wake condition of the CryptoAuth parts)
+         */
+        virtual void sda_low (const uint64_t ticks) = 0;
+
+        /**
+         * @brief Address byte following a START condition
+         *
+         * @return True to acknowledge (and be selected for the rest of the transaction)
+         */
+        virtual bool address (const uint8_t addressByte) = 0;
+
+        /**
+         * @return True to acknowledge the byte
+         */
+        virtual bool write (const uint8_t byte) = 0;
+
+        virtual uint8_t read () = 0;
+
+        virtual void stop () = 0;
+};
+
+/**
+ * @brief Bit-timed model of one I2C bus
+ *
+ * Every primitive advances the virtual clock by the time it would occupy the wire at the current frequency, plus a
+ * fixed per-call overhead that stands in for the software cost of the master driving the bus.
+ */
+class I2CBus {
+    public:
+        static const uint32_t DEFAULT_FREQUENCY     = 400000;
+        /** Rough cost of one CMM-compiled call into PropWare's I2CMaster */
+        static const uint32_t DEFAULT_CALL_OVERHEAD = 4 * Clock::TICKS_PER_MICROS;
+
+    public:
+        /**
+         * @brief Look up (and create on first use) the bus driven by the given SCL pin mask
+         */
+        static I2CBus &on (const uint32_t sclMask);
+
+    public:
+        I2CBus ();
+
+        void attach (I2CDevice &device);
+
+        void set_frequency (const uint32_t frequency);
+
+        void set_call_overhead (const uint32_t ticks) {
+            this->m_callOverhead = ticks;
+        }
+
+        uint32_t call_overhead () const {
+            return this->m_callOverhead;
+        }
+
+        /**
+         * @brief Hold SDA low for exactly `ticks` and release it, outside of any transaction
+         */
+        void pulse_sda (const uint64_t ticks);
+
+        void start ();
+
+        void stop ();
+
+        bool send_byte (const uint8_t byte);
+
+        uint8_t read_byte (const bool acknowledge);
+
+        uint64_t bytes_transferred () const {
+            return this->m_bytesTransferred;
+        }
+
+    private:
+        void bit (const bool sdaHigh);
+
+        void release_sda ();
+
+    private:
+        std::vector<I2CDevice *> m_devices;
+        I2CDevice                *m_selected;
+        bool                     m_addressPending;
+        uint64_t                 m_bitTicks;
+        uint64_t                 m_sdaLowTicks;
+        uint32_t                 m_callOverhead;
+        uint64_t                 m_bytesTransferred;
+};
+
+}